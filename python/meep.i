@@ -2045,7 +2045,8 @@ void _get_epsilon_grid(geometric_object_list gobj_list,
                        int ny, double *ytics,
                        int nz, double *ztics,
                        std::complex<double> *grid_vals,
-                       double frequency) {
+                       double frequency,
+                       bool parallel) {
      meep_geom::get_epsilon_grid(gobj_list,
                                  mlist,
                                  _default_material,
@@ -2057,7 +2058,8 @@ void _get_epsilon_grid(geometric_object_list gobj_list,
                                  ny, ytics,
                                  nz, ztics,
                                  grid_vals,
-                                 frequency);
+                                 frequency,
+                                 parallel);
 }
 
 %}
@@ -2700,6 +2700,7 @@ class Simulation:
         ytics: np.ndarray = None,
         ztics: np.ndarray = None,
         frequency: float = 0.0,
+        parallel: bool = False,
     ):
         """
         Given three 1d NumPy arrays (`xtics`,`ytics`,`ztics`) which define the coordinates of a Cartesian
@@ -2711,6 +2712,8 @@ class Simulation:
         $\\varepsilon$ by bilinearly interpolating from the nearest Yee grid points. This function is useful for
         sampling the material geometry to any arbitrary resolution. The return value is a NumPy array with shape
         equivalent to `numpy.meshgrid(xtics,ytics,ztics)`. Empty dimensions are collapsed.
+        If `parallel` is `True`, this must be called by all processes, which then each
+        compute a slab of the grid along $x$ and all receive the full array.
         """
         grid_vals = np.squeeze(
             np.empty((len(xtics), len(ytics), len(ztics)), dtype=np.complex128)
@@ -2732,6 +2735,7 @@ class Simulation:
             ztics,
             grid_vals,
             frequency,
+            parallel,
         )
         return grid_vals
 
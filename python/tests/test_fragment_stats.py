@@ -247,6 +247,44 @@ class TestFragmentStats(unittest.TestCase):
         self.assertEqual(self.fs.num_2d_pml_pixels, 1000)
         self.assertEqual(self.fs.num_3d_pml_pixels, 0)
 
+    def test_2d_memory(self):
+        self._test_2d([], pml=[mp.PML(1, mp.Y), mp.PML(2, mp.X, mp.Low)])
+        fs = self.fs
+        realnum = 4 if mp.is_single_precision() else 8
+        arrays = (
+            8 * fs.num_pixels_in_box
+            + 10 * (fs.num_1d_pml_pixels + fs.num_2d_pml_pixels + fs.num_3d_pml_pixels)
+            + 7 * fs.num_susceptibility_pixels
+            + 4 * fs.num_nonzero_conductivity_pixels
+            + 2
+            * (
+                fs.num_nonlinear_pixels
+                + fs.num_anisotropic_eps_pixels
+                + fs.num_anisotropic_mu_pixels
+            )
+        )
+        expected = realnum * (3 * arrays + 2 * fs.num_dft_pixels)
+        self.assertAlmostEqual(fs.memory() / expected, 1, places=12)
+
+    def test_1d_memory(self):
+        self._test_1d([])
+        fs = self.fs
+        realnum = 4 if mp.is_single_precision() else 8
+        arrays = (
+            8 * fs.num_pixels_in_box
+            + 7 * fs.num_susceptibility_pixels
+            + 4 * fs.num_nonzero_conductivity_pixels
+            + 2
+            * (
+                fs.num_nonlinear_pixels
+                + fs.num_anisotropic_eps_pixels
+                + fs.num_anisotropic_mu_pixels
+            )
+        )
+        self.assertAlmostEqual(
+            fs.memory() / (realnum * (arrays + 2 * fs.num_dft_pixels)), 1, places=12
+        )
+
     def test_2d_with_absorbers(self):
         fs = self.get_fragment_stats(
             mp.Vector3(10, 10), mp.Vector3(30, 30), 2, geom=[], pml=[mp.Absorber(1)]
@@ -677,6 +715,41 @@ class TestPMLToVolList(unittest.TestCase):
         self.checkcyl(v2[3], mp.Vector3(4, 0, -5), mp.Vector3(5, 0, -4))
 
 
+class TestMemoryBudget(unittest.TestCase):
+    def smallest_chunk_area(self, budget):
+        # A 16 x 4 cell whose left end holds many DFT frequencies, which cost
+        # relatively more time than memory compared to the rest of the cell.
+        mp.cvar.fragment_stats_memory_budget = budget
+        try:
+            sim = mp.Simulation(
+                cell_size=mp.Vector3(16, 4),
+                resolution=10,
+                num_chunks=2,
+                split_chunks_evenly=False,
+            )
+            sim.add_dft_fields(
+                [mp.Ez], 0.5, 0.2, 100, center=mp.Vector3(-6), size=mp.Vector3(4, 4)
+            )
+            sim.init_sim()
+            areas = [
+                v.surroundings().full_volume()
+                for v in sim.structure.get_chunk_volumes()
+            ]
+        finally:
+            mp.cvar.fragment_stats_memory_budget = 0
+        self.assertEqual(len(areas), 2)
+        return min(areas)
+
+    def test_memory_budget(self):
+        # Without a budget the cell is split to balance the estimated time, which
+        # leaves a narrow chunk around the DFT region.  With a budget that every
+        # chunk exceeds, it is split to balance the estimated memory instead.
+        by_cost = self.smallest_chunk_area(0)
+        by_memory = self.smallest_chunk_area(1.0)
+        self.assertGreater(by_memory, by_cost)
+        self.assertLess(by_memory, 32)
+
+
 @unittest.skipIf(mp.count_processors() != 2, "MPI specific test")
 class TestChunkCommunicationArea(unittest.TestCase):
     def test_2d_periodic(self):
@@ -91,6 +91,54 @@ class TestGetEpsilonGrid(unittest.TestCase):
         self.assertAlmostEqual(np.real(eps_grid), np.real(eps_pt), places=6)
         self.assertAlmostEqual(np.imag(eps_grid), np.imag(eps_pt), places=6)
 
+    @parameterized.parameterized.expand([(0,), (0.7,)])
+    def test_get_epsilon_grid_media(self, freq):
+        # without the MaterialGrid the grid is evaluated along rows of points
+        # in parallel, reusing ε within each medium; compare it with
+        # get_epsilon_point and with the per-point evaluation, which is forced
+        # by a small MaterialGrid block away from all of the sampled points
+        geometry = [
+            g for g in self.sim.geometry if not isinstance(g.material, mp.MaterialGrid)
+        ]
+        corner = mp.Block(
+            center=mp.Vector3(0.485, -0.485),
+            size=mp.Vector3(0.03, 0.03, mp.inf),
+            material=mp.MaterialGrid(
+                mp.Vector3(2, 2),
+                mp.air,
+                mp.Medium(index=2.0),
+                weights=np.ones((2, 2)),
+                do_averaging=False,
+            ),
+        )
+        sims = [
+            mp.Simulation(
+                resolution=20,
+                cell_size=self.cell_size,
+                geometry=g,
+                eps_averaging=False,
+            )
+            for g in (geometry, geometry + [corner])
+        ]
+        for sim in sims:
+            sim.init_sim()
+        xtics = np.linspace(-0.45, 0.45, 19)
+        ytics = np.linspace(-0.45, 0.45, 19)
+        eps_grid = sims[0].get_epsilon_grid(
+            xtics, ytics, np.array([0]), freq, parallel=True
+        )
+        eps_ref = sims[1].get_epsilon_grid(xtics, ytics, np.array([0]), freq)
+        np.testing.assert_allclose(eps_grid, eps_ref, rtol=1e-12, atol=1e-12)
+        for i in range(0, len(xtics), 3):
+            for j in range(0, len(ytics), 3):
+                eps_pt = sims[0].get_epsilon_point(mp.Vector3(xtics[i], ytics[j]), freq)
+                self.assertAlmostEqual(
+                    np.real(eps_grid[i, j]), np.real(eps_pt), places=6
+                )
+                self.assertAlmostEqual(
+                    np.imag(eps_grid[i, j]), np.imag(eps_pt), places=6
+                )
+
 
 if __name__ == "__main__":
     unittest.main()
@@ -0,0 +1,193 @@
+/* Copyright (C) 2005-2024 Massachusetts Institute of Technology
+%
+%  This program is free software; you can redistribute it and/or modify
+%  it under the terms of the GNU General Public License as published by
+%  the Free Software Foundation; either version 2, or (at your option)
+%  any later version.
+%
+%  This program is distributed in the hope that it will be useful,
+%  but WITHOUT ANY WARRANTY; without even the implied warranty of
+%  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+%  GNU General Public License for more details.
+%
+%  You should have received a copy of the GNU General Public License
+%  along with this program; if not, write to the Free Software Foundation,
+%  Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* Storage for the per-chunk field arrays (f, f_u, f_w, f_backup, ...).
+
+   These are all gv.ntot() realnums long, and are allocated lazily as
+   the timestepping discovers that they are needed (PML, dispersion,
+   synchronization...), so rather than a single up-front allocation we
+   hand out fixed-size blocks from a few large slabs.  Every block is
+   aligned and padded to a cache line, and the slabs are mapped with
+   transparent huge pages where available.  Since a slab is only backed
+   by physical pages once they are touched, a block is zeroed by the
+   same static OpenMP partition used by the PLOOP_OVER_IVECS loops that
+   update it, which places its pages on the NUMA nodes of those threads.
+   Blocks are handed out from the oldest slab with a free block, so that
+   later slabs drain as arrays are released; a slab is returned to the OS
+   as soon as all of its blocks are free, and otherwise the whole pages of
+   a released block are returned with madvise(MADV_DONTNEED) (they read
+   back as zeros, and are touched again by the zeroing in alloc). */
+
+#include <algorithm>
+#include <stdlib.h>
+
+#include "meep.hpp"
+#include "config.h"
+
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#if defined(MAP_ANONYMOUS) && defined(HAVE_MADVISE) && defined(MADV_DONTNEED) &&                   \
+    defined(HAVE_UNISTD_H)
+#include <unistd.h>
+#define ARENA_DONTNEED 1
+#endif
+#endif
+
+namespace meep {
+
+// alignment (and padding) of each array, in bytes: one cache line
+static const size_t arena_alignment = 64;
+
+// blocks in the first slab of a chunk; each later slab is as big as all previous ones
+static const size_t arena_min_blocks = 8;
+
+chunk_arena::chunk_arena(size_t n) : n(n), num_blocks(0) {
+  const size_t per_line = arena_alignment / sizeof(realnum);
+  stride = (n + per_line - 1) / per_line * per_line;
+  if (stride == 0) stride = per_line;
+}
+
+/* the whole pages inside the block at p, which are not backed by physical
+   memory while the block is free: returns their length and sets *lo */
+static size_t block_pages(realnum *p, size_t bytes, char **lo) {
+#ifdef ARENA_DONTNEED
+  static const size_t page = sysconf(_SC_PAGESIZE);
+  const uintptr_t start = ((uintptr_t)p + page - 1) / page * page;
+  const uintptr_t end = ((uintptr_t)p + bytes) / page * page;
+  *lo = (char *)start;
+  return end > start ? end - start : 0;
+#else
+  (void)p;
+  (void)bytes;
+  *lo = NULL;
+  return 0;
+#endif
+}
+
+static void free_slab_memory(void *base, size_t bytes) {
+#if defined(HAVE_SYS_MMAN_H) && defined(MAP_ANONYMOUS)
+  munmap(base, bytes);
+#else
+  (void)bytes;
+  free(base);
+#endif
+}
+
+chunk_arena::~chunk_arena() {
+  for (const slab &sl : slabs)
+    free_slab_memory(sl.base, sl.bytes);
+}
+
+void chunk_arena::add_slab() {
+  const size_t nblocks = std::max(arena_min_blocks, num_blocks);
+  slab sl;
+  sl.bytes = nblocks * stride * sizeof(realnum);
+  sl.nblocks = nblocks;
+  sl.unbacked = 0;
+#if defined(HAVE_SYS_MMAN_H) && defined(MAP_ANONYMOUS)
+  // page-aligned; untouched pages cost only address space
+  sl.base = mmap(NULL, sl.bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (sl.base == MAP_FAILED) meep::abort("out of memory allocating %zu field arrays", nblocks);
+#if defined(HAVE_MADVISE) && defined(MADV_HUGEPAGE)
+  madvise(sl.base, sl.bytes, MADV_HUGEPAGE); // only a hint, so failure is harmless
+#endif
+  sl.start = (realnum *)sl.base;
+#else
+  sl.base = malloc(sl.bytes + arena_alignment);
+  if (!sl.base) meep::abort("out of memory allocating %zu field arrays", nblocks);
+  sl.start = (realnum *)((char *)sl.base + (arena_alignment - (size_t)sl.base % arena_alignment) %
+                                               arena_alignment);
+#endif
+  num_blocks += nblocks;
+
+  // push in reverse order so that blocks are handed out in order of increasing address
+  sl.free_blocks.reserve(nblocks);
+  char *lo;
+  for (size_t i = nblocks; i > 0; --i) {
+    sl.free_blocks.push_back(sl.start + (i - 1) * stride);
+    sl.unbacked += block_pages(sl.free_blocks.back(), stride * sizeof(realnum), &lo);
+  }
+  slabs.push_back(std::move(sl));
+}
+
+realnum *chunk_arena::alloc() {
+  slab *sl = NULL;
+  for (slab &s : slabs)
+    if (!s.free_blocks.empty()) {
+      sl = &s;
+      break;
+    }
+  if (!sl) {
+    add_slab();
+    sl = &slabs.back();
+  }
+  realnum *p = sl->free_blocks.back();
+  sl->free_blocks.pop_back();
+  char *lo;
+  sl->unbacked -= block_pages(p, stride * sizeof(realnum), &lo);
+
+  const ptrdiff_t ntot = n;
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for (ptrdiff_t i = 0; i < ntot; ++i)
+    p[i] = 0;
+  return p;
+}
+
+void chunk_arena::release(realnum *p) {
+  if (!p) return;
+  for (size_t i = 0; i < slabs.size(); ++i) {
+    slab &sl = slabs[i];
+    if (p < sl.start || p >= sl.start + sl.nblocks * stride) continue;
+    sl.free_blocks.push_back(p);
+    if (sl.free_blocks.size() == sl.nblocks) {
+      free_slab_memory(sl.base, sl.bytes);
+      num_blocks -= sl.nblocks;
+      slabs.erase(slabs.begin() + i);
+      return;
+    }
+    char *lo;
+    const size_t len = block_pages(p, stride * sizeof(realnum), &lo);
+#ifdef ARENA_DONTNEED
+    if (len && madvise(lo, len, MADV_DONTNEED) != 0)
+      meep::abort("madvise failed releasing a field array");
+#endif
+    sl.unbacked += len;
+    return;
+  }
+  meep::abort("releasing an array that was not allocated by this chunk_arena");
+}
+
+size_t chunk_arena::blocks_in_use() const {
+  size_t nused = 0;
+  for (const slab &sl : slabs)
+    nused += sl.nblocks - sl.free_blocks.size();
+  return nused;
+}
+
+size_t chunk_arena::bytes_resident() const {
+  size_t unbacked = 0;
+  for (const slab &sl : slabs)
+    unbacked += sl.unbacked;
+  return bytes_reserved() - unbacked;
+}
+
+} // namespace meep
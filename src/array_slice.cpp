@@ -366,6 +366,7 @@ static void get_array_slice_chunkloop(fields_chunk *fc, int ichnk, component cgr
     }
   }
 
+  const bool stretched = fc->s->has_grid_stretch();
   vec rshift(shift * (0.5 * fc->gv.inva));
   // main loop over all grid points owned by this field chunk.
   LOOP_OVER_IVECS(fc->gv, is, ie, idx) {
@@ -373,6 +374,7 @@ static void get_array_slice_chunkloop(fields_chunk *fc, int ichnk, component cgr
     // get real-space coordinates of grid point, taking into
     // account the complications of symmetries.
     IVEC_LOOP_LOC(fc->gv, loc);
+    IVEC_LOOP_ILOC(fc->gv, here);
     loc = S.transform(loc, sn) + rshift;
 
     // interpolate fields at the four nearest grid points
@@ -381,6 +383,7 @@ static void get_array_slice_chunkloop(fields_chunk *fc, int ichnk, component cgr
       // special case for fetching grid point coordinates and weights
       if (cS[i] == NO_COMPONENT) {
         fields[i] = IVEC_LOOP_WEIGHT(s0, s1, e0, e1, dV0 + dV1 * loop_i2);
+        if (stretched) fields[i] *= fc->s->stretch_weight(here, data->empty_dim);
       }
       else if (cS[i] == Dielectric) {
         complex<double> tr(0.0, 0.0);
@@ -416,6 +419,7 @@ static void get_array_slice_chunkloop(fields_chunk *fc, int ichnk, component cgr
           else
             f[k] = 0;
         fields[i] = IVEC_LOOP_WEIGHT(s0i, s1i, e0i, e1i, 1.0) * complex<double>(f[0], f[1]) * ph[i];
+        if (stretched) fields[i] /= fc->s->field_stretch(cS[i], here); // physical fields
       }
     }
 
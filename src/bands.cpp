@@ -199,4 +199,50 @@ int do_harminv(complex<double> *data, int n, double dt, double fmin, double fmax
 #endif
 }
 
+std::vector<harminv_result> do_harminv_batch(const complex<double> *data, size_t nseries, int n,
+                                             size_t stride, double dt, double fmin, double fmax,
+                                             int maxbands, double spectral_density,
+                                             double Q_thresh, double rel_err_thresh,
+                                             double err_thresh, double rel_amp_thresh,
+                                             double amp_thresh) {
+  if (stride == 0) stride = n;
+  if (maxbands < 0) maxbands = 0;
+  const size_t mb = maxbands;
+
+  // series s is analyzed by process s % P, its threads sharing the local series;
+  // every output slot is written by exactly one process, so a single sum_to_all of
+  // the zero-initialized buffer gathers all the results everywhere.  The results of
+  // series s are packed in block s of the buffer: mb complex amplitudes, then mb each
+  // of the real and imaginary frequencies and the errors, then the number of modes.
+  const size_t block = 5 * mb + 1;
+  std::vector<double> buf(nseries * block, 0.0), buf_all(nseries * block);
+  const ptrdiff_t P = count_processors(), rank = my_rank();
+  const ptrdiff_t nmine = (ptrdiff_t(nseries) - rank + P - 1) / P;
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+  for (ptrdiff_t i = 0; i < nmine; ++i) {
+    const size_t s = rank + i * P;
+    double *b = &buf[s * block];
+    // do_harminv only modifies the output arrays, never the input series
+    b[5 * mb] = do_harminv(const_cast<complex<double> *>(data + s * stride), n, dt, fmin, fmax,
+                           maxbands, reinterpret_cast<complex<double> *>(b), b + 2 * mb,
+                           b + 3 * mb, b + 4 * mb, spectral_density, Q_thresh, rel_err_thresh,
+                           err_thresh, rel_amp_thresh, amp_thresh);
+  }
+  sum_to_all(buf.data(), buf_all.data(), int(buf.size()));
+
+  std::vector<harminv_result> results(nseries);
+  for (size_t s = 0; s < nseries; ++s) {
+    const double *b = &buf_all[s * block];
+    const size_t num = size_t(b[5 * mb]);
+    const complex<double> *amps = reinterpret_cast<const complex<double> *>(b);
+    results[s].amps.assign(amps, amps + num);
+    results[s].freq_re.assign(b + 2 * mb, b + 2 * mb + num);
+    results[s].freq_im.assign(b + 3 * mb, b + 3 * mb + num);
+    results[s].errors.assign(b + 4 * mb, b + 4 * mb + num);
+  }
+  return results;
+}
+
 } // namespace meep
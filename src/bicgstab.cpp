@@ -15,6 +15,8 @@
  * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  */
 
+#include <algorithm>
+#include <cmath>
 #include <math.h>
 #include <string.h>
 
@@ -73,42 +75,77 @@ using namespace std;
 
 namespace meep {
 
+/* The BLAS-1 kernels below are threaded with OpenMP, and the inner
+   products are accumulated locally and then combined with a single
+   sum_to_all per call, so that several dot products can share one
+   reduction (which dominates the cost for large distributed problems). */
+
+// out[k] = <x[k], y[k]> for k = 0..nd-1, with one reduction
+static void dots(size_t n, int nd, const realnum *const *x, const realnum *const *y,
+                 double *out) {
+  double *local = new double[nd];
+  for (int k = 0; k < nd; ++k) {
+    const realnum *xk = x[k], *yk = y[k];
+    double sum = 0;
+#ifdef HAVE_OPENMP
+#pragma omp parallel for reduction(+ : sum)
+#endif
+    for (ptrdiff_t i = 0; i < (ptrdiff_t)n; ++i)
+      sum += xk[i] * yk[i];
+    local[k] = sum;
+  }
+  sum_to_all(local, out, nd);
+  delete[] local;
+}
+
 static double dot(size_t n, const realnum *x, const realnum *y) {
-  double sum = 0;
-  for (size_t i = 0; i < n; ++i)
-    sum += x[i] * y[i];
-  return sum_to_all(sum);
+  double result;
+  dots(n, 1, &x, &y, &result);
+  return result;
 }
 
-static double norm2(size_t n, const realnum *x) {
-  // note: we don't just do sqrt(dot(n, x, x)) in order to avoid overflow
-  size_t i;
-  double xmax = 0, scale;
-  long double sum = 0;
-  for (i = 0; i < n; ++i) {
-    double xabs = fabs(x[i]);
-    if (xabs > xmax) xmax = xabs;
-  }
+// scaled two-pass norm, safe against overflow/underflow of the squares
+static double norm2_scaled(size_t n, const realnum *x) {
+  double xmax = 0;
+#ifdef HAVE_OPENMP
+#pragma omp parallel for reduction(max : xmax)
+#endif
+  for (ptrdiff_t i = 0; i < (ptrdiff_t)n; ++i)
+    xmax = std::max(xmax, (double)fabs(x[i]));
   xmax = max_to_all(xmax);
   if (xmax == 0) return 0;
-  scale = 1.0 / xmax;
-  for (i = 0; i < n; ++i) {
+  const double scale = 1.0 / xmax;
+  double sum = 0;
+#ifdef HAVE_OPENMP
+#pragma omp parallel for reduction(+ : sum)
+#endif
+  for (ptrdiff_t i = 0; i < (ptrdiff_t)n; ++i) {
     double xs = scale * x[i];
     sum += xs * xs;
   }
   return xmax * sqrt(sum_to_all(sum));
 }
 
-static void xpay(size_t n, realnum *x, double a, const realnum *y) {
-  for (size_t m = 0; m < n; ++m)
-    x[m] += a * y[m];
+/* sqrt of a sum of squares computed with an unscaled dot product, falling
+   back to the scaled two-pass norm only if the sum over/underflowed */
+static double norm2_from_dot(size_t n, const realnum *x, double xx) {
+  if (std::isfinite(xx) && (xx > 1e-280 || xx == 0)) return sqrt(xx);
+  return norm2_scaled(n, x);
 }
 
+static double norm2(size_t n, const realnum *x) { return norm2_from_dot(n, x, dot(n, x, x)); }
+
 #define MEEP_MIN_OUTPUT_TIME 4.0 // output no more often than this many seconds
 
 typedef realnum *prealnum; // grr, ISO C++ forbids new (double*)[...]
 
-/* BiCGSTAB(L) algorithm for the n-by-n problem Ax = b */
+/* BiCGSTAB(L) algorithm for the n-by-n problem Ax = b.
+
+   The minimal-residual (MR) part orthogonalizes the r[j] by modified
+   Gram-Schmidt, as in Sleijpen and Fokkema (solving the normal equations
+   instead would square the condition number); only |r[j]|^2 and <r[0],r[j]>
+   share a reduction.  x, r[0] and u[0] are then updated in one fused pass,
+   and the residual norm is fused with the first <r[0],rtilde>. */
 ptrdiff_t bicgstabL(const int L, const size_t n, realnum *x, bicgstab_op A, void *Adata,
                     const realnum *b, const double tol, int *iters, realnum *work,
                     const bool quiet) {
@@ -137,17 +174,21 @@ ptrdiff_t bicgstabL(const int L, const size_t n, realnum *x, bicgstab_op A, void
   int ierr = 0; // error code to return, if any
   const double breaktol = 1e-30;
 
-  /**** FIXME: check for breakdown conditions(?) during iteration  ****/
-
   // rtilde = r[0] = b - Ax
   realnum *rtilde = work + (2 * L + 2) * n;
   A(x, r[0], Adata);
-  for (size_t m = 0; m < n; ++m)
+#ifdef HAVE_OPENMP
+#pragma omp parallel for
+#endif
+  for (ptrdiff_t m = 0; m < (ptrdiff_t)n; ++m)
     rtilde[m] = r[0][m] = b[m] - r[0][m];
 
   { /* Sleipjen normalizes rtilde in his code; it seems to help slightly */
     double s = 1.0 / norm2(n, rtilde);
-    for (size_t m = 0; m < n; ++m)
+#ifdef HAVE_OPENMP
+#pragma omp parallel for
+#endif
+    for (ptrdiff_t m = 0; m < (ptrdiff_t)n; ++m)
       rtilde[m] *= s;
   }
 
@@ -155,8 +196,14 @@ ptrdiff_t bicgstabL(const int L, const size_t n, realnum *x, bicgstab_op A, void
 
   double rho = 1.0, alpha = 0, omega = 1;
 
-  double resid;
-  while ((resid = norm2(n, r[0])) > tol * bnrm) {
+  while (true) {
+    // |r[0]|^2 and <r[0],rtilde> in a single reduction
+    const realnum *px[2] = {r[0], r[0]}, *py[2] = {r[0], rtilde};
+    double rr[2];
+    dots(n, 2, px, py, rr);
+    double resid = norm2_from_dot(n, r[0], rr[0]);
+    if (resid <= tol * bnrm) break;
+
     ++iter;
     if (!quiet && wall_time() > last_output_wall_time + MEEP_MIN_OUTPUT_TIME) {
       master_printf("residual[%d] = %g\n", iter, resid / bnrm);
@@ -169,28 +216,47 @@ ptrdiff_t bicgstabL(const int L, const size_t n, realnum *x, bicgstab_op A, void
         ierr = -1;
         goto finish;
       }
-      double rho1 = dot(n, r[j], rtilde);
+      double rho1 = j == 0 ? rr[1] : dot(n, r[j], rtilde);
       double beta = alpha * rho1 / rho;
       rho = rho1;
-      for (int i = 0; i <= j; ++i)
-        for (size_t m = 0; m < n; ++m)
+#ifdef HAVE_OPENMP
+#pragma omp parallel for
+#endif
+      for (ptrdiff_t m = 0; m < (ptrdiff_t)n; ++m)
+        for (int i = 0; i <= j; ++i)
           u[i][m] = r[i][m] - beta * u[i][m];
       A(u[j], u[j + 1], Adata);
       alpha = rho / dot(n, u[j + 1], rtilde);
-      for (int i = 0; i <= j; ++i)
-        xpay(n, r[i], -alpha, u[i + 1]);
+#ifdef HAVE_OPENMP
+#pragma omp parallel for
+#endif
+      for (ptrdiff_t m = 0; m < (ptrdiff_t)n; ++m) {
+        for (int i = 0; i <= j; ++i)
+          r[i][m] -= alpha * u[i + 1][m];
+        x[m] += alpha * u[0][m];
+      }
       A(r[j], r[j + 1], Adata);
-      xpay(n, x, alpha, u[0]);
     }
 
     for (int j = 1; j <= L; ++j) {
       for (int i = 1; i < j; ++i) {
         int ij = (j - 1) * L + (i - 1);
         tau[ij] = dot(n, r[j], r[i]) / sigma[i];
-        xpay(n, r[j], -tau[ij], r[i]);
+        realnum *rj = r[j];
+        const realnum *ri = r[i];
+        const double t = tau[ij];
+#ifdef HAVE_OPENMP
+#pragma omp parallel for
+#endif
+        for (ptrdiff_t m = 0; m < (ptrdiff_t)n; ++m)
+          rj[m] -= t * ri[m];
       }
-      sigma[j] = dot(n, r[j], r[j]);
-      gamma_p[j] = dot(n, r[0], r[j]) / sigma[j];
+      // sigma[j] = |r[j]|^2 and <r[0],r[j]> in a single reduction
+      const realnum *px[2] = {r[j], r[0]}, *py[2] = {r[j], r[j]};
+      double sr[2];
+      dots(n, 2, px, py, sr);
+      sigma[j] = sr[0];
+      gamma_p[j] = sr[1] / sigma[j];
     }
 
     omega = gamma[L] = gamma_p[L];
@@ -205,13 +271,21 @@ ptrdiff_t bicgstabL(const int L, const size_t n, realnum *x, bicgstab_op A, void
         gamma_pp[j] += tau[(i - 1) * L + (j - 1)] * gamma[i + 1];
     }
 
-    xpay(n, x, gamma[1], r[0]);
-    xpay(n, r[0], -gamma_p[L], r[L]);
-    xpay(n, u[0], -gamma[L], u[L]);
-    for (int j = 1; j < L; ++j) { /* TODO: use blas DGEMV (for L > 2) */
-      xpay(n, x, gamma_pp[j], r[j]);
-      xpay(n, r[0], -gamma_p[j], r[j]);
-      xpay(n, u[0], -gamma[j], u[j]);
+    // x += gamma[1] r[0] + sum gamma_pp[j] r[j], r[0] -= sum gamma_p[j] r[j],
+    // u[0] -= sum gamma[j] u[j]
+#ifdef HAVE_OPENMP
+#pragma omp parallel for
+#endif
+    for (ptrdiff_t m = 0; m < (ptrdiff_t)n; ++m) {
+      double xs = gamma[1] * r[0][m], rs = gamma_p[L] * r[L][m], us = gamma[L] * u[L][m];
+      for (int j = 1; j < L; ++j) {
+        xs += gamma_pp[j] * r[j][m];
+        rs += gamma_p[j] * r[j][m];
+        us += gamma[j] * u[j][m];
+      }
+      x[m] += xs;
+      r[0][m] -= rs;
+      u[0][m] -= us;
     }
 
     if (iter == *iters) {
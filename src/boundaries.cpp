@@ -32,6 +32,98 @@ namespace meep {
 
 namespace {
 
+/* Spatial index of the chunks, so that the chunks owning a point can be
+   found without calling owns() on every chunk.  The bounding box of all
+   the chunks is divided into a uniform grid of bins, and each bin lists
+   (in increasing order) the chunks whose grid_volume overlaps it. */
+class chunk_owner_index {
+public:
+  chunk_owner_index(fields_chunk *const *chunks, int num_chunks, ndim dim) : dim(dim) {
+    FOR_DIRECTIONS(d) {
+      lo[d] = hi[d] = 0;
+      width[d] = nbins[d] = 1;
+    }
+    if (num_chunks == 0) return;
+    LOOP_OVER_DIRECTIONS(dim, d) {
+      lo[d] = chunks[0]->gv.little_corner().in_direction(d);
+      hi[d] = chunks[0]->gv.big_corner().in_direction(d);
+      for (int j = 1; j < num_chunks; ++j) {
+        lo[d] = std::min(lo[d], chunks[j]->gv.little_corner().in_direction(d));
+        hi[d] = std::max(hi[d], chunks[j]->gv.big_corner().in_direction(d));
+      }
+    }
+    // about two bins per chunk along each direction
+    const int nd = number_of_directions(dim);
+    const int nb = int(ceil(2 * pow(double(num_chunks), 1.0 / nd)));
+    size_t ntot = 1;
+    LOOP_OVER_DIRECTIONS(dim, d) {
+      nbins[d] = std::max(1, std::min(nb, hi[d] - lo[d] + 1));
+      width[d] = (hi[d] - lo[d]) / nbins[d] + 1;
+      ntot *= nbins[d];
+    }
+
+    // counting pass, then fill (CSR storage)
+    start.assign(ntot + 1, 0);
+    for (int pass = 0; pass < 2; ++pass) {
+      for (int j = 0; j < num_chunks; ++j) {
+        int b0[5], b1[5], b[5];
+        FOR_DIRECTIONS(d) { b0[d] = b1[d] = b[d] = 0; }
+        LOOP_OVER_DIRECTIONS(dim, d) {
+          b[d] = b0[d] = bin(d, chunks[j]->gv.little_corner().in_direction(d));
+          b1[d] = bin(d, chunks[j]->gv.big_corner().in_direction(d));
+        }
+        while (true) { // loop over the bins b0..b1 that this chunk overlaps
+          const size_t k = flat_index(b);
+          if (pass == 0)
+            ++start[k + 1];
+          else
+            owners[fill[k]++] = j;
+          direction d = start_at_direction(dim);
+          for (; d <= stop_at_direction(dim); d = direction(d + 1)) {
+            if (++b[d] <= b1[d]) break;
+            b[d] = b0[d];
+          }
+          if (d > stop_at_direction(dim)) break;
+        }
+      }
+      if (pass == 0) {
+        for (size_t k = 0; k < ntot; ++k)
+          start[k + 1] += start[k];
+        owners.resize(start[ntot]);
+        fill.assign(start.begin(), start.end() - 1);
+      }
+    }
+  }
+
+  // sets [*begin, *end) to the chunks that might own p
+  void candidates(const ivec &p, const int **begin, const int **end) const {
+    *begin = *end = owners.data();
+    if (start.empty()) return;
+    int b[5] = {0, 0, 0, 0, 0};
+    LOOP_OVER_DIRECTIONS(dim, d) {
+      const int x = p.in_direction(d);
+      if (x < lo[d] || x > hi[d]) return;
+      b[d] = bin(d, x);
+    }
+    const size_t k = flat_index(b);
+    *begin = owners.data() + start[k];
+    *end = owners.data() + start[k + 1];
+  }
+
+private:
+  int bin(direction d, int x) const { return std::min((x - lo[d]) / width[d], nbins[d] - 1); }
+  size_t flat_index(const int b[5]) const {
+    size_t k = 0;
+    LOOP_OVER_DIRECTIONS(dim, d) { k = k * nbins[d] + b[d]; }
+    return k;
+  }
+
+  ndim dim;
+  int lo[5], hi[5], width[5], nbins[5];
+  std::vector<size_t> start, fill;
+  std::vector<int> owners;
+};
+
 // Creates an optimized comms_sequence from a vector of comms_operations.
 // Send operations are prioritized in descending order by the amount of data that is transferred.
 comms_sequence optimize_comms_operations(const std::vector<comms_operation> &operations) {
@@ -149,11 +241,9 @@ void fields::disconnect_chunks() {
     chunks[i]->connection_phases.clear();
   }
   FOR_FIELD_TYPES(ft) {
-    for (int i = 0; i < num_chunks * num_chunks; i++) {
-      delete[] comm_blocks[ft][i];
-      comm_blocks[ft][i] = 0;
-    }
+    comm_blocks[ft].clear();
     comms_sequence_for_field[ft].clear();
+    shared_with_W[ft] = false;
   }
   comm_sizes.clear();
 }
@@ -302,42 +392,70 @@ bool fields::locate_component_point(component *c, ivec *there, complex<double> *
 }
 
 void fields_chunk::zero_metal(field_type ft) {
-  for (size_t i = 0; i < num_zeroes[ft]; i++)
-    *(zeroes[ft][i]) = 0.0;
+  for (const metal_box &b : zeroes[ft]) {
+    realnum *fc = f[b.c][b.cmp];
+    if (fc) LOOP_OVER_IVECS(gv, b.is, b.ie, i) { fc[i] = 0.0; }
+  }
 }
 
+/* The points where on_metal_boundary is true lie on at most three planes
+   per direction, so rather than looping over the owned volume we
+   intersect those planes with the owned volume of each component,
+   storing one box (a plane of the chunk) per face that has metal. */
 void fields::find_metals() {
   for (int i = 0; i < num_chunks; i++)
     if (chunks[i]->is_mine()) {
       const grid_volume vi = chunks[i]->gv;
       FOR_FIELD_TYPES(ft) {
-        delete[] chunks[i]->zeroes[ft];
-        // First electric components...
-        chunks[i]->num_zeroes[ft] = 0;
-        DOCMP FOR_COMPONENTS(c) {
-          if (type(c) == ft && chunks[i]->f[c][cmp]) LOOP_OVER_VOL_OWNED(vi, c, n) {
-              if (IVEC_LOOP_AT_BOUNDARY) { // todo: just loop over boundaries
-                IVEC_LOOP_ILOC(vi, here);
-                if (on_metal_boundary(here)) chunks[i]->num_zeroes[ft]++;
-              }
-            }
-        }
-        typedef realnum *realnum_ptr;
-        chunks[i]->zeroes[ft] = new realnum_ptr[chunks[i]->num_zeroes[ft]];
-        size_t num = 0;
+        chunks[i]->zeroes[ft].clear();
         DOCMP FOR_COMPONENTS(c) {
-          if (type(c) == ft && chunks[i]->f[c][cmp]) LOOP_OVER_VOL_OWNED(vi, c, n) {
-              if (IVEC_LOOP_AT_BOUNDARY) { // todo: just loop over boundaries
-                IVEC_LOOP_ILOC(vi, here);
-                if (on_metal_boundary(here))
-                  chunks[i]->zeroes[ft][num++] = chunks[i]->f[c][cmp] + n;
+          if (type(c) == ft && chunks[i]->f[c][cmp]) {
+            const ivec is = vi.little_owned_corner(c), ie = vi.big_corner();
+            LOOP_OVER_DIRECTIONS(gv.dim, d) {
+              int planes[3], nplanes = 0;
+              if (user_volume.has_boundary(High, d) && boundaries[High][d] == Metallic)
+                planes[nplanes++] = user_volume.big_corner().in_direction(d);
+              if (boundaries[Low][d] == Magnetic)
+                planes[nplanes++] = user_volume.little_corner().in_direction(d) + 1;
+              if (boundaries[Low][d] == Metallic)
+                planes[nplanes++] = user_volume.little_corner().in_direction(d);
+              for (int k = 0; k < nplanes; ++k) {
+                const int p = planes[k];
+                if (p < is.in_direction(d) || p > ie.in_direction(d) ||
+                    (p - is.in_direction(d)) % 2 != 0)
+                  continue;
+                metal_box b = {c, cmp, is, ie};
+                b.is.set_direction(d, p);
+                b.ie.set_direction(d, p);
+                chunks[i]->zeroes[ft].push_back(b);
               }
             }
+          }
         }
       }
     }
 }
 
+bool fields_chunk::is_all_metal(field_type ft) const {
+  if (ft != E_stuff && ft != H_stuff) return false;
+  bool any = false;
+  FOR_FT_COMPONENTS(ft, c) {
+    if (!f[c][0]) continue;
+    const direction dc = component_direction(c);
+    FOR_DIRECTIONS(d) {
+      const realnum *u = s->chi1inv[c][d];
+      if (!u) {
+        if (d == dc) return false; // chi1inv == 1
+        continue;
+      }
+      for (size_t j = 0; j < gv.ntot(); ++j)
+        if (u[j] != 0) return false;
+    }
+    any = true;
+  }
+  return any;
+}
+
 bool fields_chunk::needs_W_notowned(component c) {
   for (susceptibility *chiP = s->chiP[type(c)]; chiP; chiP = chiP->next)
     if (chiP->needs_W_notowned(c, f)) return true;
@@ -367,23 +485,39 @@ void fields::connect_the_chunks() {
      non-PML regions) in update_pols, e.g. if we have an anisotropic
      susceptibility.  In this case, we have an additional
      communication step where we communicate the notowned W.  Then,
-     after updating the polarizations, we communicate the notowned E/H
-     ... this does the E/H communication twice between non-PML regions
-     and hence is somewhat wasteful, but greatly simplifies the case
-     of communicating between a PML region (which has a separate W
-     array) and a non-PML region (no separate W). */
+     after updating the polarizations, we communicate the notowned E/H.
+     Between two chunks that both have no separate W array for a
+     component (non-PML regions), W == E/H, so those values are only
+     sent in the W step and are left out of the E/H step; step() always
+     does the W step first, and step_eh_boundaries does it for E/H
+     exchanges elsewhere.  A PML region (which has a separate W array)
+     and a non-PML region (no separate W) still exchange both.
+
+     Whether each component needs the notowned W, followed by whether
+     each chunk has a separate W array for it, are gathered in a single
+     or_to_all of 10 * (num_chunks + 1) flags. */
+  const int nflags = 10 * (num_chunks + 1);
+  std::vector<int> W_flags(2 * nflags, 0);
+  int *my_flags = W_flags.data() + nflags, *needs_W = W_flags.data(),
+      *W_separate = W_flags.data() + 10;
+  for (int i = 0; i < num_chunks; i++)
+    FOR_E_AND_H(c) {
+      if (chunks[i]->needs_W_notowned(c)) my_flags[c - Ex] = 1;
+      my_flags[10 * (i + 1) + c - Ex] = chunks[i]->f_w[c][0] != NULL;
+    }
+  am_now_working_on(MpiAllTime);
+  or_to_all(my_flags, W_flags.data(), nflags);
+  finished_working();
   bool needs_W_notowned[NUM_FIELD_COMPONENTS];
   FOR_COMPONENTS(c) { needs_W_notowned[c] = false; }
   FOR_E_AND_H(c) {
-    for (int i = 0; i < num_chunks; i++)
-      needs_W_notowned[c] = needs_W_notowned[c] || chunks[i]->needs_W_notowned(c);
+    needs_W_notowned[c] = needs_W[c - Ex] != 0;
+    if (needs_W_notowned[c]) shared_with_W[is_electric(c) ? WE_stuff : WH_stuff] = true;
   }
-  am_now_working_on(MpiAllTime);
-  FOR_E_AND_H(c) { needs_W_notowned[c] = or_to_all(needs_W_notowned[c]); }
-  finished_working();
 
   comm_sizes.clear();
   const size_t num_reals_per_voxel = is_real ? 1 : 2;
+  const chunk_owner_index owner_index(chunks, num_chunks, gv.dim);
   for (int i = 0; i < num_chunks; i++) {
     // First count the border elements...
     const grid_volume vi = chunks[i]->gv;
@@ -393,8 +527,11 @@ void fields::connect_the_chunks() {
           component c = corig;
           // We're looking at a border element...
           complex<double> thephase;
-          if (locate_component_point(&c, &here, &thephase) && !on_metal_boundary(here))
-            for (int j = 0; j < num_chunks; j++) {
+          if (locate_component_point(&c, &here, &thephase) && !on_metal_boundary(here)) {
+            const int *jbegin, *jend;
+            owner_index.candidates(here, &jbegin, &jend);
+            for (const int *jp = jbegin; jp != jend; ++jp) {
+              const int j = *jp;
               const std::pair<int, int> pair_j_to_i{j, i};
               if ((chunks[i]->is_mine() || chunks[j]->is_mine()) && chunks[j]->gv.owns(here) &&
                   !(is_B(corig) && is_B(c) && B_redundant[5 * i + corig - Bx] &&
@@ -402,7 +539,10 @@ void fields::connect_the_chunks() {
                 const connect_phase ip = thephase == 1.0
                                              ? CONNECT_COPY
                                              : (thephase == -1.0 ? CONNECT_NEGATE : CONNECT_PHASE);
-                comm_sizes[{type(c), ip, pair_j_to_i}] += num_reals_per_voxel;
+                const bool sent_as_W = needs_W_notowned[corig] &&
+                                       !W_separate[10 * i + corig - Ex] &&
+                                       !W_separate[10 * j + c - Ex];
+                if (!sent_as_W) comm_sizes[{type(c), ip, pair_j_to_i}] += num_reals_per_voxel;
 
                 if (needs_W_notowned[corig]) {
                   field_type f = is_electric(corig) ? WE_stuff : WH_stuff;
@@ -428,17 +568,22 @@ void fields::connect_the_chunks() {
                 }
               } // if is_mine and owns...
             }   // loop over j chunks
+          }     // here in user_volume
         }       // LOOP_OVER_VOL_NOTOWNED
     }           // FOR_COMPONENTS
+  }             // loop over i chunks
 
-    // Allocating comm blocks as we go...
-    FOR_FIELD_TYPES(ft) {
-      for (int j = 0; j < num_chunks; j++) {
-        delete[] comm_blocks[ft][j + i * num_chunks];
-        comm_blocks[ft][j + i * num_chunks] = new realnum[comm_size_tot(ft, {j, i})];
-      }
-    }
-  } // loop over i chunks
+  // The chunk pairs that communicate, in order of increasing (j, i).
+  std::vector<chunk_pair> comm_pairs[NUM_FIELD_TYPES];
+  for (const std::pair<const comms_key, size_t> &key_and_comm_size : comm_sizes)
+    comm_pairs[key_and_comm_size.first.ft].push_back(key_and_comm_size.first.pair);
+  FOR_FIELD_TYPES(ft) {
+    std::vector<chunk_pair> &pairs = comm_pairs[ft];
+    std::sort(pairs.begin(), pairs.end());
+    pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+    for (const chunk_pair &pair : pairs)
+      comm_blocks[ft][chunk_pair_to_index(pair)].resize(comm_size_tot(ft, pair));
+  }
 
   // Preallocate all connection vectors.
   for (const std::pair<const comms_key, size_t> &key_and_comm_size : comm_sizes) {
@@ -465,7 +610,10 @@ void fields::connect_the_chunks() {
           std::complex<double> thephase_double;
           if (locate_component_point(&c, &here, &thephase_double) && !on_metal_boundary(here)) {
             std::complex<realnum> thephase(thephase_double.real(), thephase_double.imag());
-            for (int j = 0; j < num_chunks; j++) {
+            const int *jbegin, *jend;
+            owner_index.candidates(here, &jbegin, &jend);
+            for (const int *jp = jbegin; jp != jend; ++jp) {
+              const int j = *jp;
               const std::pair<int, int> pair_j_to_i{j, i};
               const bool i_is_mine = chunks[i]->is_mine();
               const bool j_is_mine = chunks[j]->is_mine();
@@ -493,8 +641,11 @@ void fields::connect_the_chunks() {
                         ? CONNECT_COPY
                         : (thephase == static_cast<realnum>(-1.0) ? CONNECT_NEGATE : CONNECT_PHASE);
                 const ptrdiff_t m = chunks[j]->gv.index(c, here);
+                const bool sent_as_W = needs_W_notowned[corig] &&
+                                       !W_separate[10 * i + corig - Ex] &&
+                                       !W_separate[10 * j + c - Ex];
 
-                {
+                if (!sent_as_W) {
                   field_type f = type(c);
                   if (i_is_mine) {
                     if (ip == CONNECT_PHASE) { push_back_phase(f); }
@@ -586,35 +737,33 @@ void fields::connect_the_chunks() {
     std::vector<comms_operation> operations;
     std::vector<int> tagto(count_processors());
 
-    for (int j = 0; j < num_chunks; j++) {
-      for (int i = 0; i < num_chunks; i++) {
-        const chunk_pair pair{j, i};
-        const size_t comm_size = comm_size_tot(f, pair);
-        if (!comm_size) continue;
-        if (comm_size > manager->max_transfer_size()) {
-          // MPI uses int for size to send/recv
-          meep::abort("communications size too big for the current implementation");
-        }
-        const int pair_idx = j + i * num_chunks;
-
-        if (chunks[j]->is_mine()) {
-          operations.push_back(comms_operation{/*my_chunk_idx=*/j,
-                                               /*other_chunk_idx=*/i,
-                                               /*other_proc_id=*/chunks[i]->n_proc(),
-                                               /*pair_idx=*/pair_idx,
-                                               /*transfer_size=*/comm_size,
-                                               /*comm_direction=*/Outgoing,
-                                               /*tag=*/tagto[chunks[i]->n_proc()]++});
-        }
-        if (chunks[i]->is_mine()) {
-          operations.push_back(comms_operation{/*my_chunk_idx=*/i,
-                                               /*other_chunk_idx=*/j,
-                                               /*other_proc_id=*/chunks[j]->n_proc(),
-                                               /*pair_idx=*/pair_idx,
-                                               /*transfer_size=*/comm_size,
-                                               /*comm_direction=*/Incoming,
-                                               /*tag=*/tagto[chunks[j]->n_proc()]++});
-        }
+    for (const chunk_pair &pair : comm_pairs[f]) {
+      const int j = pair.first, i = pair.second;
+      const size_t comm_size = comm_size_tot(f, pair);
+      if (!comm_size) continue;
+      if (comm_size > manager->max_transfer_size()) {
+        // MPI uses int for size to send/recv
+        meep::abort("communications size too big for the current implementation");
+      }
+      const int pair_idx = chunk_pair_to_index(pair);
+
+      if (chunks[j]->is_mine()) {
+        operations.push_back(comms_operation{/*my_chunk_idx=*/j,
+                                             /*other_chunk_idx=*/i,
+                                             /*other_proc_id=*/chunks[i]->n_proc(),
+                                             /*pair_idx=*/pair_idx,
+                                             /*transfer_size=*/comm_size,
+                                             /*comm_direction=*/Outgoing,
+                                             /*tag=*/tagto[chunks[i]->n_proc()]++});
+      }
+      if (chunks[i]->is_mine()) {
+        operations.push_back(comms_operation{/*my_chunk_idx=*/i,
+                                             /*other_chunk_idx=*/j,
+                                             /*other_proc_id=*/chunks[j]->n_proc(),
+                                             /*pair_idx=*/pair_idx,
+                                             /*transfer_size=*/comm_size,
+                                             /*comm_direction=*/Incoming,
+                                             /*tag=*/tagto[chunks[j]->n_proc()]++});
       }
     }
 
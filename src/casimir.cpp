@@ -121,18 +121,25 @@ complex<double> *make_casimir_gfunc(double T, double dt, double sigma, field_typ
 }
 
 typedef struct {
-  double kx, ky, kz;
   double x0, y0, z0;
   direction xd, yd, zd;
-  complex<long double> sum;
   double dV;
+  bool is_bloch;
+  std::vector<size_t> terms; // terms integrating the current component
+  const double *kx, *ky, *kz;
+  complex<long double> *sum;
+  std::vector<complex<double> > fval; // per-chunk scratch: weighted field values
+  std::vector<double> x, y, z;        //   and their coordinates
 } stress_data;
 
 /* chunkloop for the low-level loop_in_chunks routine, to do the
    Casimir stress-tensor integration.  We use this rather than
    fields::integrate because we need to *omit* the 2*pi*r Jacobian
    factor in cylindrical coordinates (which is cancelled by the
-   delta-function normalization in the overall Casimir expression). */
+   delta-function normalization in the overall Casimir expression).
+   The field values on the surface are gathered once, and then every
+   term (DCT mode) integrating this component is accumulated from them,
+   with the terms divided among the threads. */
 static void stress_chunkloop(fields_chunk *fc, int ichunk, component cgrid, ivec is, ivec ie,
                              vec s0, vec s1, vec e0, vec e1, double dV0, double dV1, ivec shift,
                              complex<double> shift_phase, const symmetry &S, int sn, void *data_) {
@@ -140,14 +147,16 @@ static void stress_chunkloop(fields_chunk *fc, int ichunk, component cgrid, ivec
   (void)dV0;
   (void)dV1; // unused
   stress_data *d = (stress_data *)data_;
-  complex<long double> sum = 0.0;
-  complex<double> ph;
   double dV = d->dV;
 
-  ph = shift_phase * S.phase_shift(cgrid, sn);
+  complex<double> ph = shift_phase * S.phase_shift(cgrid, sn);
 
   if (!fc->f[cgrid][0]) return;
 
+  d->fval.clear();
+  d->x.clear();
+  d->y.clear();
+  d->z.clear();
   vec rshift(shift * (0.5 * fc->gv.inva));
   LOOP_OVER_IVECS(fc->gv, is, ie, idx) {
     IVEC_LOOP_LOC(fc->gv, loc);
@@ -156,88 +165,53 @@ static void stress_chunkloop(fields_chunk *fc, int ichunk, component cgrid, ivec
     double fre, fim;
     fre = fc->f[cgrid][0][idx];
     fim = fc->f[cgrid][1] ? fc->f[cgrid][1][idx] : 0.0;
-    complex<double> fval = complex<double>(fre, fim) * ph;
-
-    sum += fval *
-           (cos(d->kx * (loc.in_direction(d->xd) - d->x0)) *
-            cos(d->ky * (loc.in_direction(d->yd) - d->y0)) *
-            cos(d->kz * (loc.in_direction(d->zd) - d->z0)) * IVEC_LOOP_WEIGHT(s0, s1, e0, e1, dV));
+    d->fval.push_back(complex<double>(fre, fim) * ph * IVEC_LOOP_WEIGHT(s0, s1, e0, e1, dV));
+    d->x.push_back(loc.in_direction(d->xd) - d->x0);
+    d->y.push_back(loc.in_direction(d->yd) - d->y0);
+    d->z.push_back(loc.in_direction(d->zd) - d->z0);
   }
 
-  d->sum += sum;
-}
-
-// Identical to stress_chunkloop above, except that we use bloch functions
-// exp(i k x) instead of cosine functions
-static void stress_chunkloop_bloch(fields_chunk *fc, int ichunk, component cgrid, ivec is, ivec ie,
-                                   vec s0, vec s1, vec e0, vec e1, double dV0, double dV1,
-                                   ivec shift, complex<double> shift_phase, const symmetry &S,
-                                   int sn, void *data_) {
-  (void)ichunk;
-  (void)dV0;
-  (void)dV1; // unused
-  stress_data *d = (stress_data *)data_;
-  complex<long double> sum = 0.0;
-  complex<double> ph;
-  double dV = d->dV;
-
-  ph = shift_phase * S.phase_shift(cgrid, sn);
-
-  if (!fc->f[cgrid][0]) return;
-
-  vec rshift(shift * (0.5 * fc->gv.inva));
-  LOOP_OVER_IVECS(fc->gv, is, ie, idx) {
-    IVEC_LOOP_LOC(fc->gv, loc);
-    loc = S.transform(loc, sn) + rshift;
-
-    double fre, fim;
-    fre = fc->f[cgrid][0][idx];
-    fim = fc->f[cgrid][1] ? fc->f[cgrid][1][idx] : 0.0;
-    complex<double> fval = complex<double>(fre, fim) * ph;
-    // coordinate origin is taken to be the center of the unit cell
-    sum += fval *
-           polar(1.0, -d->kx * (loc.in_direction(d->xd) - d->x0) -
-                          d->ky * (loc.in_direction(d->yd) - d->y0) -
-                          d->kz * (loc.in_direction(d->zd) - d->z0)) *
-           IVEC_LOOP_WEIGHT(s0, s1, e0, e1, dV);
+  const ptrdiff_t nterms = d->terms.size(), npts = d->fval.size();
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+  for (ptrdiff_t it = 0; it < nterms; ++it) {
+    const size_t t = d->terms[it];
+    const double kx = d->kx[t], ky = d->ky[t], kz = d->kz[t];
+    complex<long double> sum = 0.0;
+    if (d->is_bloch) // coordinate origin is taken to be the center of the unit cell
+      for (ptrdiff_t i = 0; i < npts; ++i)
+        sum += d->fval[i] * polar(1.0, -kx * d->x[i] - ky * d->y[i] - kz * d->z[i]);
+    else
+      for (ptrdiff_t i = 0; i < npts; ++i)
+        sum += d->fval[i] * (cos(kx * d->x[i]) * cos(ky * d->y[i]) * cos(kz * d->z[i]));
+    d->sum[t] += sum;
   }
-  d->sum += sum;
 }
 
 complex<double> fields::casimir_stress_dct_integral(direction dforce, direction dsource, double mx,
                                                     double my, double mz, field_type ft,
                                                     volume where, bool is_bloch) {
+  casimir_stress_term term = {dforce, dsource, mx, my, mz};
+  return casimir_stress_dct_integrals(std::vector<casimir_stress_term>(1, term), ft, where,
+                                      is_bloch)[0];
+}
+
+std::vector<complex<double> >
+fields::casimir_stress_dct_integrals(const std::vector<casimir_stress_term> &terms, field_type ft,
+                                     volume where, bool is_bloch) {
   direction dnormal = normal_direction(where);
-  direction dcomponent = NO_DIRECTION; // relevant component of field to integrate over
-  double coefficient = 1.0;
+  const size_t nterms = terms.size();
 
   if (where.dim != gv.dim) meep::abort("invalid dimesionality in casimir_stress_dct_integral");
-  if (coordinate_mismatch(gv.dim, dforce) || coordinate_mismatch(gv.dim, dsource))
-    meep::abort("invalid directions in casimir_stress_dct_integral");
+  for (const casimir_stress_term &term : terms)
+    if (coordinate_mismatch(gv.dim, term.dforce) || coordinate_mismatch(gv.dim, term.dsource))
+      meep::abort("invalid directions in casimir_stress_dct_integral");
   if (dnormal == NO_DIRECTION)
     meep::abort("invalid integration surface in casimir_stress_dct_integral");
   if (ft != E_stuff && ft != H_stuff)
     meep::abort("invalid field type in casimir_stress_dct_integral");
 
-  if (dforce != dnormal && dsource != dnormal)
-    return 0.0;
-  else if (dforce != dnormal && dsource == dnormal) {
-    // force-source offdiagonal term
-    dcomponent = dforce;
-  }
-  else if (dforce == dnormal && dsource == dnormal) {
-    // +source-source/2 diagonal term
-    dcomponent = dsource;
-    coefficient = +0.5;
-  }
-  else /* if (dforce == dnormal && dsource != dnormal) */ {
-    // -source-source/2 diagonal term
-    dcomponent = dsource;
-    coefficient = -0.5;
-  }
-
-  component c = direction_component(first_field_component(ft), dcomponent);
-
   stress_data data;
 
   data.zd = Z;
@@ -250,55 +224,87 @@ complex<double> fields::casimir_stress_dct_integral(direction dforce, direction
     data.yd = Y;
   }
 
-  if (has_direction(gv.dim, data.xd) && where.in_direction(data.xd) > 0) {
-    data.x0 = !is_bloch
-                  ? where.in_direction_min(data.xd)
-                  : (0.5 * (where.in_direction_min(data.xd) + where.in_direction_max(data.xd)));
-    data.kx = mx * pi / (!is_bloch ? where.in_direction(data.xd) : 1.0);
-    coefficient *= sqrt((mx == 0 || is_bloch ? 1.0 : 2.0) / where.in_direction(data.xd));
-  }
-  else {
-    data.xd = start_at_direction(gv.dim); // a dir we are guaranteed to have
-    data.x0 = data.kx = 0;                // innocuous values: ignore this dir
-  }
-  if (has_direction(gv.dim, data.yd) && where.in_direction(data.yd) > 0) {
-    data.y0 = !is_bloch
-                  ? where.in_direction_min(data.yd)
-                  : (0.5 * (where.in_direction_min(data.yd) + where.in_direction_max(data.yd)));
-    data.ky = my * pi / (!is_bloch ? where.in_direction(data.yd) : 1.0);
-    coefficient *= sqrt((my == 0 || is_bloch ? 1.0 : 2.0) / where.in_direction(data.yd));
-  }
-  else {
-    data.yd = start_at_direction(gv.dim); // a dir we are guaranteed to have
-    data.y0 = data.ky = 0;                // innocuous values: ignore this dir
-  }
-  if (has_direction(gv.dim, data.zd) && where.in_direction(data.zd) > 0) {
-    data.z0 = !is_bloch
-                  ? where.in_direction_min(data.zd)
-                  : (0.5 * (where.in_direction_min(data.zd) + where.in_direction_max(data.zd)));
-    data.kz = mz * pi / (!is_bloch ? where.in_direction(data.zd) : 1.0);
-    coefficient *= sqrt((mz == 0 || is_bloch ? 1.0 : 2.0) / where.in_direction(data.zd));
-  }
-  else {
-    data.zd = start_at_direction(gv.dim); // a dir we are guaranteed to have
-    data.z0 = data.kz = 0;                // innocuous values: ignore this dir
+  // the cosine (or exponential) in each direction has wavevector m * kscale,
+  // and is normalized by norm(m) = sqrt((m == 0 || is_bloch ? 1 : 2) / length)
+  double kscale[3] = {0, 0, 0}, length[3] = {0, 0, 0};
+  direction *dirs[3] = {&data.xd, &data.yd, &data.zd};
+  double *origin[3] = {&data.x0, &data.y0, &data.z0};
+  for (int k = 0; k < 3; ++k) {
+    const direction d = *dirs[k];
+    if (has_direction(gv.dim, d) && where.in_direction(d) > 0) {
+      *origin[k] = !is_bloch ? where.in_direction_min(d)
+                             : (0.5 * (where.in_direction_min(d) + where.in_direction_max(d)));
+      kscale[k] = pi / (!is_bloch ? where.in_direction(d) : 1.0);
+      length[k] = where.in_direction(d);
+    }
+    else {
+      *dirs[k] = start_at_direction(gv.dim); // a dir we are guaranteed to have
+      *origin[k] = 0;                        // innocuous values: ignore this dir
+    }
   }
 
-  coefficient *= (ft == E_stuff ? real(get_eps(where.center())) : real(get_mu(where.center())));
+  const double material =
+      (ft == E_stuff ? real(get_eps(where.center())) : real(get_mu(where.center())));
+
+  std::vector<double> kx(nterms), ky(nterms), kz(nterms), coefficient(nterms, 0.0);
+  std::vector<component> cs(nterms, NO_COMPONENT);
+  for (size_t t = 0; t < nterms; ++t) {
+    const casimir_stress_term &term = terms[t];
+    direction dcomponent = NO_DIRECTION; // relevant component of field to integrate over
+    double coef = 1.0;
+    if (term.dforce != dnormal && term.dsource != dnormal)
+      continue;
+    else if (term.dforce != dnormal && term.dsource == dnormal) {
+      // force-source offdiagonal term
+      dcomponent = term.dforce;
+    }
+    else if (term.dforce == dnormal && term.dsource == dnormal) {
+      // +source-source/2 diagonal term
+      dcomponent = term.dsource;
+      coef = +0.5;
+    }
+    else /* if (term.dforce == dnormal && term.dsource != dnormal) */ {
+      // -source-source/2 diagonal term
+      dcomponent = term.dsource;
+      coef = -0.5;
+    }
+    cs[t] = direction_component(first_field_component(ft), dcomponent);
 
-  data.sum = 0.0;
+    const double m[3] = {term.mx, term.my, term.mz};
+    double *ks[3] = {&kx[t], &ky[t], &kz[t]};
+    for (int k = 0; k < 3; ++k) {
+      *ks[k] = m[k] * kscale[k];
+      if (length[k] > 0) coef *= sqrt((m[k] == 0 || is_bloch ? 1.0 : 2.0) / length[k]);
+    }
+    coefficient[t] = coef * material;
+  }
+
+  std::vector<complex<long double> > sum(nterms, 0.0);
+  data.kx = kx.data();
+  data.ky = ky.data();
+  data.kz = kz.data();
+  data.sum = sum.data();
+  data.is_bloch = is_bloch;
   data.dV = 1.0;
   LOOP_OVER_DIRECTIONS(gv.dim, d) {
     if (where.in_direction(d) > 0.0) data.dV *= gv.inva;
   }
 
-  if (is_bloch) // complex exponentials exp(i m x)
-    loop_in_chunks(stress_chunkloop_bloch, &data, where, c);
-  else // cosine functions for closed surfaces
-    loop_in_chunks(stress_chunkloop, &data, where, c);
+  // one pass over the surface per field component, covering all the terms that need it
+  FOR_COMPONENTS(c) {
+    data.terms.clear();
+    for (size_t t = 0; t < nterms; ++t)
+      if (cs[t] == c) data.terms.push_back(t);
+    if (!data.terms.empty()) loop_in_chunks(stress_chunkloop, &data, where, c);
+  }
 
-  data.sum = sum_to_all(data.sum);
-  return coefficient * complex<double>(real(data.sum), imag(data.sum));
+  std::vector<complex<double> > local(nterms), out(nterms);
+  for (size_t t = 0; t < nterms; ++t)
+    local[t] = complex<double>(real(sum[t]), imag(sum[t]));
+  sum_to_all(local.data(), out.data(), int(nterms));
+  for (size_t t = 0; t < nterms; ++t)
+    out[t] *= coefficient[t];
+  return out;
 }
 
 /* Similar to make_g above, but now air/metal systems
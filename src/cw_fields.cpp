@@ -15,17 +15,49 @@
  * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  */
 
+#include <algorithm>
+
 #include "meep_internals.hpp"
 #include "bicgstab.hpp"
+#include "config.h"
 
 using namespace std;
 
 namespace meep {
 
-static void fields_to_array(const fields &f, complex<realnum> *x) {
-  size_t ix = 0;
+/* number of complex unknowns of a chunk: just D and B in non-PML regions,
+   but in PML regions the E, U, W, and C fields are also unknowns (in
+   principle, we might be able to compute these extra fields in frequency
+   domain via scalinb by the appropriate s factors, rather than storing
+   them, but I had some problems getting that working) */
+static size_t chunk_unknowns(const fields_chunk *fc) {
+  size_t n = 0;
+  FOR_COMPONENTS(c) {
+    if (fc->f[c][0] && (is_D(c) || is_B(c))) {
+      component c2 = field_type_component(is_D(c) ? E_stuff : H_stuff, c);
+      n += fc->gv.nowned(c) * (1 + (fc->f_u[c][0] != NULL) + (fc->f_w[c2][0] != NULL) * 2 +
+                               (fc->f_cond[c][0] != NULL) + (fc->f_bfast[c][0] != NULL));
+    }
+  }
+  return n;
+}
+
+/* offset of each chunk's unknowns in the array, so that the chunks can be
+   copied in parallel; the last element is the total number of unknowns */
+static std::vector<size_t> chunk_offsets(const fields &f) {
+  std::vector<size_t> offset(f.num_chunks + 1, 0);
+  for (int i = 0; i < f.num_chunks; i++)
+    offset[i + 1] = offset[i] + (f.chunks[i]->is_mine() ? chunk_unknowns(f.chunks[i]) : 0);
+  return offset;
+}
+
+static void fields_to_array(const fields &f, const std::vector<size_t> &offset,
+                            complex<realnum> *x) {
+  CHUNK_OPENMP
   for (int i = 0; i < f.num_chunks; i++)
-    if (f.chunks[i]->is_mine()) FOR_COMPONENTS(c) {
+    if (f.chunks[i]->is_mine()) {
+      size_t ix = offset[i];
+      FOR_COMPONENTS(c) {
         if (is_D(c) || is_B(c)) {
           realnum *fr, *fi;
 #define COPY_FROM_FIELD(fld)                                                                       \
@@ -42,12 +74,16 @@ static void fields_to_array(const fields &f, complex<realnum> *x) {
 #undef COPY_FROM_FIELD
         }
       }
+    }
 }
 
-static void array_to_fields(const complex<realnum> *x, fields &f) {
-  size_t ix = 0;
+static void array_to_fields(const complex<realnum> *x, const std::vector<size_t> &offset,
+                            fields &f) {
+  CHUNK_OPENMP
   for (int i = 0; i < f.num_chunks; i++)
-    if (f.chunks[i]->is_mine()) FOR_COMPONENTS(c) {
+    if (f.chunks[i]->is_mine()) {
+      size_t ix = offset[i];
+      FOR_COMPONENTS(c) {
         if (is_D(c) || is_B(c)) {
           realnum *fr, *fi;
 #define COPY_TO_FIELD(fld)                                                                         \
@@ -66,6 +102,7 @@ static void array_to_fields(const complex<realnum> *x, fields &f) {
 #undef COPY_TO_FIELD
         }
       }
+    }
 
   f.step_boundaries(D_stuff);
   f.update_eh(E_stuff, true);
@@ -79,24 +116,130 @@ static void array_to_fields(const complex<realnum> *x, fields &f) {
 
 typedef struct {
   size_t n;
+  std::vector<size_t> offset;
   fields *f;
   complex<double> iomega;
+  int precond_steps;
 } fieldop_data;
 
 static void fieldop(const realnum *xr, realnum *yr, void *data_) {
   const complex<realnum> *x = reinterpret_cast<const complex<realnum> *>(xr);
   complex<realnum> *y = reinterpret_cast<complex<realnum> *>(yr);
   fieldop_data *data = (fieldop_data *)data_;
-  array_to_fields(x, *data->f);
+  array_to_fields(x, data->offset, *data->f);
   data->f->step();
-  fields_to_array(*data->f, y);
+  fields_to_array(*data->f, data->offset, y);
   size_t n = data->n;
   realnum dt_inv = 1.0 / data->f->dt;
   complex<realnum> iomega = complex<realnum>(real(data->iomega), imag(data->iomega));
-  for (size_t i = 0; i < n; ++i)
+#ifdef HAVE_OPENMP
+#pragma omp parallel for
+#endif
+  for (ptrdiff_t i = 0; i < (ptrdiff_t)n; ++i)
     y[i] = (y[i] - x[i]) * dt_inv + iomega * x[i];
 }
 
+/* Time-stepping (polynomial) preconditioner.  With e = exp(i omega dt)
+   = 1 / (1 - iomega dt), the operator above is A = (T - 1/e) / dt in terms
+   of the timestep operator T.  Letting S = e T, the right preconditioner
+
+      P = -dt e (1 + S + S^2 + ... + S^(K-1))
+
+   gives A P = 1 - S^K, i.e. K phase-shifted timesteps with no inner
+   products in between.  Components that are not resonant near omega decay
+   or dephase under S^K, so the preconditioned spectrum is clustered around 1
+   and BiCGSTAB needs far fewer (communicating) iterations. */
+static complex<realnum> step_phase(const fieldop_data *data) {
+  complex<double> e = 1.0 / (1.0 - data->iomega * data->f->dt);
+  return complex<realnum>(real(e), imag(e));
+}
+
+// y = S x (y may be the same array as x)
+static void phased_step(const complex<realnum> *x, complex<realnum> *y, fieldop_data *data) {
+  array_to_fields(x, data->offset, *data->f);
+  data->f->step();
+  fields_to_array(*data->f, data->offset, y);
+  complex<realnum> e = step_phase(data);
+  size_t n = data->n;
+#ifdef HAVE_OPENMP
+#pragma omp parallel for
+#endif
+  for (ptrdiff_t i = 0; i < (ptrdiff_t)n; ++i)
+    y[i] *= e;
+}
+
+// y = A P x = x - S^K x
+static void precond_fieldop(const realnum *xr, realnum *yr, void *data_) {
+  const complex<realnum> *x = reinterpret_cast<const complex<realnum> *>(xr);
+  complex<realnum> *y = reinterpret_cast<complex<realnum> *>(yr);
+  fieldop_data *data = (fieldop_data *)data_;
+  phased_step(x, y, data);
+  for (int k = 1; k < data->precond_steps; ++k)
+    phased_step(y, y, data);
+  size_t n = data->n;
+#ifdef HAVE_OPENMP
+#pragma omp parallel for
+#endif
+  for (ptrdiff_t i = 0; i < (ptrdiff_t)n; ++i)
+    y[i] = x[i] - y[i];
+}
+
+// y += P x, overwriting the workspace tmp (length n)
+static void add_precond(const complex<realnum> *x, complex<realnum> *y, complex<realnum> *tmp,
+                        fieldop_data *data) {
+  complex<double> c = -data->f->dt * complex<double>(step_phase(data));
+  complex<realnum> cr(real(c), imag(c));
+  size_t n = data->n;
+  memcpy(tmp, x, n * sizeof(complex<realnum>));
+  for (int k = 0; k < data->precond_steps; ++k) {
+    if (k > 0) phased_step(tmp, tmp, data);
+#ifdef HAVE_OPENMP
+#pragma omp parallel for
+#endif
+    for (ptrdiff_t i = 0; i < (ptrdiff_t)n; ++i)
+      y[i] += cr * tmp[i];
+  }
+}
+
+static double norm2(const complex<realnum> *x, size_t n) {
+  double sum = 0;
+#ifdef HAVE_OPENMP
+#pragma omp parallel for reduction(+ : sum)
+#endif
+  for (ptrdiff_t i = 0; i < (ptrdiff_t)n; ++i)
+    sum += norm(complex<double>(x[i]));
+  return sqrt(sum_to_all(sum));
+}
+
+/* Solve A x = b by BiCGSTAB(L), where x is the initial guess on input.  With
+   the preconditioner, we solve (A P) z = b - A x for z starting from z = 0
+   and then set x += P z; r and z are extra arrays of length n. */
+static int cw_solve(int L, size_t N, complex<realnum> *x, complex<realnum> *b, double tol,
+                    int *iters, realnum *work, complex<realnum> *r, complex<realnum> *z,
+                    fieldop_data *data) {
+  if (data->precond_steps <= 0)
+    return (int)bicgstabL(L, N, reinterpret_cast<realnum *>(x), fieldop, data,
+                          reinterpret_cast<realnum *>(b), tol, iters, work, verbosity == 0);
+  size_t n = data->n;
+  fieldop(reinterpret_cast<realnum *>(x), reinterpret_cast<realnum *>(r), data);
+#ifdef HAVE_OPENMP
+#pragma omp parallel for
+#endif
+  for (ptrdiff_t i = 0; i < (ptrdiff_t)n; ++i)
+    r[i] = b[i] - r[i];
+  double bnorm = norm2(b, n), rnorm = norm2(r, n);
+  if (rnorm <= tol * bnorm) {
+    *iters = 0;
+    return 0;
+  }
+  std::fill(z, z + n, complex<realnum>(0));
+  int ierr = (int)bicgstabL(L, N, reinterpret_cast<realnum *>(z), precond_fieldop, data,
+                            reinterpret_cast<realnum *>(r), tol * bnorm / rnorm, iters, work,
+                            verbosity == 0);
+  add_precond(z, x, reinterpret_cast<complex<realnum> *>(work), data);
+  return ierr;
+}
+
 // Rayleigh-quotient estimate <x,Ax>/<x,x> for eigenfrequency given approximate eigenvector x
 // (length n), overwriting x with Ax and b with x/|x|.
 static complex<double> estimate_eigfreq(complex<realnum> *b, complex<realnum> *x, size_t n,
@@ -124,6 +267,36 @@ static complex<double> estimate_eigfreq(complex<realnum> *b, complex<realnum> *x
   return log(1.0 - iomega * dt) / complex<double>(0, -2 * pi * dt);
 }
 
+/* Set the fields to the response to the J amplitudes from the current time
+   step only, from which the right-hand side of the CW problem is obtained
+   (this zeros the fields). */
+void fields::cw_source_fields() {
+  zero_fields();
+  calc_sources(time());
+  step_source(B_stuff, true);
+  step_boundaries(B_stuff);
+  update_eh(H_stuff);
+  calc_sources(time() + 0.5 * dt);
+  step_source(D_stuff, true);
+  step_boundaries(D_stuff);
+  update_eh(E_stuff);
+}
+
+// scale the array of source fields into the right-hand side b, checking that it is nonzero
+static void scale_cw_rhs(fields &f, complex<realnum> *b, size_t n) {
+  double mdt_inv = -1.0 / f.dt;
+  for (size_t i = 0; i < n; ++i)
+    b[i] *= mdt_inv;
+  double bmax = 0;
+  for (size_t i = 0; i < n; ++i) {
+    double babs = abs(b[i]);
+    if (babs > bmax) bmax = babs;
+  }
+  f.am_now_working_on(MpiAllTime);
+  if (max_to_all(bmax) == 0.0) meep::abort("zero current amplitudes in solve_cw");
+  f.finished_working();
+}
+
 /* Solve for the CW (constant frequency) field response at the given
    frequency to the sources (with amplitude given by the current sources
    at the current time).  The solver halts at a fractional convergence
@@ -138,9 +311,14 @@ static complex<double> estimate_eigfreq(complex<realnum> *b, complex<realnum> *x
    If the optional argument eigfreq is non-NULL, then the solver is used for a
    shift-and-invert power iteration to find the closest eigenfrequency and
    eigenvector to frequency: the solver is iterated up to eigiters times,
-   or until the estimated eigenfreq stops changing by <= eigtol (relative). */
+   or until the estimated eigenfreq stops changing by <= eigtol (relative).
+
+   If precond_steps > 0, the system is right-preconditioned by that many
+   phase-shifted timesteps (see above); each iteration then costs
+   precond_steps times as many timesteps, but far fewer iterations (and
+   reductions) are needed, especially for lossy or leaky structures. */
 bool fields::solve_cw(double tol, int maxiters, complex<double> frequency, int L,
-                      complex<double> *eigfreq, double eigtol, int eigiters) {
+                      complex<double> *eigfreq, double eigtol, int eigiters, int precond_steps) {
   if (is_real) meep::abort("solve_cw is incompatible with use_real_fields()");
   if (L < 1) meep::abort("solve_cw called with L = %d < 1", L);
   int tsave = t; // save time (gets incremented by iterations)
@@ -150,69 +328,38 @@ bool fields::solve_cw(double tol, int maxiters, complex<double> frequency, int L
 
   step(); // step once to make sure everything is allocated
 
-  size_t N = 0; // size of linear system (on this processor, at least)
-  for (int i = 0; i < num_chunks; i++)
-    if (chunks[i]->is_mine()) {
-      FOR_COMPONENTS(c) {
-        if (chunks[i]->f[c][0] && (is_D(c) || is_B(c))) {
-          component c2 = field_type_component(is_D(c) ? E_stuff : H_stuff, c);
-          /* unknowns are just D and B in non-PML regions, but in PML
-             regions the E, U, W, and C fields are also unknowns (in
-             principle, we might be able to compute these extra fields
-             in frequency domain via scalinb by the appropriate s
-             factors, rather than storing them, but I had some
-             problems getting that working) */
-          N += 2 * chunks[i]->gv.nowned(c) *
-               (1 + (chunks[i]->f_u[c][0] != NULL) + (chunks[i]->f_w[c2][0] != NULL) * 2 +
-                (chunks[i]->f_cond[c][0] != NULL) + (chunks[i]->f_bfast[c][0] != NULL));
-        }
-      }
-    }
+  // size of linear system (on this processor, at least)
+  std::vector<size_t> offset = chunk_offsets(*this);
+  size_t N = 2 * offset[num_chunks];
 
   iters = maxiters;
   size_t nwork = (size_t)bicgstabL(L, N, 0, 0, 0, 0, tol, &iters, 0, true);
-  realnum *work = new realnum[nwork + 2 * N];
+  realnum *work = new realnum[nwork + (precond_steps > 0 ? 4 : 2) * N];
   complex<realnum> *x = reinterpret_cast<complex<realnum> *>(work + nwork);
   complex<realnum> *b = reinterpret_cast<complex<realnum> *>(work + nwork + N);
+  complex<realnum> *r = reinterpret_cast<complex<realnum> *>(work + nwork + 2 * N);
+  complex<realnum> *z = reinterpret_cast<complex<realnum> *>(work + nwork + 3 * N);
 
-  fields_to_array(*this, x); // initial guess = initial fields
+  fields_to_array(*this, offset, x); // initial guess = initial fields
 
-  // get J amplitudes from current time step
-  zero_fields(); // note that we've saved the fields in x above
-  calc_sources(time());
-  step_source(B_stuff, true);
-  step_boundaries(B_stuff);
-  update_eh(H_stuff);
-  calc_sources(time() + 0.5 * dt);
-  step_source(D_stuff, true);
-  step_boundaries(D_stuff);
-  update_eh(E_stuff);
-  fields_to_array(*this, b);
-  double mdt_inv = -1.0 / dt;
-  for (size_t i = 0; i < N / 2; ++i)
-    b[i] *= mdt_inv;
-  {
-    double bmax = 0;
-    for (size_t i = 0; i < N / 2; ++i) {
-      double babs = abs(b[i]);
-      if (babs > bmax) bmax = babs;
-    }
-    am_now_working_on(MpiAllTime);
-    if (max_to_all(bmax) == 0.0) meep::abort("zero current amplitudes in solve_cw");
-    finished_working();
-  }
+  cw_source_fields(); // note that we've saved the fields in x above
+  fields_to_array(*this, offset, b);
+  scale_cw_rhs(*this, b, N / 2);
 
   fieldop_data data;
   data.f = this;
   data.n = N / 2;
+  data.offset = offset;
   data.iomega = ((1.0 - exp(complex<double>(0., -1.) * (2 * pi * frequency) * dt)) * (1.0 / dt));
+  data.precond_steps = precond_steps;
+  const int steps_per_op = precond_steps > 0 ? precond_steps : 1;
   iters = maxiters;
 
-  int ierr = (int)bicgstabL(L, N, reinterpret_cast<realnum *>(x), fieldop, &data,
-                            reinterpret_cast<realnum *>(b), tol, &iters, work, verbosity == 0);
+  int ierr = cw_solve(L, N, x, b, tol, &iters, work, r, z, &data);
 
   if (verbosity > 0) {
-    master_printf("Finished solve_cw after %d CG iters (~ %d timesteps).\n", iters, iters * 2 * L);
+    master_printf("Finished solve_cw after %d CG iters (~ %d timesteps).\n", iters,
+                  iters * 2 * L * steps_per_op);
     if (ierr) master_printf(" -- CONVERGENCE FAILURE (%d) in solve_cw!\n", ierr);
   }
 
@@ -224,8 +371,7 @@ bool fields::solve_cw(double tol, int maxiters, complex<double> frequency, int L
     }
     for (int eigiter = 0; eigiter < eigiters; ++eigiter) {
       iters = maxiters;
-      int ierr = (int)bicgstabL(L, N, reinterpret_cast<realnum *>(x), fieldop, &data,
-                                reinterpret_cast<realnum *>(b), tol, &iters, work, verbosity == 0);
+      int ierr = cw_solve(L, N, x, b, tol, &iters, work, r, z, &data);
       complex<double> newfreq = estimate_eigfreq(b, x, data.n, &data);
       complex<double> dfreq = newfreq - *eigfreq;
       if (verbosity > 0) {
@@ -239,7 +385,7 @@ bool fields::solve_cw(double tol, int maxiters, complex<double> frequency, int L
     memcpy(x, b, N * sizeof(realnum));
   }
 
-  array_to_fields(x, *this);
+  array_to_fields(x, offset, *this);
   step(); // ensure H/B are updated and synced with E/D
 
   delete[] work;
@@ -251,9 +397,177 @@ bool fields::solve_cw(double tol, int maxiters, complex<double> frequency, int L
   return !ierr;
 }
 
+/* Replace x by the combination of the previous solutions xs[k] that
+   minimizes |b - A sum_k c_k xs[k]|, given Txs[k] = T xs[k] (so that
+   A xs[k] = (Txs[k] - xs[k]) / dt + iomega xs[k] for the current iomega).
+   This needs no timesteps and a single reduction, and is a much better
+   starting point than the last solution alone for a sweep of nearby
+   frequencies.  Leaves x unchanged if the projected system is singular. */
+static void recycled_guess(const std::vector<complex<realnum> *> &xs,
+                           const std::vector<complex<realnum> *> &Txs, const complex<realnum> *b,
+                           complex<realnum> *x, const fieldop_data *data) {
+  const int m = xs.size();
+  const size_t n = data->n;
+  const double dt_inv = 1.0 / data->f->dt;
+  // G = W^* W and h = W^* b, where the columns of W are A xs[k]
+  std::vector<complex<double> > Gh(m * m + m, 0.0), w(m);
+  for (size_t i = 0; i < n; ++i) {
+    for (int k = 0; k < m; ++k)
+      w[k] = (complex<double>(Txs[k][i]) - complex<double>(xs[k][i])) * dt_inv +
+             data->iomega * complex<double>(xs[k][i]);
+    for (int k = 0; k < m; ++k) {
+      for (int l = 0; l <= k; ++l)
+        Gh[k * m + l] += conj(w[k]) * w[l];
+      Gh[m * m + k] += conj(w[k]) * complex<double>(b[i]);
+    }
+  }
+  std::vector<complex<double> > sums(m * m + m);
+  sum_to_all(Gh.data(), sums.data(), m * m + m);
+  complex<double> *G = sums.data(), *c = sums.data() + m * m;
+
+  // Cholesky factorization G = R R^* (lower triangle), then solve G c = h
+  for (int j = 0; j < m; ++j) {
+    double d = real(G[j * m + j]);
+    for (int k = 0; k < j; ++k)
+      d -= norm(G[j * m + k]);
+    if (!(d > 1e-14 * real(G[j * m + j]))) return; // (nearly) dependent solutions
+    d = sqrt(d);
+    G[j * m + j] = d;
+    for (int i = j + 1; i < m; ++i) {
+      complex<double> t = G[i * m + j];
+      for (int k = 0; k < j; ++k)
+        t -= G[i * m + k] * conj(G[j * m + k]);
+      G[i * m + j] = t / d;
+    }
+  }
+  for (int i = 0; i < m; ++i) {
+    for (int k = 0; k < i; ++k)
+      c[i] -= G[i * m + k] * c[k];
+    c[i] /= real(G[i * m + i]);
+  }
+  for (int i = m - 1; i >= 0; --i) {
+    for (int k = i + 1; k < m; ++k)
+      c[i] -= conj(G[k * m + i]) * c[k];
+    c[i] /= real(G[i * m + i]);
+  }
+
+  for (size_t i = 0; i < n; ++i) {
+    complex<double> xi = 0;
+    for (int k = 0; k < m; ++k)
+      xi += c[k] * complex<double>(xs[k][i]);
+    x[i] = complex<realnum>(real(xi), imag(xi));
+  }
+}
+
+/* Solve the CW problem, as in solve_cw, for each of a sequence of
+   frequencies, calling func(*this, i, user_data) with the fields set to
+   the solution for freqs[i] (the current time is unchanged).  The linear
+   system is set up once, and each solve starts from the minimal-residual
+   combination of the last nrecycle solutions, so that a sweep over nearby
+   frequencies needs far fewer iterations in total than independent
+   solve_cw calls.  Returns the number of frequencies that failed to
+   converge. */
+int fields::solve_cw_sweep(double tol, int maxiters, const std::vector<complex<double> > &freqs,
+                           cw_sweep_func func, void *user_data, int L, int nrecycle) {
+  if (is_real) meep::abort("solve_cw is incompatible with use_real_fields()");
+  if (L < 1) meep::abort("solve_cw called with L = %d < 1", L);
+  if (freqs.empty()) return 0;
+  int tsave = t;
+
+  set_solve_cw_omega(2 * pi * freqs[0]);
+  step(); // step once to make sure everything is allocated
+
+  std::vector<size_t> offset = chunk_offsets(*this);
+  size_t N = 2 * offset[num_chunks];
+
+  /* with dispersive materials, T itself depends on the frequency, so T xs[k]
+     must be recomputed for each frequency rather than stored */
+  bool dispersive = false;
+  for (int i = 0; i < num_chunks; i++)
+    if (chunks[i]->is_mine())
+      FOR_FIELD_TYPES(ft) { dispersive = dispersive || chunks[i]->pol[ft]; }
+  dispersive = or_to_all(dispersive);
+
+  int iters = maxiters;
+  size_t nwork = (size_t)bicgstabL(L, N, 0, 0, 0, 0, tol, &iters, 0, true);
+  realnum *work = new realnum[nwork + 2 * N];
+  complex<realnum> *x = reinterpret_cast<complex<realnum> *>(work + nwork);
+  complex<realnum> *b = reinterpret_cast<complex<realnum> *>(work + nwork + N);
+  std::vector<complex<realnum> *> xs, Txs;
+
+  fields_to_array(*this, offset, x); // initial guess = initial fields
+
+  fieldop_data data;
+  data.f = this;
+  data.n = N / 2;
+  data.offset = offset;
+  data.precond_steps = 0;
+
+  int nfail = 0, total_iters = 0;
+  for (size_t ifreq = 0; ifreq < freqs.size(); ++ifreq) {
+    const complex<double> frequency = freqs[ifreq];
+    set_solve_cw_omega(2 * pi * frequency);
+    data.iomega = ((1.0 - exp(complex<double>(0., -1.) * (2 * pi * frequency) * dt)) * (1.0 / dt));
+
+    t = tsave + 1; // J amplitudes at the same time step as in solve_cw
+    cw_source_fields();
+    fields_to_array(*this, offset, b);
+    scale_cw_rhs(*this, b, N / 2);
+
+    if (!xs.empty()) {
+      if (dispersive)
+        for (size_t k = 0; k < xs.size(); ++k) {
+          array_to_fields(xs[k], offset, *this);
+          step();
+          fields_to_array(*this, offset, Txs[k]);
+        }
+      recycled_guess(xs, Txs, b, x, &data);
+    }
+
+    iters = maxiters;
+    int ierr = cw_solve(L, N, x, b, tol, &iters, work, NULL, NULL, &data);
+    total_iters += iters;
+    if (ierr) ++nfail;
+    if (verbosity > 0) {
+      master_printf("solve_cw_sweep: frequency %g%+gi after %d CG iters.\n", real(frequency),
+                    imag(frequency), iters);
+      if (ierr) master_printf(" -- CONVERGENCE FAILURE (%d) in solve_cw!\n", ierr);
+    }
+
+    array_to_fields(x, offset, *this);
+    step(); // ensure H/B are updated and synced with E/D
+
+    if (nrecycle > 0) { // the fields are now T x, which we store along with x
+      size_t k = ifreq % nrecycle;
+      if (k == xs.size()) {
+        xs.push_back(new complex<realnum>[N / 2]);
+        Txs.push_back(new complex<realnum>[N / 2]);
+      }
+      memcpy(xs[k], x, (N / 2) * sizeof(complex<realnum>));
+      fields_to_array(*this, offset, Txs[k]);
+    }
+
+    t = tsave;
+    if (func) func(*this, ifreq, user_data);
+  }
+  if (verbosity > 0)
+    master_printf("Finished solve_cw_sweep of %zu frequencies after %d CG iters.\n", freqs.size(),
+                  total_iters);
+
+  for (size_t k = 0; k < xs.size(); ++k) {
+    delete[] xs[k];
+    delete[] Txs[k];
+  }
+  delete[] work;
+  t = tsave;
+  unset_solve_cw_omega();
+
+  return nfail;
+}
+
 /* as solve_cw, but infers frequency from sources */
 bool fields::solve_cw(double tol, int maxiters, int L, complex<double> *eigfreq, double eigtol,
-                      int eigiters) {
+                      int eigiters, int precond_steps) {
   complex<double> freq = 0.0;
   for (src_time *s = sources; s; s = s->next) {
     complex<double> sf = s->frequency();
@@ -262,7 +576,7 @@ bool fields::solve_cw(double tol, int maxiters, int L, complex<double> *eigfreq,
     if (sf != 0.0) freq = sf;
   }
   if (freq == 0.0) meep::abort("must pass frequency to solve_cw if sources do not specify one");
-  return solve_cw(tol, maxiters, freq, L, eigfreq, eigtol, eigiters);
+  return solve_cw(tol, maxiters, freq, L, eigfreq, eigtol, eigiters, precond_steps);
 }
 
 } // namespace meep
@@ -52,6 +52,7 @@ struct dft_chunk_data { // for passing to field::loop_in_chunks as void*
   dft_chunk *dft_chunks;
   int decimation_factor;
   bool persist;
+  bool compensated;
 };
 
 dft_chunk::dft_chunk(fields_chunk *fc_, ivec is_, ivec ie_, vec s0_, vec s1_, vec e0_, vec e1_,
@@ -120,6 +121,12 @@ dft_chunk::dft_chunk(fields_chunk *fc_, ivec is_, ivec ie_, vec s0_, vec s1_, ve
   dft = new complex<realnum>[N * Nomega];
   for (size_t i = 0; i < N * Nomega; ++i)
     dft[i] = 0.0;
+  dft_comp = NULL;
+  if (data->compensated) {
+    dft_comp = new complex<realnum>[N * Nomega];
+    for (size_t i = 0; i < N * Nomega; ++i)
+      dft_comp[i] = 0.0;
+  }
   for (int i = 0; i < 5; ++i)
     empty_dim[i] = data->empty_dim[i];
 
@@ -130,6 +137,7 @@ dft_chunk::dft_chunk(fields_chunk *fc_, ivec is_, ivec ie_, vec s0_, vec s1_, ve
 
 dft_chunk::~dft_chunk() {
   delete[] dft;
+  delete[] dft_comp;
   delete[] dft_phase;
 
   // delete from fields_chunk list
@@ -189,6 +197,7 @@ dft_chunk *fields::add_dft(component c, const volume &where, const double *freq,
 
   dft_chunk_data data;
   data.persist = persist;
+  data.compensated = compensated_dft;
   data.c = c;
   data.vc = vc;
 
@@ -270,16 +279,25 @@ void dft_chunk::update_dft(double time) {
     dft_phase[i] = polar(1.0, omega[i] * time) * scale;
 
   int numcmp = fc->f[c][1] ? 2 : 1;
+  const bool stretched = fc->s->has_grid_stretch();
 
   PLOOP_OVER_IVECS(fc->gv, is, ie, idx) {
     size_t idx_dft = IVEC_LOOP_COUNTER;
     double w;
     if (include_dV_and_interp_weights) {
       w = IVEC_LOOP_WEIGHT(s0, s1, e0, e1, dV0 + dV1 * loop_i2);
+      if (stretched) { // physical pixel size on a graded grid
+        IVEC_LOOP_ILOC(fc->gv, here);
+        w *= fc->s->stretch_weight(here, empty_dim);
+      }
       if (sqrt_dV_and_interp_weights) w = sqrt(w);
     }
     else
       w = 1.0;
+    if (stretched) { // physical fields on a graded grid
+      IVEC_LOOP_ILOC(fc->gv, here);
+      w /= fc->s->field_stretch(c, here);
+    }
     realnum f[2]; // real/imag field value at epsilon point
     if (avg2)
       for (int cmp = 0; cmp < numcmp; ++cmp)
@@ -292,7 +310,12 @@ void dft_chunk::update_dft(double time) {
       for (int cmp = 0; cmp < numcmp; ++cmp)
         f[cmp] = w * fc->f[c][cmp][idx];
 
-    if (numcmp == 2) {
+    if (dft_comp) {
+      complex<realnum> fc(f[0], numcmp == 2 ? f[1] : 0);
+      for (int i = 0; i < Nomega; ++i)
+        kahan_add(dft[Nomega * idx_dft + i], dft_comp[Nomega * idx_dft + i], dft_phase[i] * fc);
+    }
+    else if (numcmp == 2) {
       complex<realnum> fc(f[0], f[1]);
       for (int i = 0; i < Nomega; ++i)
         dft[Nomega * idx_dft + i] += dft_phase[i] * fc;
@@ -401,6 +424,9 @@ double dft_chunk::maxomega() const {
 void dft_chunk::scale_dft(complex<double> scale) {
   for (size_t i = 0; i < N * omega.size(); ++i)
     dft[i] *= scale;
+  if (dft_comp)
+    for (size_t i = 0; i < N * omega.size(); ++i)
+      dft_comp[i] *= scale;
   if (next_in_dft) next_in_dft->scale_dft(scale);
 }
 
@@ -410,6 +436,13 @@ void dft_chunk::operator-=(const dft_chunk &chunk) {
 
   for (size_t i = 0; i < N * omega.size(); ++i)
     dft[i] -= chunk.dft[i];
+  if (chunk.dft_comp) // the exact sums are dft - dft_comp
+    for (size_t i = 0; i < N * omega.size(); ++i) {
+      if (dft_comp)
+        dft_comp[i] -= chunk.dft_comp[i];
+      else
+        dft[i] += chunk.dft_comp[i];
+    }
 
   if (next_in_dft) {
     if (!chunk.next_in_dft) meep::abort("Mismatched chunk lists in dft_chunk::operator-=");
@@ -486,6 +519,9 @@ void load_dft_hdf5(dft_chunk *dft_chunks, const char *name, h5file *file, const
   for (dft_chunk *cur = dft_chunks; cur; cur = cur->next_in_dft) {
     size_t Nchunk = cur->N * cur->omega.size() * 2;
     file->read_chunk(1, &istart, &Nchunk, (realnum *)cur->dft);
+    if (cur->dft_comp)
+      for (size_t i = 0; i < cur->N * cur->omega.size(); ++i)
+        cur->dft_comp[i] = 0.0;
     istart += Nchunk;
   }
 }
@@ -974,10 +1010,15 @@ complex<double> dft_chunk::process_dft_component(int rank, direction *ds, ivec m
   int chunk_idx = 0;
   complex<double> integral = 0.0;
   component c_conjugate = (component)(ic_conjugate >= 0 ? ic_conjugate : -ic_conjugate);
+  const bool stretched = fc->s->has_grid_stretch();
   LOOP_OVER_IVECS(fc->gv, is, ie, idx) {
     IVEC_LOOP_LOC(fc->gv, loc);
     loc = S.transform(loc, sn) + rshift;
     double w = IVEC_LOOP_WEIGHT(s0, s1, e0, e1, dV0 + dV1 * loop_i2);
+    if (stretched) { // same weights as update_dft
+      IVEC_LOOP_ILOC(fc->gv, here);
+      w *= fc->s->stretch_weight(here, empty_dim);
+    }
     double interp_w = retain_interp_weights ? IVEC_LOOP_WEIGHT(s0i, s1i, e0i, e1i, 1.0) : 1.0;
 
     complex<double> dft_val =
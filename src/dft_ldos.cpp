@@ -17,6 +17,7 @@
 
 #include "meep.hpp"
 #include "meep_internals.hpp"
+#include "config.h"
 
 using namespace std;
 
@@ -30,6 +31,7 @@ dft_ldos::dft_ldos(double freq_min, double freq_max, int Nfreq) {
     Fdft[i] = Jdft[i] = 0.0;
   Jsum = 1.0;
   saved_overall_scale = 1.0;
+  src_fields = NULL;
 }
 
 dft_ldos::dft_ldos(const std::vector<double> freq_) {
@@ -41,6 +43,7 @@ dft_ldos::dft_ldos(const std::vector<double> freq_) {
     Fdft[i] = Jdft[i] = 0.0;
   Jsum = 1.0;
   saved_overall_scale = 1.0;
+  src_fields = NULL;
 }
 
 dft_ldos::dft_ldos(const double *freq_, size_t Nfreq) : freq(Nfreq) {
@@ -52,6 +55,7 @@ dft_ldos::dft_ldos(const double *freq_, size_t Nfreq) : freq(Nfreq) {
     Fdft[i] = Jdft[i] = 0.0;
   Jsum = 1.0;
   saved_overall_scale = 1.0;
+  src_fields = NULL;
 }
 
 // |c|^2
@@ -94,59 +98,93 @@ complex<double> *dft_ldos::J() const {
   return out;
 }
 
+// Rebuild the flattened source-point arrays if the sources in f have changed since the
+// last call (or f is a different fields object); returns true if the cache was rebuilt.
+bool dft_ldos::cache_sources(fields &f) {
+  std::vector<size_t> versions;
+  for (int ic = 0; ic < f.num_chunks; ic++)
+    if (f.chunks[ic]->is_mine()) versions.push_back(f.chunks[ic]->sources_version);
+  if (&f == src_fields && versions == src_versions) return false;
+  src_fields = &f;
+  src_versions.swap(versions);
+
+  segments.clear();
+  src_index.clear();
+  src_re.clear();
+  src_im.clear();
+  for (int ic = 0; ic < f.num_chunks; ic++)
+    if (f.chunks[ic]->is_mine()) {
+      for (int magnetic = 0; magnetic < 2; ++magnetic)
+        for (const src_vol &sv : f.chunks[ic]->get_sources(magnetic ? B_stuff : D_stuff)) {
+          source_segment seg;
+          seg.ichunk = ic;
+          seg.c = direction_component(magnetic ? Hx : Ex, component_direction(sv.c));
+          seg.magnetic = magnetic;
+          seg.start = src_index.size();
+          seg.abs_sum = 0.0;
+          for (size_t j = 0; j < sv.num_points(); j++) {
+            const complex<double> &A = sv.amplitude_at(j);
+            src_index.push_back(sv.index_at(j));
+            src_re.push_back(real(A));
+            src_im.push_back(-imag(A));
+            seg.abs_sum += abs(A);
+          }
+          seg.end = src_index.size();
+          if (seg.end > seg.start) segments.push_back(seg);
+        }
+    }
+  return true;
+}
+
 void dft_ldos::update(fields &f) {
   complex<double> EJ = 0.0; // integral E * J*
   complex<double> HJ = 0.0; // integral H * J* for magnetic currents
 
   double scale = (f.dt / sqrt(2 * pi));
 
-  // compute Jsum for LDOS normalization purposes
-  // ...don't worry about the tiny inefficiency of recomputing this repeatedly
+  // the source points only change when the sources do, so they are gathered
+  // once into contiguous arrays
+  cache_sources(f);
+
+  // compute Jsum for LDOS normalization purposes, counting only points whose
+  // field component is allocated (as the field arrays may appear later)
   Jsum = 0.0;
 
-  for (int ic = 0; ic < f.num_chunks; ic++)
-    if (f.chunks[ic]->is_mine()) {
-      for (const src_vol &sv : f.chunks[ic]->get_sources(D_stuff)) {
-        component c = direction_component(Ex, component_direction(sv.c));
-        realnum *fr = f.chunks[ic]->f[c][0];
-        realnum *fi = f.chunks[ic]->f[c][1];
-        if (fr && fi) // complex E
-          for (size_t j = 0; j < sv.num_points(); j++) {
-            const ptrdiff_t idx = sv.index_at(j);
-            const complex<double> &A = sv.amplitude_at(j);
-            EJ += complex<double>(fr[idx], fi[idx]) * conj(A);
-            Jsum += abs(A);
-          }
-        else if (fr) { // E is purely real
-          for (size_t j = 0; j < sv.num_points(); j++) {
-            const ptrdiff_t idx = sv.index_at(j);
-            const complex<double> &A = sv.amplitude_at(j);
-            EJ += double(fr[idx]) * conj(A);
-            Jsum += abs(A);
-          }
-        }
+  const ptrdiff_t *idx = src_index.data();
+  const double *Are = src_re.data(), *Aim = src_im.data();
+  for (const source_segment &seg : segments) {
+    const realnum *fr = f.chunks[seg.ichunk]->f[seg.c][0];
+    const realnum *fi = f.chunks[seg.ichunk]->f[seg.c][1];
+    if (fr) Jsum += seg.abs_sum;
+    double sr = 0, si = 0;
+    if (fr && fi) { // complex E or H
+#ifdef HAVE_OPENMP
+#pragma omp simd reduction(+ : sr, si)
+#endif
+      for (size_t j = seg.start; j < seg.end; j++) {
+        const double Fr = fr[idx[j]], Fi = fi[idx[j]];
+        sr += Fr * Are[j] - Fi * Aim[j];
+        si += Fr * Aim[j] + Fi * Are[j];
       }
-      for (const src_vol &sv : f.chunks[ic]->get_sources(B_stuff)) {
-        component c = direction_component(Hx, component_direction(sv.c));
-        realnum *fr = f.chunks[ic]->f[c][0];
-        realnum *fi = f.chunks[ic]->f[c][1];
-        if (fr && fi) // complex H
-          for (size_t j = 0; j < sv.num_points(); j++) {
-            const ptrdiff_t idx = sv.index_at(j);
-            const complex<double> &A = sv.amplitude_at(j);
-            HJ += complex<double>(fr[idx], fi[idx]) * conj(A);
-            Jsum += abs(A);
-          }
-        else if (fr) { // H is purely real
-          for (size_t j = 0; j < sv.num_points(); j++) {
-            const ptrdiff_t idx = sv.index_at(j);
-            const complex<double> &A = sv.amplitude_at(j);
-            HJ += double(fr[idx]) * conj(A);
-            Jsum += abs(A);
-          }
-        }
+    } else if (fr) { // E or H is purely real
+#ifdef HAVE_OPENMP
+#pragma omp simd reduction(+ : sr, si)
+#endif
+      for (size_t j = seg.start; j < seg.end; j++) {
+        const double Fr = fr[idx[j]];
+        sr += Fr * Are[j];
+        si += Fr * Aim[j];
       }
     }
+    if (seg.magnetic)
+      HJ += complex<double>(sr, si);
+    else
+      EJ += complex<double>(sr, si);
+  }
+
+  // correct for dV factors
+  Jsum *= sqrt(f.gv.dV(f.gv.icenter(), 1).computational_volume());
+
   for (size_t i = 0; i < freq.size(); ++i) {
     complex<double> Ephase = polar(1.0, 2 * pi * freq[i] * f.time()) * scale;
     complex<double> Hphase = polar(1.0, 2 * pi * freq[i] * (f.time() - f.dt / 2)) * scale;
@@ -160,9 +198,6 @@ void dft_ldos::update(fields &f) {
         Jdft[i] += Ephase * f.sources->current();
     }
   }
-
-  // correct for dV factors
-  Jsum *= sqrt(f.gv.dV(f.gv.icenter(), 1).computational_volume());
 }
 
 } // namespace meep
@@ -52,7 +52,7 @@ double fields::energy_in_box(const volume &where) {
 }
 
 double fields::field_energy_in_box(const volume &where) {
-  synchronize_magnetic_fields();
+  synchronize_magnetic_fields(&where);
   double cur_step_magnetic_energy = magnetic_energy_in_box(where);
   restore_magnetic_fields();
   return electric_energy_in_box(where) + cur_step_magnetic_energy;
@@ -94,7 +94,8 @@ double fields::magnetic_energy_in_box(const volume &where) {
   return sum;
 }
 
-void fields_chunk::backup_component(component c) {
+// with aux == false, only f is backed up (and restored), not the PML/conductivity arrays
+void fields_chunk::backup_component(component c, bool aux) {
   DOCMP {
     if (c < NUM_FIELD_COMPONENTS && f[c][cmp] &&
         // in mu=1 regions where H==B, don't bother to backup H
@@ -102,32 +103,36 @@ void fields_chunk::backup_component(component c) {
 
 #define BACKUP(f)                                                                                  \
   if (f[c][cmp]) {                                                                                 \
-    if (!f##_backup[c][cmp]) f##_backup[c][cmp] = new realnum[gv.ntot()];                          \
+    if (!f##_backup[c][cmp]) f##_backup[c][cmp] = arena.alloc();                                   \
     memcpy(f##_backup[c][cmp], f[c][cmp], gv.ntot() * sizeof(realnum));                            \
   }
 
       BACKUP(f);
-      BACKUP(f_u);
-      BACKUP(f_w);
-      BACKUP(f_cond);
-      BACKUP(f_bfast);
+      if (aux) {
+        BACKUP(f_u);
+        BACKUP(f_w);
+        BACKUP(f_cond);
+        BACKUP(f_bfast);
+      }
 
 #undef BACKUP
     }
   }
 }
 
-void fields_chunk::restore_component(component c) {
+void fields_chunk::restore_component(component c, bool aux) {
   DOCMP {
 #define RESTORE(f)                                                                                 \
   if (f##_backup[c][cmp] && f[c][cmp])                                                             \
     memcpy(f[c][cmp], f##_backup[c][cmp], gv.ntot() * sizeof(realnum));
 
     RESTORE(f);
-    RESTORE(f_u);
-    RESTORE(f_w);
-    RESTORE(f_cond);
-    RESTORE(f_bfast);
+    if (aux) {
+      RESTORE(f_u);
+      RESTORE(f_w);
+      RESTORE(f_cond);
+      RESTORE(f_bfast);
+    }
 
 #undef RESTORE
   }
@@ -143,8 +148,144 @@ void fields_chunk::average_with_backup(component c) {
   }
 }
 
-void fields::synchronize_magnetic_fields() {
-  if (synchronized_magnetic_fields++) return; // already synched
+void fields_chunk::save_prev_component(component c) {
+  DOCMP {
+    if (f[c][cmp] &&
+        !(is_magnetic(c) && f[c][cmp] == f[direction_component(Bx, component_direction(c))][cmp])) {
+      if (!f_prev[c][cmp]) f_prev[c][cmp] = arena.alloc();
+      memcpy(f_prev[c][cmp], f[c][cmp], gv.ntot() * sizeof(realnum));
+    }
+    else { // H == B is extrapolated along with B
+      arena.release(f_prev[c][cmp]);
+      f_prev[c][cmp] = NULL;
+    }
+  }
+}
+
+/* Whether f_prev holds the previous step of every B and H array.  This is
+   false right after H was lazily split from B (in PML or where mu != 1),
+   since H was then saved along with B. */
+bool fields_chunk::has_prev_magnetic_fields() const {
+  if (!keep_prev) return false;
+  DOCMP {
+    FOR_B_COMPONENTS(c) {
+      if (f[c][cmp] && !f_prev[c][cmp]) return false;
+    }
+    FOR_MAGNETIC_COMPONENTS(c) {
+      if (f[c][cmp] && f[c][cmp] != f[direction_component(Bx, component_direction(c))][cmp] &&
+          !f_prev[c][cmp])
+        return false;
+    }
+  }
+  return true;
+}
+
+/* Given f at t-dt/2 and f_prev at t-3dt/2, linearly extrapolate f to t.
+   This is second-order accurate in dt, like the half-step average. */
+void fields_chunk::extrapolate_from_prev(component c) {
+  DOCMP {
+    realnum *fc = f[c][cmp];
+    const realnum *prev = f_prev[c][cmp];
+    if (fc && prev)
+      for (size_t i = 0; i < gv.ntot(); i++)
+        fc[i] = 1.5 * fc[i] - 0.5 * prev[i];
+  }
+}
+
+static void mark_prev_chunkloop(fields_chunk *fc, int, component, ivec, ivec, vec, vec, vec, vec,
+                                double, double, ivec, std::complex<double>, const symmetry &, int,
+                                void *) {
+  fc->keep_prev = true;
+}
+
+static void check_prev_chunkloop(fields_chunk *fc, int, component, ivec, ivec, vec, vec, vec, vec,
+                                 double, double, ivec, std::complex<double>, const symmetry &, int,
+                                 void *ok) {
+  if (!fc->has_prev_magnetic_fields()) *(bool *)ok = false;
+}
+
+/* Register a volume in which synchronized E/H quantities (flux, energy)
+   will be needed.  From then on, step() keeps a copy of B and H from the
+   previous timestep in every chunk overlapping such a volume, and
+   synchronize_magnetic_fields(&where), for a where within the registered
+   volumes, extrapolates H in time from this copy instead of taking an
+   extra half timestep (with its communication).  The magnetic fields are
+   then synchronized only in the chunks overlapping the registered volumes. */
+void fields::add_sync_volume(const volume &where) {
+  loop_in_chunks(mark_prev_chunkloop, NULL, where, Centered);
+  FOR_MAGNETIC_COMPONENTS(c) {
+    if (gv.has_field(c)) loop_in_chunks(mark_prev_chunkloop, NULL, where, c);
+  }
+  sync_from_prev = true;
+  prev_t = -1; // no valid history until the next step
+}
+
+void fields::clear_sync_volumes() {
+  for (int i = 0; i < num_chunks; i++) {
+    fields_chunk *fc = chunks[i];
+    fc->keep_prev = false;
+    DOCMP2 FOR_COMPONENTS(c) {
+      fc->arena.release(fc->f_prev[c][cmp]);
+      fc->f_prev[c][cmp] = NULL;
+    }
+  }
+  sync_from_prev = false;
+  prev_t = -1;
+}
+
+// called at the beginning of step(), when B and H are at time t-dt/2
+void fields::save_prev_magnetic_fields() {
+  if (!sync_from_prev) return;
+  for (int i = 0; i < num_chunks; i++)
+    if (chunks[i]->is_mine() && chunks[i]->keep_prev) {
+      FOR_B_COMPONENTS(c) { chunks[i]->save_prev_component(c); }
+      FOR_MAGNETIC_COMPONENTS(c) { chunks[i]->save_prev_component(c); }
+    }
+  prev_t = t;
+}
+
+// whether every chunk overlapping where can extrapolate B and H from the previous step
+bool fields::can_synchronize_from_prev(const volume &where) {
+  if (!sync_from_prev || prev_t != t - 1) return false;
+  bool ok = true;
+  loop_in_chunks(check_prev_chunkloop, &ok, where, Centered);
+  FOR_MAGNETIC_COMPONENTS(c) {
+    if (gv.has_field(c)) loop_in_chunks(check_prev_chunkloop, &ok, where, c);
+  }
+  return and_to_all(ok);
+}
+
+/* Synchronize B and H with E, i.e. bring them from t-dt/2 to t, until the
+   matching restore_magnetic_fields().  If where is given, the fields are
+   only needed within where: if it lies in volumes passed to add_sync_volume,
+   only the chunks keeping the previous step are synchronized, cheaply. */
+void fields::synchronize_magnetic_fields(const volume *where) {
+  if (synchronized_magnetic_fields++) { // already synched
+    if (!synchronized_from_prev || (where && can_synchronize_from_prev(*where))) return;
+    // the fields were only synched in some chunks: undo that, and synch everywhere
+    for (int i = 0; i < num_chunks; i++)
+      if (chunks[i]->is_mine() && chunks[i]->keep_prev) {
+        FOR_B_COMPONENTS(c) { chunks[i]->restore_component(c, false); }
+        FOR_MAGNETIC_COMPONENTS(c) { chunks[i]->restore_component(c, false); }
+      }
+    synchronized_from_prev = false;
+  }
+  else
+    synchronized_from_prev = where && can_synchronize_from_prev(*where);
+  if (synchronized_from_prev) { // cheap, purely local synchronization
+    for (int i = 0; i < num_chunks; i++)
+      if (chunks[i]->is_mine() && chunks[i]->keep_prev) {
+        FOR_B_COMPONENTS(c) {
+          chunks[i]->backup_component(c, false);
+          chunks[i]->extrapolate_from_prev(c);
+        }
+        FOR_MAGNETIC_COMPONENTS(c) {
+          chunks[i]->backup_component(c, false);
+          chunks[i]->extrapolate_from_prev(c);
+        }
+      }
+    return;
+  }
   for (int i = 0; i < num_chunks; i++)
     if (chunks[i]->is_mine()) {
       FOR_B_COMPONENTS(c) { chunks[i]->backup_component(c); }
@@ -157,7 +298,7 @@ void fields::synchronize_magnetic_fields() {
   step_boundaries(B_stuff);
   calc_sources(time() + 0.5 * dt); // for integrated H sources
   update_eh(H_stuff);
-  step_boundaries(H_stuff);
+  step_eh_boundaries(H_stuff);
   finished_working();
   for (int i = 0; i < num_chunks; i++)
     if (chunks[i]->is_mine()) {
@@ -171,9 +312,9 @@ void fields::restore_magnetic_fields() {
       || --synchronized_magnetic_fields) // not ready to restore yet
     return;
   for (int i = 0; i < num_chunks; i++)
-    if (chunks[i]->is_mine()) {
-      FOR_B_COMPONENTS(c) { chunks[i]->restore_component(c); }
-      FOR_MAGNETIC_COMPONENTS(c) { chunks[i]->restore_component(c); }
+    if (chunks[i]->is_mine() && (!synchronized_from_prev || chunks[i]->keep_prev)) {
+      FOR_B_COMPONENTS(c) { chunks[i]->restore_component(c, !synchronized_from_prev); }
+      FOR_MAGNETIC_COMPONENTS(c) { chunks[i]->restore_component(c, !synchronized_from_prev); }
     }
 }
 
@@ -184,25 +325,31 @@ double fields::thermo_energy_in_box(const volume &where) {
   return sum_to_all(sum);
 }
 
-/* Compute ExH integral in box using current fields, ignoring fact
-   that this E and H correspond to different times. */
-double fields::flux_in_box_wrongH(direction d, const volume &where) {
-  if (coordinate_mismatch(gv.dim, d)) return 0.0;
-
-  component cE[2] = {Ey, Ez}, cH[2] = {Hz, Hy};
+/* The components whose products give the Poynting flux in direction d:
+   S_d = Re[conj(cE[0]) cH[0]] - Re[conj(cE[1]) cH[1]]. */
+void flux_components(ndim dim, direction d, component cE[2], component cH[2]) {
   switch (d) {
     case X: cE[0] = Ey, cE[1] = Ez, cH[0] = Hz, cH[1] = Hy; break;
     case Y: cE[0] = Ez, cE[1] = Ex, cH[0] = Hx, cH[1] = Hz; break;
     case R: cE[0] = Ep, cE[1] = Ez, cH[0] = Hz, cH[1] = Hp; break;
     case P: cE[0] = Ez, cE[1] = Er, cH[0] = Hr, cH[1] = Hz; break;
     case Z:
-      if (gv.dim == Dcyl)
+      if (dim == Dcyl)
         cE[0] = Er, cE[1] = Ep, cH[0] = Hp, cH[1] = Hr;
       else
         cE[0] = Ex, cE[1] = Ey, cH[0] = Hy, cH[1] = Hx;
       break;
     case NO_DIRECTION: meep::abort("cannot get flux in NO_DIRECTION");
   }
+}
+
+/* Compute ExH integral in box using current fields, ignoring fact
+   that this E and H correspond to different times. */
+double fields::flux_in_box_wrongH(direction d, const volume &where) {
+  if (coordinate_mismatch(gv.dim, d)) return 0.0;
+
+  component cE[2] = {Ey, Ez}, cH[2] = {Hz, Hy};
+  flux_components(gv.dim, d, cE, cH);
 
   long double sum = 0.0;
   for (int i = 0; i < 2; ++i) {
@@ -215,7 +362,7 @@ double fields::flux_in_box_wrongH(direction d, const volume &where) {
 }
 
 double fields::flux_in_box(direction d, const volume &where) {
-  synchronize_magnetic_fields();
+  synchronize_magnetic_fields(&where);
   double cur_step_flux = flux_in_box_wrongH(d, where);
   restore_magnetic_fields();
   return cur_step_flux;
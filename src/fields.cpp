@@ -37,6 +37,9 @@ fields::fields(structure *s, double m, double beta, bool zero_fields_near_cylori
   shared_chunks = s->shared_chunks;
   components_allocated = false;
   synchronized_magnetic_fields = 0;
+  sync_from_prev = synchronized_from_prev = false;
+  prev_t = -1;
+  compensated_dft = false;
   outdir = new char[strlen(s->outdir) + 1];
   strcpy(outdir, s->outdir);
   if (gv.dim == Dcyl) S = S + r_to_minus_r_symmetry(m);
@@ -61,12 +64,6 @@ fields::fields(structure *s, double m, double beta, bool zero_fields_near_cylori
   for (int i = 0; i < num_chunks; i++)
     chunks[i] = new fields_chunk(s->chunks[i], outdir, m, beta, zero_fields_near_cylorigin, i,
                                  loop_tile_base_db, bfast_scaled_k);
-  FOR_FIELD_TYPES(ft) {
-    typedef realnum *realnum_ptr;
-    comm_blocks[ft] = new realnum_ptr[num_chunks * num_chunks];
-    for (int i = 0; i < num_chunks * num_chunks; i++)
-      comm_blocks[ft][i] = 0;
-  }
   for (int b = 0; b < 2; b++)
     FOR_DIRECTIONS(d) {
       if (gv.has_boundary((boundary_side)b, d))
@@ -75,6 +72,7 @@ fields::fields(structure *s, double m, double beta, bool zero_fields_near_cylori
         boundaries[b][d] = None;
     }
   chunk_connections_valid = false;
+  FOR_FIELD_TYPES(ft) { shared_with_W[ft] = false; }
   changed_materials = true;
 
   // unit directions are periodic by default:
@@ -90,6 +88,10 @@ fields::fields(const fields &thef)
   shared_chunks = thef.shared_chunks;
   components_allocated = thef.components_allocated;
   synchronized_magnetic_fields = thef.synchronized_magnetic_fields;
+  sync_from_prev = thef.sync_from_prev;
+  synchronized_from_prev = thef.synchronized_from_prev;
+  prev_t = -1; // f_prev is not copied
+  compensated_dft = thef.compensated_dft;
   outdir = new char[strlen(thef.outdir) + 1];
   strcpy(outdir, thef.outdir);
   m = thef.m;
@@ -115,15 +117,10 @@ fields::fields(const fields &thef)
   chunks = new fields_chunk_ptr[num_chunks];
   for (int i = 0; i < num_chunks; i++)
     chunks[i] = new fields_chunk(*thef.chunks[i], i);
-  FOR_FIELD_TYPES(ft) {
-    typedef realnum *realnum_ptr;
-    comm_blocks[ft] = new realnum_ptr[num_chunks * num_chunks];
-    for (int i = 0; i < num_chunks * num_chunks; i++)
-      comm_blocks[ft][i] = 0;
-  }
   for (int b = 0; b < 2; b++)
     FOR_DIRECTIONS(d) { boundaries[b][d] = thef.boundaries[b][d]; }
   chunk_connections_valid = false;
+  FOR_FIELD_TYPES(ft) { shared_with_W[ft] = false; }
   changed_materials = true;
 }
 
@@ -131,11 +128,6 @@ fields::~fields() {
   for (int i = 0; i < num_chunks; i++)
     delete chunks[i];
   delete[] chunks;
-  FOR_FIELD_TYPES(ft) {
-    for (int i = 0; i < num_chunks * num_chunks; i++)
-      delete[] comm_blocks[ft][i];
-    delete[] comm_blocks[ft];
-  }
   delete sources;
   delete fluxes;
   delete[] outdir;
@@ -168,20 +160,21 @@ fields_chunk::~fields_chunk() {
     if (f[hc][cmp] == f[bc][cmp]) f[bc][cmp] = NULL;
   }
   DOCMP2 FOR_COMPONENTS(c) {
-    delete[] f[c][cmp];
-    delete[] f_u[c][cmp];
-    delete[] f_w[c][cmp];
-    delete[] f_cond[c][cmp];
-    delete[] f_bfast[c][cmp];
-    delete[] f_minus_p[c][cmp];
-    delete[] f_w_prev[c][cmp];
-    delete[] f_backup[c][cmp];
-    delete[] f_u_backup[c][cmp];
-    delete[] f_w_backup[c][cmp];
-    delete[] f_cond_backup[c][cmp];
-    delete[] f_bfast_backup[c][cmp];
-  }
-  delete[] f_rderiv_int;
+    arena.release(f[c][cmp]);
+    arena.release(f_u[c][cmp]);
+    arena.release(f_w[c][cmp]);
+    arena.release(f_cond[c][cmp]);
+    arena.release(f_bfast[c][cmp]);
+    arena.release(f_minus_p[c][cmp]);
+    arena.release(f_w_prev[c][cmp]);
+    arena.release(f_backup[c][cmp]);
+    arena.release(f_u_backup[c][cmp]);
+    arena.release(f_w_backup[c][cmp]);
+    arena.release(f_cond_backup[c][cmp]);
+    arena.release(f_bfast_backup[c][cmp]);
+    arena.release(f_prev[c][cmp]);
+  }
+  arena.release(f_rderiv_int);
   while (dft_chunks) {
     dft_chunk *nxt = dft_chunks->next_in_chunk;
     // keep the dft chunk in memory for adjoint calculations
@@ -191,7 +184,6 @@ fields_chunk::~fields_chunk() {
       delete dft_chunks;
     dft_chunks = nxt;
   }
-  FOR_FIELD_TYPES(ft) { delete[] zeroes[ft]; }
   FOR_FIELD_TYPES(ft) {
     for (polarization_state *cur = pol[ft]; cur;) {
       polarization_state *p = cur;
@@ -242,14 +234,16 @@ void check_tiles(grid_volume gv, const std::vector<grid_volume> &gvs) {
 fields_chunk::fields_chunk(structure_chunk *the_s, const char *od, double m, double beta,
                            bool zero_fields_near_cylorigin, int chunkidx, int loop_tile_base_db,
                            std::vector<double> bfast_scaled_k)
-    : gv(the_s->gv), v(the_s->v), m(m), zero_fields_near_cylorigin(zero_fields_near_cylorigin),
-      beta(beta), bfast_scaled_k(bfast_scaled_k) {
+    : gv(the_s->gv), arena(the_s->gv.ntot()), v(the_s->v), m(m),
+      zero_fields_near_cylorigin(zero_fields_near_cylorigin), beta(beta),
+      bfast_scaled_k(bfast_scaled_k) {
   s = the_s;
   chunk_idx = chunkidx;
   s->refcount++;
   outdir = od;
   new_s = NULL;
   is_real = 0;
+  sources_changed();
   a = s->a;
   Courant = s->Courant;
   dt = s->dt;
@@ -290,16 +284,16 @@ fields_chunk::fields_chunk(structure_chunk *the_s, const char *od, double m, dou
     f_w_backup[c][cmp] = NULL;
     f_cond_backup[c][cmp] = NULL;
     f_bfast_backup[c][cmp] = NULL;
+    f_prev[c][cmp] = NULL;
   }
   f_rderiv_int = NULL;
-  FOR_FIELD_TYPES(ft) {
-    zeroes[ft] = NULL;
-    num_zeroes[ft] = 0;
-  }
+  keep_prev = false;
+  FOR_FIELD_TYPES(ft) { all_metal[ft] = false; }
   figure_out_step_plan();
 }
 
-fields_chunk::fields_chunk(const fields_chunk &thef, int chunkidx) : gv(thef.gv), v(thef.v) {
+fields_chunk::fields_chunk(const fields_chunk &thef, int chunkidx)
+    : gv(thef.gv), arena(thef.gv.ntot()), v(thef.v) {
   chunk_idx = chunkidx;
   s = thef.s;
   s->refcount++;
@@ -311,6 +305,7 @@ fields_chunk::fields_chunk(const fields_chunk &thef, int chunkidx) : gv(thef.gv)
   new_s = thef.new_s;
   new_s->refcount++;
   is_real = thef.is_real;
+  sources_changed();
   a = thef.a;
   Courant = thef.Courant;
   dt = thef.dt;
@@ -346,26 +341,27 @@ fields_chunk::fields_chunk(const fields_chunk &thef, int chunkidx) : gv(thef.gv)
     f_w_backup[c][cmp] = NULL;
     f_cond_backup[c][cmp] = NULL;
     f_bfast_backup[c][cmp] = NULL;
+    f_prev[c][cmp] = NULL;
   }
   FOR_COMPONENTS(c) DOCMP {
     if (!is_magnetic(c) && thef.f[c][cmp]) {
-      f[c][cmp] = new realnum[gv.ntot()];
+      f[c][cmp] = arena.alloc();
       memcpy(f[c][cmp], thef.f[c][cmp], sizeof(realnum) * gv.ntot());
     }
     if (thef.f_u[c][cmp]) {
-      f_u[c][cmp] = new realnum[gv.ntot()];
+      f_u[c][cmp] = arena.alloc();
       memcpy(f_u[c][cmp], thef.f_u[c][cmp], sizeof(realnum) * gv.ntot());
     }
     if (thef.f_w[c][cmp]) {
-      f_w[c][cmp] = new realnum[gv.ntot()];
+      f_w[c][cmp] = arena.alloc();
       memcpy(f_w[c][cmp], thef.f_w[c][cmp], sizeof(realnum) * gv.ntot());
     }
     if (thef.f_cond[c][cmp]) {
-      f_cond[c][cmp] = new realnum[gv.ntot()];
+      f_cond[c][cmp] = arena.alloc();
       memcpy(f_cond[c][cmp], thef.f_cond[c][cmp], sizeof(realnum) * gv.ntot());
     }
     if (thef.f_bfast[c][cmp]) {
-      f_bfast[c][cmp] = new realnum[gv.ntot()];
+      f_bfast[c][cmp] = arena.alloc();
       memcpy(f_bfast[c][cmp], thef.f_bfast[c][cmp], sizeof(realnum) * gv.ntot());
     }
   }
@@ -373,25 +369,23 @@ fields_chunk::fields_chunk(const fields_chunk &thef, int chunkidx) : gv(thef.gv)
     if (thef.f[c][cmp] == thef.f[c - Hx + Bx][cmp])
       f[c][cmp] = f[c - Hx + Bx][cmp];
     else if (thef.f[c][cmp]) {
-      f[c][cmp] = new realnum[gv.ntot()];
+      f[c][cmp] = arena.alloc();
       memcpy(f[c][cmp], thef.f[c][cmp], sizeof(realnum) * gv.ntot());
     }
   }
-  FOR_FIELD_TYPES(ft) {
-    zeroes[ft] = NULL;
-    num_zeroes[ft] = 0;
-  }
+  FOR_FIELD_TYPES(ft) { all_metal[ft] = false; }
   FOR_COMPONENTS(c) DOCMP2 {
     if (thef.f_minus_p[c][cmp]) {
-      f_minus_p[c][cmp] = new realnum[gv.ntot()];
+      f_minus_p[c][cmp] = arena.alloc();
       memcpy(f_minus_p[c][cmp], thef.f_minus_p[c][cmp], sizeof(realnum) * gv.ntot());
     }
     if (thef.f_w_prev[c][cmp]) {
-      f_w_prev[c][cmp] = new realnum[gv.ntot()];
+      f_w_prev[c][cmp] = arena.alloc();
       memcpy(f_w_prev[c][cmp], thef.f_w_prev[c][cmp], sizeof(realnum) * gv.ntot());
     }
   }
   f_rderiv_int = NULL;
+  keep_prev = thef.keep_prev;
   figure_out_step_plan();
 }
 
@@ -486,18 +480,11 @@ bool fields_chunk::alloc_f(component c) {
           /* initially, we just set H == B ... later on, we lazily allocate
              H fields if needed (if mu != 1 or in PML) in update_eh */
           component bc = direction_component(Bx, component_direction(c));
-          if (!f[bc][cmp]) {
-            f[bc][cmp] = new realnum[gv.ntot()];
-            for (size_t i = 0; i < gv.ntot(); i++)
-              f[bc][cmp][i] = 0.0;
-          }
+          if (!f[bc][cmp]) f[bc][cmp] = arena.alloc(); // zero-initialized
           f[c][cmp] = f[bc][cmp];
         }
-        else {
-          f[c][cmp] = new realnum[gv.ntot()];
-          for (size_t i = 0; i < gv.ntot(); i++)
-            f[c][cmp][i] = 0.0;
-        }
+        else
+          f[c][cmp] = arena.alloc();
       }
     }
   return changed;
@@ -577,6 +564,7 @@ void fields_chunk::add_source(field_type ft, src_vol &&src) {
   auto it = std::find_if(sources[ft].begin(), sources[ft].end(),
                          [&src](const src_vol &other) { return src_vol::combinable(src, other); });
 
+  sources_changed();
   if (it != sources[ft].end()) {
     it->add_amplitudes_from(src);
     return;
@@ -587,6 +575,13 @@ void fields_chunk::add_source(field_type ft, src_vol &&src) {
 
 void fields_chunk::remove_sources() {
   FOR_FIELD_TYPES(ft) { sources[ft].clear(); }
+  sources_changed();
+}
+
+void fields_chunk::sources_changed() {
+  // tags are never reused, even by chunks allocated later at the same address
+  static size_t last_version = 0;
+  sources_version = ++last_version;
 }
 
 void fields::remove_sources() {
@@ -648,6 +643,7 @@ void fields_chunk::zero_fields() {
 void fields::zero_fields() {
   for (int i = 0; i < num_chunks; i++)
     chunks[i]->zero_fields();
+  prev_t = -1;
 }
 
 void fields::reset() {
@@ -664,7 +660,7 @@ void fields_chunk::use_real_fields() {
     if (f[hc][1] == f[bc][1]) f[bc][1] = NULL;
   }
   FOR_COMPONENTS(c) if (f[c][1]) {
-    delete[] f[c][1];
+    arena.release(f[c][1]);
     f[c][1] = 0;
   }
   if (is_mine()) FOR_FIELD_TYPES(ft) {
@@ -685,6 +681,13 @@ bool fields::has_nonlinearities(bool parallel) const {
   return parallel ? or_to_all(nonlinear) : nonlinear;
 }
 
+bool fields::has_grid_stretch(bool parallel) const {
+  bool stretched = false;
+  for (int i = 0; i < num_chunks; i++)
+    if (chunks[i]->is_mine()) stretched = stretched || chunks[i]->s->has_grid_stretch();
+  return parallel ? or_to_all(stretched) : stretched;
+}
+
 int fields::phase_in_material(const structure *snew, double time) {
   if (snew->num_chunks != num_chunks)
     meep::abort("Can only phase in similar sets of chunks: %d vs %d\n", snew->num_chunks,
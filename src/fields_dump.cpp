@@ -15,15 +15,18 @@
 %  Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
 */
 
-// Dump/load raw fields data to/from an HDF5 file.  Only
-// works if the number of processors/chunks is the same.
+// Dump/load raw fields data to/from an HDF5 file.  Files written as a
+// single parallel file record the chunk layout and can be loaded into a
+// different layout; otherwise the number of processors/chunks must be the same.
 
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include <algorithm>
 #include <cassert>
+#include <vector>
 
 #include "meep.hpp"
 #include "meep_internals.hpp"
@@ -119,6 +122,8 @@ void fields::dump(const char *filename, bool single_parallel_file) {
   file.create_data("t", 1, dims);
   if (am_master() || !single_parallel_file) file.write_chunk(1, start, dims, _t);
 
+  if (single_parallel_file) dump_fields_chunk_layout(&file);
+
   dump_fields_chunk_field(&file, single_parallel_file, "f",
                           [](fields_chunk *chunk, int c, int d) { return &(chunk->f[c][d]); });
   dump_fields_chunk_field(&file, single_parallel_file, "f_u",
@@ -179,7 +184,7 @@ void fields::load_fields_chunk_field(h5file *h5f, bool single_parallel_file,
           size_t n = num_f[(chunk_i * NUM_FIELD_COMPONENTS + c) * 2 + d];
           realnum **f = field_ptr_getter(chunks[i], c, d);
           if (n == 0) {
-            delete[] *f;
+            chunks[i]->arena.release(*f);
             *f = NULL;
           }
           else {
@@ -189,7 +194,7 @@ void fields::load_fields_chunk_field(h5file *h5f, bool single_parallel_file,
             // allocated in fields_chunk::update_eh during the first timestep
             const direction d_c = component_direction(c);
             if (!(*f) || (*f && is_magnetic(component(c)) && chunks[i]->s->sigsize[d_c] > 1))
-              *f = new realnum[ntot];
+              *f = chunks[i]->arena.alloc();
             my_ntot += ntot;
           }
         }
@@ -229,6 +234,153 @@ void fields::load_fields_chunk_field(h5file *h5f, bool single_parallel_file,
   }
 }
 
+void fields::dump_fields_chunk_layout(h5file *h5f) {
+  /* num_chunks x 7 array of the little corner, size, and owning process of
+     each chunk, so that load can map the data onto a different layout */
+  size_t dims[2] = {(size_t)num_chunks, 7};
+  size_t start[2] = {0, 0};
+  std::vector<double> layout(num_chunks * 7, 0.0);
+  for (int i = 0; i < num_chunks; i++) {
+    const grid_volume &cgv = chunks[i]->gv;
+    LOOP_OVER_DIRECTIONS(gv.dim, d) {
+      layout[i * 7 + (int)d % 3] = cgv.little_corner().in_direction(d);
+      layout[i * 7 + 3 + (int)d % 3] = cgv.num_direction(d);
+    }
+    layout[i * 7 + 6] = chunks[i]->n_proc();
+  }
+  h5f->create_data("chunk_layout", 2, dims, false /* append_data */, false /* single_precision */);
+  if (am_master()) h5f->write_chunk(2, start, dims, layout.data());
+}
+
+bool fields::load_fields_chunk_layout(h5file *h5f, std::vector<grid_volume> &gvs,
+                                      std::vector<int> &procs) {
+  if (!h5f->dataset_exists("chunk_layout")) return false; // written by an older version
+
+  int rank;
+  size_t dims[2];
+  size_t start[2] = {0, 0};
+  h5f->read_size("chunk_layout", &rank, dims, 2);
+  if (rank != 2 || dims[1] != 7) meep::abort("invalid chunk_layout in fields::load");
+  std::vector<double> layout(dims[0] * dims[1]);
+  if (am_master()) h5f->read_chunk(2, start, dims, layout.data());
+  h5f->prevent_deadlock();
+  broadcast(0, layout.data(), layout.size());
+
+  for (size_t i = 0; i < dims[0]; i++) {
+    grid_volume cgv = gv;
+    ivec io(gv.dim);
+    LOOP_OVER_DIRECTIONS(gv.dim, d) {
+      io.set_direction(d, int(layout[i * 7 + (int)d % 3]));
+      cgv.set_num_direction(d, int(layout[i * 7 + 3 + (int)d % 3]));
+    }
+    cgv.set_origin(io);
+    gvs.push_back(cgv);
+    procs.push_back(int(layout[i * 7 + 6]));
+  }
+  return true;
+}
+
+void fields::load_fields_chunk_field_repartitioned(h5file *h5f, const std::string &field_name,
+                                                   FieldPtrGetter field_ptr_getter,
+                                                   FieldNeeded field_needed, bool pml_aux,
+                                                   const std::vector<grid_volume> &old_gvs,
+                                                   const std::vector<int> &old_procs) {
+  const size_t old_num_chunks = old_gvs.size();
+  int rank;
+  size_t dims[3];
+  size_t start[3] = {0, 0, 0};
+
+  std::string num_f_name = std::string("num_") + field_name;
+  h5f->read_size(num_f_name.c_str(), &rank, dims, 3);
+  if (rank != 3 || dims[0] != old_num_chunks || dims[1] != NUM_FIELD_COMPONENTS || dims[2] != 2)
+    meep::abort("chunk mismatch in fields::load");
+  std::vector<size_t> num_f(dims[0] * dims[1] * dims[2]);
+  if (am_master()) h5f->read_chunk(3, start, dims, num_f.data());
+  h5f->prevent_deadlock();
+  broadcast(0, num_f.data(), num_f.size());
+
+  /* dump wrote the data process by process, each process writing its own
+     chunks in order, so recover the offset of every old array */
+  std::vector<size_t> offset(num_f.size());
+  size_t ntotal = 0;
+  const int old_num_procs = *std::max_element(old_procs.begin(), old_procs.end()) + 1;
+  for (int p = 0; p < old_num_procs; p++)
+    for (size_t j = 0; j < old_num_chunks; j++)
+      if (old_procs[j] == p)
+        for (size_t k = j * NUM_FIELD_COMPONENTS * 2; k < (j + 1) * NUM_FIELD_COMPONENTS * 2; k++) {
+          offset[k] = ntotal;
+          ntotal += num_f[k];
+        }
+
+  h5f->read_size(field_name.c_str(), &rank, dims, 1);
+  if (rank != 1 || dims[0] != ntotal) {
+    meep::abort("inconsistent data size for '%s' in fields::load (rank, dims[0]): "
+                "(%d, %zu) != (1, %zu)",
+                field_name.c_str(), rank, dims[0], ntotal);
+  }
+
+  /* fill each of our chunks from the old chunks that overlap it.  A point on
+     the boundary layers shared by two old chunks is taken from the chunk that
+     owns it.  The auxiliary PML arrays (pml_aux) are not communicated, so they
+     are only taken from the owner; where it had none, there was no PML
+     conductivity in that direction and the auxiliary field equals the field
+     itself.  Other points that no old chunk has data for are zero. */
+  enum { NOT_LOADED, FROM_NONOWNER, FROM_OWNER };
+  std::vector<realnum> buf;
+  std::vector<char> loaded;
+  for (int i = 0; i < num_chunks; i++) {
+    if (!chunks[i]->is_mine()) continue;
+    const grid_volume &cgv = chunks[i]->gv;
+    for (int c = 0; c < NUM_FIELD_COMPONENTS; ++c) {
+      for (int d = 0; d < 2; ++d) {
+        realnum **f = field_ptr_getter(chunks[i], c, d);
+        std::vector<size_t> sources;
+        for (size_t j = 0; j < old_num_chunks; j++)
+          if (num_f[(j * NUM_FIELD_COMPONENTS + c) * 2 + d] && old_gvs[j].intersect_with(cgv))
+            sources.push_back(j);
+        if (sources.empty() || !field_needed(chunks[i], component(c))) {
+          chunks[i]->arena.release(*f);
+          *f = NULL;
+          continue;
+        }
+        // as in load_fields_chunk_field, H in the PML region gets its own array
+        const direction d_c = component_direction(c);
+        if (!(*f) || (is_magnetic(component(c)) && chunks[i]->s->sigsize[d_c] > 1 &&
+                      *f == chunks[i]->f[direction_component(Bx, d_c)][d]))
+          *f = chunks[i]->arena.alloc(); // zero-initialized
+        else
+          memset(*f, 0, cgv.ntot() * sizeof(realnum));
+
+        const component cc = component(c);
+        loaded.assign(cgv.ntot(), NOT_LOADED);
+        for (size_t j : sources) {
+          const grid_volume &ogv = old_gvs[j];
+          size_t k = (j * NUM_FIELD_COMPONENTS + c) * 2 + d;
+          size_t n = num_f[k];
+          if (n != ogv.ntot())
+            meep::abort("grid size mismatch %zd vs %zd in fields::load", n, ogv.ntot());
+          buf.resize(n);
+          h5f->read_chunk(1, &offset[k], &n, buf.data());
+          LOOP_OVER_IVECS(cgv, cgv.little_corner() + cgv.iyee_shift(cc),
+                          cgv.big_corner() + cgv.iyee_shift(cc), idx) {
+            IVEC_LOOP_ILOC(cgv, iloc);
+            if (loaded[idx] == FROM_OWNER || !ogv.contains(iloc)) continue;
+            const bool owner = ogv.owns(iloc);
+            if (owner || !pml_aux) {
+              (*f)[idx] = buf[ogv.index(cc, iloc)];
+              loaded[idx] = owner ? FROM_OWNER : FROM_NONOWNER;
+            }
+          }
+        }
+        const realnum *fc = chunks[i]->f[c][d];
+        if (pml_aux && fc)
+          for (size_t idx = 0; idx < cgv.ntot(); idx++)
+            if (loaded[idx] == NOT_LOADED) (*f)[idx] = fc[idx];
+      }
+    }
+  }
+}
+
 void fields::load(const char *filename, bool single_parallel_file) {
   if (verbosity > 0)
     printf("reading fields from file \"%s\" (%d)...\n", filename, single_parallel_file);
@@ -250,26 +402,81 @@ void fields::load(const char *filename, bool single_parallel_file) {
   }
 
   t = static_cast<int>(_t[0]);
+  prev_t = -1;
   calc_sources(time());
 
-  load_fields_chunk_field(&file, single_parallel_file, "f",
-                          [](fields_chunk *chunk, int c, int d) { return &(chunk->f[c][d]); });
-  load_fields_chunk_field(&file, single_parallel_file, "f_u",
-                          [](fields_chunk *chunk, int c, int d) { return &(chunk->f_u[c][d]); });
-  load_fields_chunk_field(&file, single_parallel_file, "f_w",
-                          [](fields_chunk *chunk, int c, int d) { return &(chunk->f_w[c][d]); });
-  load_fields_chunk_field(&file, single_parallel_file, "f_cond",
-                          [](fields_chunk *chunk, int c, int d) { return &(chunk->f_cond[c][d]); });
-  load_fields_chunk_field(
-      &file, single_parallel_file, "f_bfast",
-      [](fields_chunk *chunk, int c, int d) { return &(chunk->f_bfast[c][d]); });
-  load_fields_chunk_field(
-      &file, single_parallel_file, "f_w_prev",
-      [](fields_chunk *chunk, int c, int d) { return &(chunk->f_w_prev[c][d]); });
+  // a single file written with a different chunk layout is remapped onto ours
+  std::vector<grid_volume> old_gvs;
+  std::vector<int> old_procs;
+  bool repartition = single_parallel_file && load_fields_chunk_layout(&file, old_gvs, old_procs);
+  if (repartition && old_gvs.size() == size_t(num_chunks)) {
+    repartition = false;
+    for (int i = 0; i < num_chunks; i++)
+      repartition = repartition || old_procs[i] != chunks[i]->n_proc() ||
+                    old_gvs[i].little_corner() != chunks[i]->gv.little_corner() ||
+                    old_gvs[i].big_corner() != chunks[i]->gv.big_corner();
+  }
+  if (repartition) {
+    bool have_dfts = false;
+    for (int i = 0; i < num_chunks; i++)
+      have_dfts = have_dfts || (chunks[i]->is_mine() && chunks[i]->dft_chunks);
+    if (or_to_all(have_dfts))
+      meep::abort("fields::load cannot map DFT chunks onto a different chunk layout");
+    if (verbosity > 0)
+      master_printf("remapping fields from %zu chunks onto %d chunks...\n", old_gvs.size(),
+                    num_chunks);
+  }
+  auto load_field = [&](const std::string &field_name, FieldPtrGetter field_ptr_getter,
+                        FieldNeeded field_needed, bool pml_aux) {
+    if (repartition)
+      load_fields_chunk_field_repartitioned(&file, field_name, field_ptr_getter, field_needed,
+                                            pml_aux, old_gvs, old_procs);
+    else
+      load_fields_chunk_field(&file, single_parallel_file, field_name, field_ptr_getter);
+  };
 
-  // Load DFT chunks.
+  /* when remapping, the PML auxiliary arrays are only kept where the new chunk has the
+     conductivity that step_db (f_u, f_cond) and update_eh (f_w) allocate them for */
+  auto always = [](fields_chunk *chunk, component c) {
+    (void)chunk;
+    (void)c;
+    return true;
+  };
+  auto needs_u = [](fields_chunk *chunk, component c) {
+    const direction dsigu = cycle_direction(chunk->gv.dim, component_direction(c), 2);
+    return (is_D(c) || is_B(c)) && chunk->s->sigsize[dsigu] > 1;
+  };
+  auto needs_cond = [](fields_chunk *chunk, component c) {
+    const direction d_c = component_direction(c), dsig = cycle_direction(chunk->gv.dim, d_c, 1);
+    return (is_D(c) || is_B(c)) && chunk->s->sigsize[dsig] > 1 && chunk->s->conductivity[c][d_c];
+  };
+  auto needs_w = [](fields_chunk *chunk, component c) {
+    return (is_electric(c) || is_magnetic(c)) && chunk->s->sigsize[component_direction(c)] > 1;
+  };
+
+  load_field(
+      "f", [](fields_chunk *chunk, int c, int d) { return &(chunk->f[c][d]); }, always, false);
+  load_field(
+      "f_u", [](fields_chunk *chunk, int c, int d) { return &(chunk->f_u[c][d]); }, needs_u,
+      true);
+  load_field(
+      "f_w", [](fields_chunk *chunk, int c, int d) { return &(chunk->f_w[c][d]); }, needs_w,
+      true);
+  load_field(
+      "f_cond", [](fields_chunk *chunk, int c, int d) { return &(chunk->f_cond[c][d]); },
+      needs_cond, true);
+  load_field(
+      "f_bfast", [](fields_chunk *chunk, int c, int d) { return &(chunk->f_bfast[c][d]); },
+      always, false);
+  load_field(
+      "f_w_prev", [](fields_chunk *chunk, int c, int d) { return &(chunk->f_w_prev[c][d]); },
+      always, false);
+  // arrays were (re)allocated, so the communication pointers must be rebuilt
+  if (repartition) chunk_connections_valid = false;
+
+  // Load DFT chunks (there are none to load when remapping).
   for (int i = 0; i < num_chunks; i++) {
-    if (single_parallel_file || chunks[i]->is_mine()) {
+    if (!repartition && (single_parallel_file || chunks[i]->is_mine())) {
       char dataname[1024];
       snprintf(dataname, 1024, "chunk%02d", i);
       load_dft_hdf5(chunks[i]->dft_chunks, dataname, &file, 0, single_parallel_file);
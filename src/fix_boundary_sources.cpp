@@ -93,6 +93,7 @@ void fields::fix_boundary_sources() {
             }
           }
           src.needs_boundary_fix = false;
+          chunks[i]->sources_changed();
         }
     }
   }
@@ -167,9 +167,11 @@ static void h5_output_chunkloop(fields_chunk *fc, int ichnk, component cgrid, iv
   for (int k = 0; k < data->ninvmu; ++k)
     fc->gv.yee2cent_offsets(imcs[k], imos[2 * k], imos[2 * k + 1]);
 
+  const bool stretched = fc->s->has_grid_stretch();
   vec rshift(shift * (0.5 * fc->gv.inva));
   LOOP_OVER_IVECS(fc->gv, is, ie, idx) {
     IVEC_LOOP_LOC(fc->gv, loc);
+    IVEC_LOOP_ILOC(fc->gv, here);
     loc = S.transform(loc, sn) + rshift;
 
     for (int i = 0; i < data->num_fields; ++i) {
@@ -207,6 +209,7 @@ static void h5_output_chunkloop(fields_chunk *fc, int ichnk, component cgrid, iv
           else
             f[k] = 0;
         fields[i] = complex<double>(f[0], f[1]) * ph[i];
+        if (stretched) fields[i] /= fc->s->field_stretch(cS[i], here); // physical fields
       }
     }
 
@@ -139,11 +139,11 @@ void fields::initialize_field(component c, complex<double> func(const vec &)) {
   step_boundaries(type(c));
   if (is_D(c)) {
     update_eh(E_stuff);
-    step_boundaries(E_stuff);
+    step_eh_boundaries(E_stuff);
   }
   if (is_B(c)) {
     update_eh(H_stuff);
-    step_boundaries(H_stuff);
+    step_eh_boundaries(H_stuff);
   }
 }
 
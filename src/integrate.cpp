@@ -15,8 +15,11 @@
  * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  */
 
+#include <algorithm>
+
 #include "meep.hpp"
 #include "meep_internals.hpp"
+#include "config.h"
 
 /* generic integration and related routines, based fields::loop_in_chunk */
 
@@ -37,6 +40,7 @@ struct integrate_data {
   int ninvmu;
   component invmu_cs[3];
   direction invmu_ds[3];
+  bool empty_dim[5]; // directions in which the integral has zero width
   complex<double> sum;
   double maxabs;
   field_function integrand;
@@ -76,9 +80,12 @@ static void integrate_chunkloop(fields_chunk *fc, int ichunk, component cgrid, i
   for (int k = 0; k < data->ninvmu; ++k)
     fc->gv.yee2cent_offsets(imcs[k], imos[2 * k], imos[2 * k + 1]);
 
+  const bool stretched = fc->s->has_grid_stretch();
+
   vec rshift(shift * (0.5 * fc->gv.inva));
   LOOP_OVER_IVECS(fc->gv, is, ie, idx) {
     IVEC_LOOP_LOC(fc->gv, loc);
+    IVEC_LOOP_ILOC(fc->gv, here);
     loc = S.transform(loc, sn) + rshift;
 
     for (int i = 0; i < data->num_fvals; ++i) {
@@ -115,13 +122,17 @@ static void integrate_chunkloop(fields_chunk *fc, int ichunk, component cgrid, i
                            fc->f[cS[i]][k][idx + off[2 * i] + off[2 * i + 1]]);
           else
             f[k] = 0;
-        fvals[i] = complex<double>(f[0], f[1]) * ph[i];
+        // physical fields on a graded grid
+        fvals[i] = complex<double>(f[0], f[1]) * ph[i] /
+                   (stretched ? fc->s->field_stretch(cS[i], here) : 1.0);
       }
     }
 
     complex<double> integrand = data->integrand(fvals, loc, data->integrand_data_);
     maxabs = std::max(maxabs, abs(integrand));
-    sum += integrand * IVEC_LOOP_WEIGHT(s0, s1, e0, e1, dV0 + dV1 * loop_i2);
+    double w = IVEC_LOOP_WEIGHT(s0, s1, e0, e1, dV0 + dV1 * loop_i2);
+    if (stretched) w *= fc->s->stretch_weight(here, data->empty_dim); // physical pixel size
+    sum += integrand * w;
   }
 
   data->maxabs = std::max(data->maxabs, maxabs);
@@ -183,6 +194,10 @@ complex<double> fields::integrate(int num_fvals, const component *components,
       ++data.ninvmu;
     }
 
+  data.empty_dim[0] = data.empty_dim[1] = data.empty_dim[2] = data.empty_dim[3] =
+      data.empty_dim[4] = false;
+  LOOP_OVER_DIRECTIONS(where.dim, d) { data.empty_dim[d] = where.in_direction(d) == 0; }
+
   data.offsets = new ptrdiff_t[2 * num_fvals];
   for (int i = 0; i < 2 * num_fvals; ++i)
     data.offsets[i] = 0;
@@ -260,4 +275,334 @@ double fields::max_abs(derived_component c, const volume &where) {
   return max_abs(nfields, cs, fun, &nfields, where);
 }
 
+/***************************************************************************/
+/* reduction_plan: several built-in integrands evaluated in one fused pass */
+
+reduction_plan::reduction_plan(fields &f_, const volume &where_)
+    : f(&f_), where(where_), has_magnetic(false), prepared(false), recording(NULL) {}
+
+int reduction_plan::component_index(component c) {
+  for (size_t i = 0; i < cs.size(); ++i)
+    if (cs[i] == c) return int(i);
+  if (is_magnetic(c) || is_B(c)) has_magnetic = true;
+  cs.push_back(c);
+  prepared = false; // the common grid may have changed
+  return int(cs.size()) - 1;
+}
+
+int reduction_plan::add_term(bool is_max, const std::vector<product> &prods) {
+  term t;
+  t.is_max = is_max;
+  t.prods = prods;
+  terms.push_back(t);
+  return int(terms.size()) - 1;
+}
+
+int reduction_plan::add_field_energy(component c) {
+  std::vector<product> prods;
+  if (!coordinate_mismatch(f->gv.dim, c) && f->gv.has_field(c)) {
+    component c0, c1;
+    if (is_electric(c) || is_D(c)) {
+      c0 = direction_component(Ex, component_direction(c));
+      c1 = direction_component(Dx, component_direction(c));
+    }
+    else if (is_magnetic(c) || is_B(c)) {
+      c0 = direction_component(Hx, component_direction(c));
+      c1 = direction_component(Bx, component_direction(c));
+    }
+    else
+      meep::abort("invalid field component in reduction_plan::add_field_energy");
+    product p = {component_index(c0), component_index(c1), 0.5};
+    prods.push_back(p);
+  }
+  return add_term(false, prods);
+}
+
+int reduction_plan::add_electric_energy() {
+  std::vector<product> prods;
+  FOR_ELECTRIC_COMPONENTS(c) {
+    if (!coordinate_mismatch(f->gv.dim, c) && f->gv.has_field(c)) {
+      product p = {component_index(c),
+                   component_index(direction_component(Dx, component_direction(c))), 0.5};
+      prods.push_back(p);
+    }
+  }
+  return add_term(false, prods);
+}
+
+int reduction_plan::add_magnetic_energy() {
+  std::vector<product> prods;
+  FOR_MAGNETIC_COMPONENTS(c) {
+    if (!coordinate_mismatch(f->gv.dim, c) && f->gv.has_field(c)) {
+      product p = {component_index(c),
+                   component_index(direction_component(Bx, component_direction(c))), 0.5};
+      prods.push_back(p);
+    }
+  }
+  return add_term(false, prods);
+}
+
+int reduction_plan::add_field_energy() {
+  std::vector<product> prods = terms[add_electric_energy()].prods;
+  const std::vector<product> &hprods = terms[add_magnetic_energy()].prods;
+  prods.insert(prods.end(), hprods.begin(), hprods.end());
+  terms.resize(terms.size() - 2);
+  return add_term(false, prods);
+}
+
+int reduction_plan::add_flux(direction d) {
+  std::vector<product> prods;
+  if (!coordinate_mismatch(f->gv.dim, d)) {
+    component cE[2] = {Ey, Ez}, cH[2] = {Hz, Hy};
+    flux_components(f->gv.dim, d, cE, cH);
+    for (int i = 0; i < 2; ++i) {
+      product p = {component_index(cE[i]), component_index(cH[i]), 1.0 - 2 * i};
+      prods.push_back(p);
+    }
+  }
+  return add_term(false, prods);
+}
+
+int reduction_plan::add_max_abs(component c) {
+  if (c < 0 || c >= NUM_FIELD_COMPONENTS)
+    meep::abort("reduction_plan::add_max_abs only supports field components");
+  std::vector<product> prods;
+  if (f->gv.has_field(c)) {
+    int i = component_index(c);
+    product p = {i, i, 1.0};
+    prods.push_back(p);
+  }
+  return add_term(true, prods);
+}
+
+void reduction_plan::record_chunkloop(fields_chunk *fc, int ichunk, component cgrid, ivec is,
+                                      ivec ie, vec s0, vec s1, vec e0, vec e1, double dV0,
+                                      double dV1, ivec shift, complex<double> shift_phase,
+                                      const symmetry &S, int sn, void *data_) {
+  (void)shift; // the integrands do not depend on position
+  reduction_plan *plan = (reduction_plan *)data_;
+  grid &g = *plan->recording;
+  segment seg;
+  seg.chunk_idx = ichunk;
+  const int nf = int(plan->cs.size());
+  seg.cS.resize(nf);
+  seg.off.resize(2 * nf, 0);
+  seg.ph.resize(nf);
+  for (int i = 0; i < nf; ++i) {
+    seg.cS[i] = S.transform(plan->cs[i], -sn);
+    if (cgrid == Centered) fc->gv.yee2cent_offsets(seg.cS[i], seg.off[2 * i], seg.off[2 * i + 1]);
+    seg.ph[i] = shift_phase * S.phase_shift(seg.cS[i], sn);
+  }
+
+  /* On a graded grid, as in fields::integrate, the E and H components are divided by their
+     stretch to get the physical fields, and the weights are the physical pixel sizes.  Both
+     factor into the stretch along the innermost loop direction d3, which goes into w3 and
+     inv3, and the stretch along the two outer loop directions, which goes into the rows. */
+  seg.stretched = fc->s->has_grid_stretch();
+  seg.cloop.assign(nf, 0);
+  const direction d1 = fc->gv.yucky_direction(0), d2 = fc->gv.yucky_direction(1),
+                  d3 = fc->gv.yucky_direction(2);
+  if (seg.stretched)
+    for (int i = 0; i < nf; ++i) {
+      const direction d = component_direction(seg.cS[i]);
+      if ((is_electric(seg.cS[i]) || is_magnetic(seg.cS[i])) && fc->s->stretch[d])
+        seg.cloop[i] = d == d1 ? 1 : d == d2 ? 2 : 3;
+    }
+  bool empty_dim[5] = {false, false, false, false, false}, empty_row[5];
+  LOOP_OVER_DIRECTIONS(plan->where.dim, d) { empty_dim[d] = plan->where.in_direction(d) == 0; }
+  for (int d = 0; d < 5; ++d)
+    empty_row[d] = empty_dim[d] || d == d3;
+
+  const int iseg = int(g.segments.size());
+  LOOP_OVER_IVECS(fc->gv, is, ie, idx) {
+    IVEC_LOOP_ILOC(fc->gv, here);
+    if (loop_i3 == 0) {
+      row r;
+      r.seg = iseg;
+      r.idx0 = idx;
+      r.w = IVEC_LOOP_WEIGHT1(s0, s1, e0, e1, 2) *
+            ((dV0 + dV1 * loop_i2) * IVEC_LOOP_WEIGHT1(s0, s1, e0, e1, 1));
+      r.inv[0] = r.inv[1] = 1.0;
+      if (seg.stretched) {
+        r.w *= fc->s->stretch_weight(here, empty_row);
+        r.inv[0] = 1 / fc->s->stretch_at(d1, here.in_direction(d1));
+        r.inv[1] = 1 / fc->s->stretch_at(d2, here.in_direction(d2));
+      }
+      g.rows.push_back(r);
+      seg.n3 = loop_n3;
+      seg.s3 = loop_s3;
+    }
+    if (loop_i1 == 0 && loop_i2 == 0) {
+      double w3 = IVEC_LOOP_WEIGHT1(s0, s1, e0, e1, 3);
+      if (seg.stretched) {
+        if (!empty_dim[d3]) w3 *= fc->s->stretch_at(d3, here.in_direction(d3));
+        seg.inv3.push_back(1 / fc->s->stretch_at(d3, here.in_direction(d3)));
+      }
+      seg.w3.push_back(w3);
+    }
+    else
+      break; // only the first innermost line is needed to get the weights
+  }
+  g.max_n3 = std::max(g.max_n3, seg.n3);
+  g.segments.push_back(seg);
+}
+
+void reduction_plan::prepare() {
+  /* like fields::integrate for each product, use the Yee grid of its two fields if they share
+     one and the Centered grid otherwise */
+  auto same_grid = [this](component c0, component c1) {
+    if (c0 == Centered || c1 == Centered) return c0 == c1;
+    return f->gv.iyee_shift(c0) == f->gv.iyee_shift(c1);
+  };
+  grids.clear();
+  for (size_t it = 0; it < terms.size(); ++it)
+    for (const product &p : terms[it].prods) {
+      const component cgrid = same_grid(cs[p.a], cs[p.b]) ? cs[p.a] : Centered;
+      size_t ig = 0;
+      while (ig < grids.size() && !same_grid(grids[ig].cgrid, cgrid))
+        ++ig;
+      if (ig == grids.size()) {
+        grid g;
+        g.cgrid = cgrid;
+        g.prods.resize(terms.size());
+        g.max_n3 = 0;
+        grids.push_back(g);
+      }
+      grid &g = grids[ig];
+      g.prods[it].push_back(p);
+      for (int i : {p.a, p.b})
+        if (std::find(g.fields.begin(), g.fields.end(), i) == g.fields.end())
+          g.fields.push_back(i);
+    }
+
+  for (grid &g : grids) {
+    recording = &g;
+    f->loop_in_chunks(record_chunkloop, (void *)this, where, g.cgrid);
+  }
+  recording = NULL;
+  prepared = true;
+}
+
+// grid lines per block of partial sums; the blocks are added up in order
+static const size_t reduction_block = 16;
+
+std::vector<double> reduction_plan::evaluate(bool synchronize_magnetic) {
+  if (!prepared) prepare();
+  const bool sync = synchronize_magnetic && has_magnetic;
+  if (sync) f->synchronize_magnetic_fields(&where);
+
+  const int nf = int(cs.size()), nt = int(terms.size());
+  std::vector<double> sums(nt, 0.0), maxs(nt, 0.0);
+
+  for (const grid &g : grids) {
+    const ptrdiff_t max_n3 = g.max_n3;
+    const size_t nblocks = (g.rows.size() + reduction_block - 1) / reduction_block;
+    std::vector<double> bsum(nblocks * nt, 0.0), bmax(nblocks * nt, 0.0);
+
+#ifdef HAVE_OPENMP
+#pragma omp parallel
+#endif
+    {
+      // per-thread scratch: fields on this grid along one row
+      std::vector<double> re(nf * max_n3), im(nf * max_n3), q(max_n3);
+
+#ifdef HAVE_OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+      for (size_t ib = 0; ib < nblocks; ++ib) {
+        const size_t ir1 = std::min(g.rows.size(), (ib + 1) * reduction_block);
+        for (size_t ir = ib * reduction_block; ir < ir1; ++ir) {
+          const row &r = g.rows[ir];
+          const segment &seg = g.segments[r.seg];
+          const fields_chunk *fc = f->chunks[seg.chunk_idx];
+          const ptrdiff_t n3 = seg.n3, s3 = seg.s3;
+
+          for (int i : g.fields) {
+            double *fre = &re[i * max_n3], *fim = &im[i * max_n3];
+            const ptrdiff_t o1 = seg.off[2 * i], o2 = seg.off[2 * i + 1];
+            const realnum *fp[2] = {fc->f[seg.cS[i]][0], fc->f[seg.cS[i]][1]};
+            for (int k = 0; k < 2; ++k) {
+              double *out = k ? fim : fre;
+              const realnum *fk = fp[k];
+              if (fk)
+                for (ptrdiff_t i3 = 0, idx = r.idx0; i3 < n3; ++i3, idx += s3)
+                  out[i3] = 0.25 * (fk[idx] + fk[idx + o1] + fk[idx + o2] + fk[idx + o1 + o2]);
+              else
+                for (ptrdiff_t i3 = 0; i3 < n3; ++i3)
+                  out[i3] = 0.0;
+            }
+            const double phr = real(seg.ph[i]), phi = imag(seg.ph[i]);
+            if (phr != 1.0 || phi != 0.0)
+              for (ptrdiff_t i3 = 0; i3 < n3; ++i3) {
+                const double a = fre[i3], b = fim[i3];
+                fre[i3] = a * phr - b * phi;
+                fim[i3] = a * phi + b * phr;
+              }
+            if (seg.cloop[i] == 3)
+              for (ptrdiff_t i3 = 0; i3 < n3; ++i3) {
+                fre[i3] *= seg.inv3[i3];
+                fim[i3] *= seg.inv3[i3];
+              }
+            else if (seg.cloop[i]) {
+              const double inv = r.inv[seg.cloop[i] - 1];
+              for (ptrdiff_t i3 = 0; i3 < n3; ++i3) {
+                fre[i3] *= inv;
+                fim[i3] *= inv;
+              }
+            }
+          }
+
+          for (int it = 0; it < nt; ++it) {
+            const std::vector<product> &prods = g.prods[it];
+            if (prods.empty()) continue;
+            for (ptrdiff_t i3 = 0; i3 < n3; ++i3)
+              q[i3] = 0.0;
+            for (const product &p : prods) {
+              const double *ar = &re[p.a * max_n3], *ai = &im[p.a * max_n3];
+              const double *br = &re[p.b * max_n3], *bi = &im[p.b * max_n3];
+              for (ptrdiff_t i3 = 0; i3 < n3; ++i3)
+                q[i3] += p.coef * (ar[i3] * br[i3] + ai[i3] * bi[i3]);
+            }
+            if (terms[it].is_max) {
+              double m = bmax[ib * nt + it];
+              for (ptrdiff_t i3 = 0; i3 < n3; ++i3)
+                m = std::max(m, fabs(q[i3]));
+              bmax[ib * nt + it] = m;
+            }
+            else {
+              const double *w3 = seg.w3.data();
+              double s = 0.0;
+              for (ptrdiff_t i3 = 0; i3 < n3; ++i3)
+                s += q[i3] * w3[i3];
+              bsum[ib * nt + it] += s * r.w;
+            }
+          }
+        }
+      }
+    }
+
+    for (size_t ib = 0; ib < nblocks; ++ib)
+      for (int it = 0; it < nt; ++it) {
+        sums[it] += bsum[ib * nt + it];
+        maxs[it] = std::max(maxs[it], bmax[ib * nt + it]);
+      }
+  }
+
+  if (sync) f->restore_magnetic_fields();
+
+  bool have_sums = false, have_maxs = false;
+  for (int it = 0; it < nt; ++it) {
+    if (terms[it].is_max)
+      have_maxs = true;
+    else
+      have_sums = true;
+  }
+  std::vector<double> allsums(nt, 0.0), allmaxs(nt, 0.0), result(nt);
+  if (have_sums) sum_to_all(sums.data(), allsums.data(), nt);
+  if (have_maxs) max_to_all(maxs.data(), allmaxs.data(), nt);
+  for (int it = 0; it < nt; ++it)
+    result[it] = terms[it].is_max ? sqrt(allmaxs[it]) : allsums[it];
+  return result;
+}
+
 } // namespace meep
@@ -43,6 +43,7 @@ struct integrate_data {
   int ninvmu;
   component invmu_cs[3];
   direction invmu_ds[3];
+  bool empty_dim[5]; // directions in which the integral has zero width
   complex<double> sum;
   double maxabs;
   field_function integrand;
@@ -95,9 +96,12 @@ static void integrate_chunkloop(fields_chunk *fc, int ichunk, component cgrid, i
   for (int k = 0; k < data->ninvmu; ++k)
     fc->gv.yee2cent_offsets(imcs[k], imos[2 * k], imos[2 * k + 1]);
 
+  const bool stretched = fc->s->has_grid_stretch(), stretched2 = fc2->s->has_grid_stretch();
+
   vec rshift(shift * (0.5 * fc->gv.inva));
   LOOP_OVER_IVECS(fc->gv, is, ie, idx) {
     IVEC_LOOP_LOC(fc->gv, loc);
+    IVEC_LOOP_ILOC(fc->gv, here);
     loc = S.transform(loc, sn) + rshift;
 
     for (int i = 0; i < data->num_fvals; ++i) {
@@ -134,7 +138,9 @@ static void integrate_chunkloop(fields_chunk *fc, int ichunk, component cgrid, i
                            fc->f[cS[i]][k][idx + off[2 * i] + off[2 * i + 1]]);
           else
             f[k] = 0;
-        fvals[i] = complex<double>(f[0], f[1]) * ph[i];
+        // physical fields on a graded grid
+        fvals[i] = complex<double>(f[0], f[1]) * ph[i] /
+                   (stretched ? fc->s->field_stretch(cS[i], here) : 1.0);
       }
     }
 
@@ -173,13 +179,17 @@ static void integrate_chunkloop(fields_chunk *fc, int ichunk, component cgrid, i
                            fc2->f[cS[i]][k][idx + off[2 * i] + off[2 * i + 1]]);
           else
             f[k] = 0;
-        fvals[i] = complex<double>(f[0], f[1]) * ph[i];
+        // physical fields on a graded grid
+        fvals[i] = complex<double>(f[0], f[1]) * ph[i] /
+                   (stretched2 ? fc2->s->field_stretch(cS[i], here) : 1.0);
       }
     }
 
     complex<double> integrand = data->integrand(fvals, loc, data->integrand_data_);
     maxabs = std::max(maxabs, abs(integrand));
-    sum += integrand * IVEC_LOOP_WEIGHT(s0, s1, e0, e1, dV0 + dV1 * loop_i2);
+    double w = IVEC_LOOP_WEIGHT(s0, s1, e0, e1, dV0 + dV1 * loop_i2);
+    if (stretched) w *= fc->s->stretch_weight(here, data->empty_dim); // physical pixel size
+    sum += integrand * w;
   }
 
   data->maxabs = std::max(data->maxabs, maxabs);
@@ -272,6 +282,10 @@ complex<double> fields::integrate2(const fields &fields2, int num_fvals1,
       ++data.ninvmu;
     }
 
+  data.empty_dim[0] = data.empty_dim[1] = data.empty_dim[2] = data.empty_dim[3] =
+      data.empty_dim[4] = false;
+  LOOP_OVER_DIRECTIONS(where.dim, d) { data.empty_dim[d] = where.in_direction(d) == 0; }
+
   data.offsets = new ptrdiff_t[2 * (num_fvals1 + num_fvals2)];
   for (int i = 0; i < 2 * (num_fvals1 + num_fvals2); ++i)
     data.offsets[i] = 0;
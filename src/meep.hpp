@@ -167,6 +167,11 @@ public:
     (void)data;
     return 0;
   }
+  // bytes allocated for the internal data, for memory accounting
+  virtual size_t internal_data_size(const void *data) const {
+    (void)data;
+    return 0;
+  }
 
   /* The following methods are used in boundaries.cpp to set up any
      extra communications that may be necessary at chunk boundaries
@@ -264,6 +269,7 @@ public:
   virtual void init_internal_data(realnum *W[NUM_FIELD_COMPONENTS][2], realnum dt,
                                   const grid_volume &gv, void *data) const;
   virtual void *copy_internal_data(void *data) const;
+  virtual size_t internal_data_size(const void *data) const;
 
   virtual int num_cinternal_notowned_needed(component c, void *P_internal_data) const;
   virtual realnum *cinternal_notowned_ptr(int inotowned, component c, int cmp, int n,
@@ -311,6 +317,7 @@ public:
   virtual void init_internal_data(realnum *W[NUM_FIELD_COMPONENTS][2], realnum dt,
                                   const grid_volume &gv, void *data) const;
   virtual void *copy_internal_data(void *data) const;
+  virtual size_t internal_data_size(const void *data) const;
 
   virtual bool needs_P(component c, int cmp, realnum *W[NUM_FIELD_COMPONENTS][2]) const;
   virtual void update_P(realnum *W[NUM_FIELD_COMPONENTS][2],
@@ -360,6 +367,7 @@ public:
   virtual void init_internal_data(realnum *W[NUM_FIELD_COMPONENTS][2], realnum dt,
                                   const grid_volume &gv, void *data) const;
   virtual void *copy_internal_data(void *data) const;
+  virtual size_t internal_data_size(const void *data) const;
   virtual void delete_internal_data(void *data) const;
 
   virtual int num_cinternal_notowned_needed(component c, void *P_internal_data) const;
@@ -466,6 +474,8 @@ public:
 };
 
 typedef double (*pml_profile_func)(double u, void *func_data);
+// local grid spacing, in units of 1/a, at grid coordinate x (for graded grids)
+typedef double (*grid_stretch_func)(double x, void *func_data);
 
 #define DEFAULT_SUBPIXEL_TOL 1e-4
 #define DEFAULT_SUBPIXEL_MAXEVAL 100000
@@ -585,10 +595,29 @@ public:
 
 class structure;
 
+// memory.cpp: categories of memory reported by structure/fields::memory_usage
+enum memory_kind {
+  Fields_memory,
+  PML_memory,
+  Backup_memory,
+  Dispersion_memory,
+  DFT_memory,
+  Connection_memory,
+  Arena_memory, // reserved for field arrays but not in use (free blocks and padding)
+  Structure_memory
+};
+const int NUM_MEMORY_KINDS = Structure_memory + 1;
+const char *memory_kind_name(memory_kind k);
+// print the per-category totals of a num_chunks x NUM_MEMORY_KINDS byte array
+void print_memory_usage(const std::vector<size_t> &bytes, const char *title);
+
 class structure_chunk {
 public:
   double a, Courant, dt; // resolution a, Courant number, and timestep dt=Courant/a
   realnum *chi3[NUM_FIELD_COMPONENTS], *chi2[NUM_FIELD_COMPONENTS];
+  // bounding box of the c voxels where chi2 or chi3 is nonzero (empty if lo > hi),
+  // outside of which update_eh uses the linear update
+  ivec nonlinear_lo[NUM_FIELD_COMPONENTS], nonlinear_hi[NUM_FIELD_COMPONENTS];
   realnum *chi1inv[NUM_FIELD_COMPONENTS][5];
   bool trivial_chi1inv[NUM_FIELD_COMPONENTS][5];
   realnum *conductivity[NUM_FIELD_COMPONENTS][5];
@@ -596,6 +625,7 @@ public:
   bool condinv_stale;                        // true if condinv needs to be recomputed
   realnum *sig[6], *kap[6], *siginv[6];      // conductivity array for uPML
   int sigsize[6];                            // conductivity array size
+  realnum *stretch[6]; // graded-grid spacing factor, same layout as sig (NULL if uniform)
   grid_volume gv; // integer grid_volume that could be bigger than non-overlapping v below
   volume v;
   susceptibility *chiP[NUM_FIELD_TYPES]; // only E_stuff and H_stuff are used
@@ -616,9 +646,31 @@ public:
   void update_condinv();
   void set_chi3(component c, material_function &eps);
   void set_chi2(component c, material_function &eps);
+  void update_nonlinear_box(component c);
   void use_pml(direction, double dx, double boundary_loc, double Rasymptotic, double mean_stretch,
                pml_profile_func pml_profile, void *pml_profile_data, double pml_profile_integral,
                double pml_profile_integral_u);
+  void use_grid_stretch(direction d, grid_stretch_func stretch_func, void *stretch_data);
+  double stretch_at(direction d, int i) const {
+    return stretch[d] ? stretch[d][i - gv.little_corner().in_direction(d)] : 1.0;
+  }
+  // physical size of the pixel at here relative to the grid, along the directions d for which
+  // empty_dim[d] is false (the non-empty directions of an integral or DFT volume)
+  double stretch_weight(const ivec &here, const bool *empty_dim) const {
+    double w = 1.0;
+    LOOP_OVER_DIRECTIONS(gv.dim, d) {
+      if (stretch[d] && !empty_dim[d]) w *= stretch_at(d, here.in_direction(d));
+    }
+    return w;
+  }
+  // E and H components along a graded direction are stored as the stretch times the physical
+  // field; D and B components are stored as the physical fields
+  double field_stretch(component c, const ivec &here) const {
+    if (!is_electric(c) && !is_magnetic(c)) return 1.0;
+    const direction d = component_direction(c);
+    return stretch_at(d, here.in_direction(d));
+  }
+  bool has_grid_stretch() const;
 
   bool has_nonlinearities() const;
 
@@ -641,6 +693,10 @@ public:
   }
   double max_eps() const;
 
+  // memory.cpp: add this chunk's bytes to bytes[NUM_MEMORY_KINDS]
+  void memory_usage(size_t bytes[NUM_MEMORY_KINDS]) const;
+  void estimate_fields_memory(bool is_real, size_t bytes[NUM_MEMORY_KINDS]) const;
+
 private:
   double pml_fmin;
   int the_proc;
@@ -859,6 +915,18 @@ public:
   void add_susceptibility(material_function &sigma, field_type c, const susceptibility &sus);
   void remove_susceptibilities();
 
+  /* Graded grid along d: the pixel at grid coordinate x has physical size
+     stretch_func(x, stretch_data) / a, which must be >= 1 (a is the finest
+     resolution).  This is a real coordinate stretch, implemented with the
+     same kappa arrays as the PML; materials, sources, volumes and output
+     coordinates are still in grid coordinates, so it is meant for
+     coarsening homogeneous regions.  The E and H components along d are
+     stored as stretch times the physical fields; integrals, DFTs, array
+     slices, HDF5 output and get_field return the physical fields, and
+     integrals, DFTs and get_array_metadata use the physical pixel sizes. */
+  void use_grid_stretch(direction d, grid_stretch_func stretch_func, void *stretch_data = NULL);
+  bool has_grid_stretch(direction d) const;
+
   void set_output_directory(const char *name);
   void mix_with(const structure *, double);
 
@@ -898,6 +966,11 @@ public:
   std::complex<double> get_mu(const vec &loc, double frequency = 0) const;
   double max_eps() const;
   double estimated_cost(int process = my_rank());
+
+  // memory.cpp: bytes used by each chunk in each memory_kind (collective)
+  std::vector<size_t> memory_usage();
+  // ... plus an estimate of the fields that will be allocated for it
+  std::vector<size_t> estimated_memory_usage(bool is_real = false);
   // Returns the binary partition that was used to partition the volume into chunks. The returned
   // pointer is only valid for the lifetime of this `structure` instance.
   const binary_partition *get_binary_partition() const;
@@ -1121,6 +1194,73 @@ public:
                double fmin, double fmax, int maxbands);
 };
 
+// modes found by harmonic inversion of one time series (bands.cpp), in increasing
+// order of frequency: amplitude, Re and Im of the frequency, and error estimate
+struct harminv_result {
+  std::vector<std::complex<double> > amps;
+  std::vector<double> freq_re, freq_im, errors;
+  size_t num_modes() const { return amps.size(); }
+};
+
+/* A set of probe points sampled together every timestep.  This is a
+   faster alternative to repeated get_field / get_new_point calls: the
+   symmetry, chunk ownership, and interpolation weights of every (point,
+   component) pair are found once at construction, after which update()
+   does a local gather followed by a single sum_to_all over all probes.
+   The samples are stored in a fixed-capacity ring buffer per (point,
+   component), with the oldest samples overwritten once it is full.
+
+   The cached stencils are only valid for the fields object (and chunk
+   layout, symmetry and Bloch wavevector) that they were created with. */
+class probe_set {
+public:
+  probe_set(const fields &f, const std::vector<vec> &pts, const std::vector<component> &cs,
+            size_t capacity = 1024);
+
+  void update(const fields &f); // to be called after each timestep (collective)
+  void clear() { head = count = 0; }
+
+  size_t num_points() const { return npts; }
+  size_t num_components() const { return cs.size(); }
+  size_t num_samples() const { return count; }
+  size_t get_capacity() const { return capacity; }
+  component get_component(int ic) const { return cs[ic]; }
+
+  // the n-th stored sample (n = 0 is the oldest) of point ipt, component index ic
+  double time(size_t n) const { return times[ring_index(n)]; }
+  std::complex<double> get(size_t ipt, int ic, size_t n) const {
+    return samples[series_offset(ipt, ic) + ring_index(n)];
+  }
+  // copy the num_samples() values of one series, in time order, into out
+  void get_series(size_t ipt, int ic, std::complex<double> *out) const;
+  std::vector<std::complex<double> > get_series(size_t ipt, int ic) const;
+  // average time between consecutive stored samples
+  double sample_dt() const;
+  // harmonic inversion of every stored series, indexed by ipt * num_components() + ic,
+  // with the work spread over processes and threads (collective)
+  std::vector<harminv_result> harminv(double fmin, double fmax, int maxbands) const;
+
+private:
+  struct stencil_point {
+    int chunk_idx;
+    component c;
+    size_t idx;
+    std::complex<double> w; // interpolation weight * symmetry and Bloch phases
+    size_t series;          // ipt * num_components() + ic
+  };
+
+  size_t ring_index(size_t n) const { return (head + capacity - count + n) % capacity; }
+  size_t series_offset(size_t ipt, int ic) const { return (ipt * cs.size() + ic) * capacity; }
+
+  size_t npts;
+  std::vector<component> cs;
+  std::vector<stencil_point> stencil; // only entries in chunks owned by this process
+  std::vector<std::complex<double> > samples; // (npts * cs.size()) ring buffers of capacity
+  std::vector<double> times;
+  std::vector<std::complex<double> > local, global; // per-series scratch for update()
+  size_t capacity, head, count;
+};
+
 // dft.cpp
 // this should normally only be created with fields::add_dft
 class dft_chunk {
@@ -1160,6 +1300,8 @@ public:
 
   size_t N;                   // number of spatial points (on epsilon grid)
   std::complex<realnum> *dft; // N x Nomega array of DFT values.
+  // running rounding error of dft (Kahan summation), or NULL if not compensated
+  std::complex<realnum> *dft_comp;
 
   class dft_chunk *next_in_chunk; // per-fields_chunk list of DFT chunks
   class dft_chunk *next_in_dft;   // next for this particular DFT vol./component
@@ -1183,7 +1325,10 @@ public:
   /*      flag to indicate that it is present in the stored field          */
   /*      components. This is the include_dV_and_interp_weights flag.      */
   /*      (The sqrt_dV_and_interp_weights flag indicates that the sqrt of  */
-  /*      the volume factor is stored instead.)                            */
+  /*      the volume factor is stored instead.) On a graded grid           */
+  /*      (structure::use_grid_stretch) the volume factors are the         */
+  /*      physical pixel sizes, and the transformed fields are always the  */
+  /*      physical fields.                                                 */
   /*                                                                       */
   /*  (c) When computing things like -0.5*|E|^2 for the stress tensor, we  */
   /*      we cannot incorporate the minus sign into the scale factor       */
@@ -1430,6 +1575,21 @@ private:
   std::complex<double> *Jdft; // Nomega array of J(t) DFT values
   double Jsum;                // sum of |J| over all points
   double saved_overall_scale; // saved overall scale for adjoint calculation
+
+  // flattened copy of the source points, rebuilt only when the sources change
+  struct source_segment {
+    int ichunk;
+    component c;       // Ex/Hx-type component sampled at these points
+    bool magnetic;     // whether the points contribute to HJ rather than EJ
+    size_t start, end; // range in src_index/src_re/src_im
+    double abs_sum;    // sum of |A| over the points, for Jsum
+  };
+  std::vector<source_segment> segments;
+  std::vector<ptrdiff_t> src_index;
+  std::vector<double> src_re, src_im; // conj(A) split into real/imaginary parts
+  const fields *src_fields;           // fields and chunk sources_version tags
+  std::vector<size_t> src_versions;   //   that the cache was built from
+  bool cache_sources(fields &f);
 };
 
 // dft.cpp (normally created with fields::add_dft_fields)
@@ -1456,6 +1616,46 @@ typedef struct polarization_state_s {
   struct polarization_state_s *next; // linked list
 } polarization_state;
 
+// boundaries.cpp: a box [is, ie] of metal-boundary points of one field array,
+// zeroed by fields_chunk::zero_metal after every update of that field type
+struct metal_box {
+  component c;
+  int cmp;
+  ivec is, ie;
+};
+
+// arena.cpp: pool of zero-initialized, cache-line-aligned arrays of n realnums,
+// used for the fields and auxiliary arrays of one fields_chunk
+class chunk_arena {
+public:
+  chunk_arena(size_t n);
+  ~chunk_arena();
+  chunk_arena(const chunk_arena &) = delete;
+  chunk_arena &operator=(const chunk_arena &) = delete;
+
+  realnum *alloc();           // a zeroed array of n realnums
+  void release(realnum *p);   // return p (which may be NULL) to the pool
+  size_t bytes_reserved() const { return num_blocks * stride * sizeof(realnum); }
+  size_t bytes_resident() const; // bytes_reserved() minus the pages of free blocks
+  size_t blocks_in_use() const;
+  size_t num_slabs() const { return slabs.size(); }
+
+private:
+  struct slab {
+    void *base;
+    size_t bytes;
+    realnum *start; // first (aligned) block
+    size_t nblocks;
+    std::vector<realnum *> free_blocks;
+    size_t unbacked; // bytes in the whole pages of the free blocks
+  };
+  void add_slab();
+
+  size_t n, stride; // realnums per array, and between consecutive arrays
+  size_t num_blocks;
+  std::vector<slab> slabs; // in order of creation
+};
+
 class fields_chunk {
 public:
   realnum *f[NUM_FIELD_COMPONENTS][2]; // fields at current time
@@ -1476,6 +1676,11 @@ public:
   realnum *f_cond_backup[NUM_FIELD_COMPONENTS][2];
 
   realnum *f_bfast_backup[NUM_FIELD_COMPONENTS][2];
+
+  /* B and H from the previous timestep, kept only in chunks overlapping a
+     volume passed to fields::add_sync_volume, for cheap synchronization */
+  realnum *f_prev[NUM_FIELD_COMPONENTS][2];
+  bool keep_prev;
   // W (or E/H) field from prev. timestep, only stored if needed by update_pols
   realnum *f_w_prev[NUM_FIELD_COMPONENTS][2];
 
@@ -1486,8 +1691,10 @@ public:
 
   dft_chunk *dft_chunks;
 
-  realnum **zeroes[NUM_FIELD_TYPES]; // Holds pointers to metal points.
-  size_t num_zeroes[NUM_FIELD_TYPES];
+  std::vector<metal_box> zeroes[NUM_FIELD_TYPES]; // metal-boundary planes, see find_metals
+  // whether chi1inv == 0 for all components of a field type (E or H is then
+  // identically zero, e.g. a chunk entirely inside a perfect metal)
+  bool all_metal[NUM_FIELD_TYPES];
   std::unordered_map<comms_key, std::vector<realnum *>, comms_key_hash_fn> connections_in;
   std::unordered_map<comms_key, std::vector<realnum *>, comms_key_hash_fn> connections_out;
   std::unordered_map<comms_key, std::vector<std::complex<realnum> >, comms_key_hash_fn>
@@ -1498,6 +1705,7 @@ public:
 
   double a, Courant, dt; // resolution a, Courant number, and timestep dt=Courant/a
   grid_volume gv;
+  chunk_arena arena; // storage for the gv.ntot()-sized arrays above
   std::vector<grid_volume> gvs_tiled, gvs_eh[NUM_FIELD_TYPES]; // subdomains for tiled execution
   volume v;
   double m;                        // angular dependence in cyl. coords
@@ -1506,6 +1714,7 @@ public:
   double beta;
   int is_real;
   std::vector<src_vol> sources[NUM_FIELD_TYPES];
+  size_t sources_version; // unique tag, renewed by sources_changed()
   structure_chunk *new_s;
   structure_chunk *s;
   const char *outdir;
@@ -1534,14 +1743,21 @@ public:
 
   std::complex<double> get_chi1inv(component, direction, const ivec &iloc,
                                    double frequency = 0) const;
+  // memory.cpp: add this chunk's bytes to bytes[NUM_MEMORY_KINDS]
+  void memory_usage(size_t bytes[NUM_MEMORY_KINDS]) const;
   // Returns the vector of sources volumes for field type `ft`.
   const std::vector<src_vol> &get_sources(field_type ft) const { return sources[ft]; }
   // Adds a source volume of field type `ft` and takes ownership of `src`.
   void add_source(field_type ft, src_vol &&src);
+  // Must be called after modifying the sources, so that cached copies are invalidated.
+  void sources_changed();
 
-  void backup_component(component c);
+  void backup_component(component c, bool aux = true);
   void average_with_backup(component c);
-  void restore_component(component c);
+  void restore_component(component c, bool aux = true);
+  void save_prev_component(component c);
+  void extrapolate_from_prev(component c);
+  bool has_prev_magnetic_fields() const;
 
   void set_output_directory(const char *name);
 
@@ -1552,6 +1768,7 @@ public:
   int is_mine() const { return s->is_mine(); };
   // boundaries.cpp
   void zero_metal(field_type);
+  bool is_all_metal(field_type) const;
   bool needs_W_notowned(component c);
   // fields.cpp
   void remove_sources();
@@ -1728,6 +1945,15 @@ private:
 /***************************************************************/
 typedef vec (*kpoint_func)(double freq, int mode, void *user_data);
 
+// called by fields::solve_cw_sweep with the fields set to the solution at freqs[ifreq]
+typedef void (*cw_sweep_func)(fields &f, size_t ifreq, void *user_data);
+
+// one (dforce, dsource, mode) term of fields::casimir_stress_dct_integrals
+struct casimir_stress_term {
+  direction dforce, dsource;
+  double mx, my, mz;
+};
+
 class fields {
 public:
   int num_chunks;
@@ -1767,11 +1993,15 @@ public:
   void log(const char *prefix = "");
   void change_m(double new_m);
   bool has_nonlinearities(bool parallel = true) const;
+  bool has_grid_stretch(bool parallel = true) const;
 
   // time.cpp
   std::vector<double> time_spent_on(time_sink sink);
   double mean_time_spent_on(time_sink);
   void print_times();
+  // memory.cpp
+  std::vector<size_t> memory_usage(); // num_chunks x NUM_MEMORY_KINDS bytes (collective)
+  void print_memory_usage();
   // boundaries.cpp
   void set_boundary(boundary_side, direction, boundary_condition);
   void use_bloch(direction d, double k) { use_bloch(d, (std::complex<double>)k); }
@@ -1788,7 +2018,10 @@ public:
   // is 'true' (the default) - then all processes write to the same/single file
   // file after computing their respective offsets into this file. When set to
   // 'false', each process writes data for the chunks it owns to a separate
-  // (process unique) file.
+  // (process unique) file.  A single file also records the chunk layout, so
+  // that it can be loaded into fields with a different chunk layout or number
+  // of processes (e.g. a structure made with a new binary_partition), as long
+  // as there are no DFT chunks.
   void dump(const char *filename, bool single_parallel_file = true);
   void load(const char *filename, bool single_parallel_file = true);
 
@@ -1893,10 +2126,13 @@ public:
 
   // cw_fields.cpp:
   bool solve_cw(double tol, int maxiters, std::complex<double> frequency, int L = 2,
-                std::complex<double> *eigfreq = NULL, double eigtol = 1e-8, int eigiters = 20);
+                std::complex<double> *eigfreq = NULL, double eigtol = 1e-8, int eigiters = 20,
+                int precond_steps = 0);
   bool solve_cw(double tol = sizeof(realnum) == sizeof(float) ? 1e-5 : 1e-8, int maxiters = 10000,
                 int L = 2, std::complex<double> *eigfreq = NULL, double eigtol = 1e-8,
-                int eigiters = 20);
+                int eigiters = 20, int precond_steps = 0);
+  int solve_cw_sweep(double tol, int maxiters, const std::vector<std::complex<double> > &freqs,
+                     cw_sweep_func func, void *user_data, int L = 2, int nrecycle = 4);
 
   // sources.cpp:
   double last_source_time();
@@ -2006,6 +2242,10 @@ public:
                    stored_weight, chunk_next, sqrt_dV_and_interp_weights, extra_weight,
                    use_centered_grid, vc, decimation_factor, persist);
   }
+  /* Use compensated (Kahan) summation for the DFTs added after this call,
+     which makes single-precision (--enable-single) DFT accumulation about
+     as accurate as double precision, at the cost of a second array. */
+  void use_compensated_dft(bool b = true) { compensated_dft = b; }
   dft_chunk *add_dft(component c, const volume &where, const double *freq, size_t Nfreq,
                      bool include_dV_and_interp_weights = true,
                      std::complex<double> stored_weight = 1.0, dft_chunk *chunk_next = 0,
@@ -2206,8 +2446,10 @@ public:
                               size_t *array_dims = 0, direction *array_dirs = 0);
 
   // energy_and_flux.cpp
-  void synchronize_magnetic_fields();
+  void synchronize_magnetic_fields(const volume *where = NULL);
   void restore_magnetic_fields();
+  void add_sync_volume(const volume &where);
+  void clear_sync_volumes();
   double energy_in_box(const volume &);
   double electric_energy_in_box(const volume &);
   double magnetic_energy_in_box(const volume &);
@@ -2234,6 +2476,7 @@ public:
   double max_eps() const;
   // step.cpp
   void step_boundaries(field_type);
+  void step_eh_boundaries(field_type); // E/H boundaries outside of step()
   void process_incoming_chunk_data(field_type ft, const chunk_pair &comm_pair);
 
   bool nosize_direction(direction d) const;
@@ -2243,12 +2486,25 @@ public:
   std::complex<double> casimir_stress_dct_integral(direction dforce, direction dsource, double mx,
                                                    double my, double mz, field_type ft,
                                                    volume where, bool is_bloch = false);
+  // evaluates casimir_stress_dct_integral for many terms with a single pass over the
+  // surface for each field component and a single reduction
+  std::vector<std::complex<double> >
+  casimir_stress_dct_integrals(const std::vector<casimir_stress_term> &terms, field_type ft,
+                               volume where, bool is_bloch = false);
 
   void set_solve_cw_omega(std::complex<double> omega);
   void unset_solve_cw_omega();
 
+  friend class probe_set;
+
 private:
   int synchronized_magnetic_fields; // count number of nested synchs
+  bool sync_from_prev;               // add_sync_volume was called
+  bool synchronized_from_prev;       // current synch extrapolated from f_prev
+  int prev_t;                        // timestep at which f_prev was saved
+  bool compensated_dft;              // see use_compensated_dft
+  void save_prev_magnetic_fields();
+  bool can_synchronize_from_prev(const volume &where);
   double last_wall_time;
   std::vector<time_sink> was_working_on;
   time_sink_to_duration_map times_spent;
@@ -2257,6 +2513,8 @@ private:
   void figure_out_step_plan();
   // boundaries.cpp
   bool chunk_connections_valid;
+  // whether some E/H boundary values are only sent in the WE/WH exchange
+  bool shared_with_W[NUM_FIELD_TYPES];
   bool changed_materials; // keep track of whether materials have changed (in case field chunk
                           // connections need sync'ing)
   void find_metals();
@@ -2277,6 +2535,8 @@ private:
   void step_source(field_type ft, bool including_integrated = false);
   void update_pols(field_type ft);
   void calc_sources(double tim);
+  // cw_fields.cpp
+  void cw_source_fields();
   // sources.cpp
   void add_volume_source_check(component c, const src_time &src, const volume &where,
                                std::complex<double> A(const vec &), std::complex<double> amp,
@@ -2289,6 +2549,16 @@ private:
                                const std::string &field_name, FieldPtrGetter field_ptr_getter);
   void load_fields_chunk_field(h5file *h5f, bool single_parallel_file,
                                const std::string &field_name, FieldPtrGetter field_ptr_getter);
+  void dump_fields_chunk_layout(h5file *h5f);
+  bool load_fields_chunk_layout(h5file *h5f, std::vector<grid_volume> &gvs,
+                                std::vector<int> &procs);
+  // whether a chunk's own allocation rules need the array of component c (when remapping)
+  using FieldNeeded = std::function<bool(fields_chunk *, component)>;
+  void load_fields_chunk_field_repartitioned(h5file *h5f, const std::string &field_name,
+                                             FieldPtrGetter field_ptr_getter,
+                                             FieldNeeded field_needed, bool pml_aux,
+                                             const std::vector<grid_volume> &old_gvs,
+                                             const std::vector<int> &old_procs);
 
 public:
   // monitor.cpp
@@ -2310,9 +2580,9 @@ public:
 private:
   timing_scope with_timing_scope(time_sink sink);
 
-  // The following is an array that is num_chunks by num_chunks.  Actually
-  // it is two arrays, one for the imaginary and one for the real part.
-  realnum **comm_blocks[NUM_FIELD_TYPES];
+  // Buffers for the data sent from chunk j to chunk i, keyed by chunk_pair_to_index({j, i})
+  // and only allocated for the pairs that communicate (those in comm_sizes).
+  std::unordered_map<int, std::vector<realnum> > comm_blocks[NUM_FIELD_TYPES];
   // Map with all non-zero communication block sizes.
   std::unordered_map<comms_key, size_t, comms_key_hash_fn> comm_sizes;
   // The sequence of send and receive operations for each field type.
@@ -2367,6 +2637,92 @@ private:
   double cur_flux, cur_flux_half;
 };
 
+/* integrate.cpp: evaluate several built-in integrals (field energies,
+   Poynting flux) and maxima over the same volume in one pass over the
+   fields, with one reduction over processes per kind of term.  The
+   chunk/symmetry decomposition and the integration weights are computed
+   on the first evaluate() and cached for later calls, so a reduction_plan
+   is meant to be created once and evaluated many times.
+
+   Each product of two fields is evaluated on the Yee grid of its fields,
+   or averaged to the Centered grid if they lie on different grids, which
+   is what the single-quantity functions do, so the results agree with
+   them.  The sums are accumulated over fixed blocks of grid lines that
+   are added up in order, so they do not depend on the number of threads.
+   On a graded grid (structure::use_grid_stretch) the weights are the
+   physical pixel sizes, as in fields::integrate. */
+class reduction_plan {
+public:
+  reduction_plan(fields &f, const volume &where);
+
+  // each add_* function returns the index of its result in evaluate()
+  int add_field_energy(component c); // like fields::field_energy_in_box(c, where)
+  int add_electric_energy();         // like fields::electric_energy_in_box
+  int add_magnetic_energy();         // like fields::magnetic_energy_in_box
+  int add_field_energy();            // electric + magnetic energy
+  int add_flux(direction d);         // like fields::flux_in_box_wrongH
+  int add_max_abs(component c);      // like fields::max_abs(c, where)
+  int num_terms() const { return int(terms.size()); }
+
+  /* If synchronize_magnetic is true and any term involves H or B, the
+     magnetic fields are synchronized with the electric fields first, as
+     in fields::flux_in_box and fields::field_energy_in_box. */
+  std::vector<double> evaluate(bool synchronize_magnetic = true);
+
+private:
+  struct product {
+    int a, b;    // indices into cs
+    double coef; // term += coef * Re[conj(f_a) * f_b]
+  };
+  struct term {
+    bool is_max; // max |sum of products|^(1/2) instead of integral of the sum of products
+    std::vector<product> prods;
+  };
+  struct segment { // one chunk / symmetry image / periodic shift of where
+    int chunk_idx;
+    ptrdiff_t n3, s3;                    // innermost loop length and stride
+    std::vector<double> w3;              // innermost-loop integration weights
+    std::vector<component> cS;           // components after the symmetry transformation
+    std::vector<ptrdiff_t> off;          // offsets to average cS onto the common grid
+    std::vector<std::complex<double> > ph; // symmetry/Bloch phases
+    // on a graded grid, the loop (1-3, or 0 for none) along whose direction each E or H
+    // component is stretched, and the inverse stretch along the innermost loop
+    bool stretched;
+    std::vector<int> cloop;
+    std::vector<double> inv3;
+  };
+  struct row { // one innermost line of grid points
+    int seg;
+    ptrdiff_t idx0;
+    double w;      // integration weight from the two outer loops
+    double inv[2]; // inverse stretch along the two outer loop directions, on a graded grid
+  };
+  struct grid { // the products evaluated on one Yee grid (or on the Centered grid)
+    component cgrid;
+    std::vector<int> fields;                  // indices into cs of the fields it needs
+    std::vector<std::vector<product> > prods; // the products of each term on this grid
+    std::vector<segment> segments;
+    std::vector<row> rows;
+    ptrdiff_t max_n3;
+  };
+
+  int component_index(component c);
+  int add_term(bool is_max, const std::vector<product> &prods);
+  void prepare();
+  static void record_chunkloop(fields_chunk *fc, int ichunk, component cgrid, ivec is, ivec ie,
+                               vec s0, vec s1, vec e0, vec e1, double dV0, double dV1, ivec shift,
+                               std::complex<double> shift_phase, const symmetry &S, int sn,
+                               void *data_);
+
+  fields *f;
+  volume where;
+  std::vector<component> cs;
+  std::vector<term> terms;
+  bool has_magnetic, prepared;
+  std::vector<grid> grids;
+  grid *recording; // the grid record_chunkloop is filling in
+};
+
 // The following is a utility function to parse the executable name use it
 // to come up with a directory name, avoiding overwriting any existing
 // directory, unless the source file hasn't changed.
@@ -2382,6 +2738,15 @@ int do_harminv(std::complex<double> *data, int n, double dt, double fmin, double
                double spectral_density = 1.1, double Q_thresh = 50, double rel_err_thresh = 1e20,
                double err_thresh = 0.01, double rel_amp_thresh = -1, double amp_thresh = -1);
 
+// Runs do_harminv on nseries time series of n samples each, where series s starts at
+// data[s * stride] (stride = 0 means stride = n).  The series are divided among the
+// processes and threads, and every process receives all of the results.  Collective.
+std::vector<harminv_result>
+do_harminv_batch(const std::complex<double> *data, size_t nseries, int n, size_t stride,
+                 double dt, double fmin, double fmax, int maxbands, double spectral_density = 1.1,
+                 double Q_thresh = 50, double rel_err_thresh = 1e20, double err_thresh = 0.01,
+                 double rel_amp_thresh = -1, double amp_thresh = -1);
+
 std::complex<double> *
 make_casimir_gfunc(double T, double dt, double sigma, field_type ft,
                    std::complex<double> (*eps_func)(std::complex<double> omega) = 0,
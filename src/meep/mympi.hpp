@@ -71,6 +71,7 @@ int broadcast(int from, int data);
 bool broadcast(int from, bool);
 double max_to_master(double); // Only returns the correct value to proc 0.
 double max_to_all(double);
+void max_to_all(const double *in, double *out, int size);
 int max_to_all(int);
 int min_to_all(int);
 float sum_to_master(float);   // Only returns the correct value to proc 0.
@@ -1004,6 +1004,7 @@ private:
 };
 
 class grid_volume;
+class split_cost_grid;
 grid_volume volcyl(double rsize, double zsize, double a);
 grid_volume volone(double zsize, double a);
 grid_volume vol1d(double zsize, double a);
@@ -1120,6 +1121,7 @@ public:
 
   grid_volume split_at_fraction(bool side_high, int split_pt, int split_dir) const;
   double get_cost() const;
+  double get_memory_cost() const;
   grid_volume halve(direction d) const;
   void pad_self(direction d);
   grid_volume pad(direction d) const;
@@ -1156,10 +1158,13 @@ public:
 
   const char *str(char *buffer = 0, size_t buflen = 0);
 
-  std::complex<double> get_split_costs(direction d, int split_point, bool frag_cost) const;
+  std::complex<double> get_split_costs(direction d, int split_point, bool frag_cost,
+                                       bool memory = false,
+                                       const split_cost_grid *costs = NULL) const;
   void tile_split(int &best_split_point, direction &best_split_direction) const;
   void find_best_split(int desired_chunks, bool frag_cost, int &best_split_point,
-                       direction &best_split_direction, double &left_effort_fraction) const;
+                       direction &best_split_direction, double &left_effort_fraction,
+                       const split_cost_grid *costs = NULL) const;
 
 private:
   grid_volume(ndim d, double ta, int na, int nb, int nc);
@@ -1176,6 +1181,25 @@ private:
   size_t the_ntot;
 };
 
+// The fragment_stats cost and memory of a grid_volume, computed once on a
+// coarse grid of cells and stored as prefix sums, so that the cost of any
+// sub-grid_volume (taking the cost to be uniform within each cell) is found
+// in O(1) time.  This is what split_by_cost uses to compare candidate splits.
+class split_cost_grid {
+public:
+  split_cost_grid(const grid_volume &gv, size_t max_cells);
+  double cost(const grid_volume &sub, bool memory = false) const;
+
+private:
+  double cumulative(int m, const double *pos) const;
+
+  ivec io;                       // little corner of the whole grid_volume
+  int n[3];                      // pixels along each direction (indexed by direction % 3)
+  int step[3];                   // pixels per cell
+  int ncells[3];                 // cells along each direction
+  std::vector<double> prefix[2]; // (ncells+1)^3 prefix sums of cost and memory
+};
+
 class volume_list;
 
 class symmetry;
@@ -44,6 +44,16 @@ inline int rmin_bulk(int m) {
   return r;
 }
 
+/* sum += x with Kahan summation, as in the compensated DFTs: sum - comp is
+   the exact running sum to about twice the working precision */
+template <typename T>
+inline void kahan_add(std::complex<T> &sum, std::complex<T> &comp, std::complex<T> x) {
+  const std::complex<T> y = x - comp;
+  const std::complex<T> t = sum + y;
+  comp = (t - sum) - y;
+  sum = t;
+}
+
 // A source volume
 // Moveable and copyable
 class src_vol {
@@ -189,6 +199,9 @@ void step_bfast_stride1(realnum *f, component c, const realnum *g1, const realnu
                  kapu, siginvu, dt, cnd, cndinv, fcnd, F, k1, k2);                                 \
   } while (0)
 
+// in energy_and_flux.cpp: S_d = Re[conj(cE[0]) cH[0]] - Re[conj(cE[1]) cH[1]]
+void flux_components(ndim dim, direction d, component cE[2], component cH[2]);
+
 // analytical Green's functions from near2far.cpp, which we might want to expose someday
 void green3d(std::complex<double> *EH, const vec &x, double freq, double eps, double mu,
              const vec &x0, component c0, std::complex<double> f0);
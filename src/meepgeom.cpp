@@ -2142,6 +2142,7 @@ std::vector<meep::volume> fragment_stats::absorber_vols;
 material_type_list fragment_stats::extra_materials = material_type_list();
 bool fragment_stats::split_chunks_evenly = false;
 bool fragment_stats::eps_averaging = false;
+double fragment_stats::memory_budget = 0;
 
 static geom_box make_box_from_cell(vector3 cell_size) {
   double edgex = cell_size.x / 2;
@@ -2448,6 +2449,20 @@ double fragment_stats::cost() const {
           num_3d_pml_pixels * 6.63939607e-04 + num_pixels_in_box * 3.46518274e-04);
 }
 
+double fragment_stats::memory() const {
+  // realnum arrays per field component and pixel: E, D and B (H == B outside PML and
+  // magnetic media) for complex fields, plus chi1inv for E and H.  PML adds a separate H and
+  // the f_u/f_w auxiliary fields, a susceptibility adds P, P_prev, D-P and its sigma, etc.
+  const double ncomp = dims == meep::D1 ? 1 : 3;
+  const double arrays =
+      8.0 * num_pixels_in_box +
+      10.0 * (num_1d_pml_pixels + num_2d_pml_pixels + num_3d_pml_pixels) +
+      7.0 * num_susceptibility_pixels + 4.0 * num_nonzero_conductivity_pixels +
+      2.0 * (num_nonlinear_pixels + num_anisotropic_eps_pixels + num_anisotropic_mu_pixels);
+  // num_dft_pixels already counts each frequency and component
+  return sizeof(meep::realnum) * (ncomp * arrays + 2.0 * num_dft_pixels);
+}
+
 void fragment_stats::print_stats() const {
   master_printf("Fragment stats\n");
   master_printf("  anisotropic_eps: %zu\n", num_anisotropic_eps_pixels);
@@ -2535,11 +2550,7 @@ void invert_tensor(std::complex<double> t_inv[9], std::complex<double> t[9]) {
 #undef minv
 }
 
-void get_chi1_tensor_disp(std::complex<double> tensor[9], const meep::vec &r, double freq,
-                          geom_epsilon *geps) {
-  // locate the proper material
-  material_type md;
-  geps->get_material_pt(md, r);
+static void chi1_tensor_disp(std::complex<double> tensor[9], material_type md, double freq) {
   const medium_struct *mm = &(md->medium);
 
   // loop over all the tensor components
@@ -2565,6 +2576,14 @@ void get_chi1_tensor_disp(std::complex<double> tensor[9], const meep::vec &r, do
   }
 }
 
+void get_chi1_tensor_disp(std::complex<double> tensor[9], const meep::vec &r, double freq,
+                          geom_epsilon *geps) {
+  // locate the proper material
+  material_type md;
+  geps->get_material_pt(md, r);
+  chi1_tensor_disp(tensor, md, freq);
+}
+
 void eff_chi1inv_row_disp(meep::component c, std::complex<double> chi1inv_row[3],
                           const meep::vec &r, double freq, geom_epsilon *geps) {
   std::complex<double> tensor[9], tensor_inv[9];
@@ -3018,7 +3037,7 @@ void get_epsilon_grid(geometric_object_list gobj_list, material_type_list mlist,
                       material_type _default_material, bool _ensure_periodicity,
                       meep::grid_volume gv, vector3 cell_size, vector3 cell_center, int nx,
                       const double *x, int ny, const double *y, int nz, const double *z,
-                      std::complex<double> *grid_vals, double frequency) {
+                      std::complex<double> *grid_vals, double frequency, bool parallel) {
   double min_val[3], max_val[3];
   for (int n = 0; n < 3; ++n) {
     int ndir = (n == 0) ? nx : ((n == 1) ? ny : nz);
@@ -3031,20 +3050,79 @@ void get_epsilon_grid(geometric_object_list gobj_list, material_type_list mlist,
   init_libctl(_default_material, _ensure_periodicity, &gv, cell_size, cell_center, &gobj_list);
   dim = gv.dim;
   geom_epsilon geps(gobj_list, mlist, vol);
-  for (int i = 0; i < nx; ++i)
-    for (int j = 0; j < ny; ++j)
-      for (int k = 0; k < nz; ++k) {
-        /* obtain the trace of the ε tensor (dispersive or non) for each
-           grid point in row-major order (the order used by NumPy) */
-        if (frequency == 0)
-          grid_vals[k + nz * (j + ny * i)] =
-              geps.chi1p1(meep::E_stuff, meep::vec(x[i], y[j], z[k]));
-        else {
-          std::complex<double> tensor[9];
-          get_chi1_tensor_disp(tensor, meep::vec(x[i], y[j], z[k]), frequency, &geps);
-          grid_vals[k + nz * (j + ny * i)] = (tensor[0] + tensor[4] + tensor[8]) / 3.0;
+
+  /* Media are looked up and read only, so they can be evaluated by several
+     threads, and the ε of a medium is the same at every point, so each thread
+     computes it once per medium and then reuses it, whatever the shape of the
+     grid.  User-defined, file and grid materials are evaluated at every point,
+     serially. */
+  bool uniform = !is_variable(_default_material) && !is_file(_default_material);
+  for (int n = 0; n < gobj_list.num_items; ++n)
+    uniform = uniform && !is_variable(gobj_list.items[n].material) &&
+              !is_file(gobj_list.items[n].material);
+
+  /* with parallel, each process computes a slab of x and the slabs are summed */
+  int i0 = 0, i1 = nx;
+  const size_t ntot = size_t(nx) * ny * nz;
+  if (parallel) {
+    i0 = int(nx * size_t(meep::my_rank()) / meep::count_processors());
+    i1 = int(nx * size_t(meep::my_rank() + 1) / meep::count_processors());
+    std::fill(grid_vals, grid_vals + ntot, std::complex<double>(0.0, 0.0));
+  }
+
+#ifdef HAVE_OPENMP
+#pragma omp parallel if (uniform)
+#endif
+  {
+    // ε of the media this thread has met so far (there are only a few)
+    std::vector<std::pair<material_type, std::complex<double> > > media;
+#ifdef HAVE_OPENMP
+#pragma omp for collapse(2) schedule(dynamic)
+#endif
+    for (int i = i0; i < i1; ++i)
+      for (int j = 0; j < ny; ++j)
+        for (int k = 0; k < nz; ++k) {
+          /* obtain the trace of the ε tensor (dispersive or non) for each
+             grid point in row-major order (the order used by NumPy) */
+          const meep::vec r(x[i], y[j], z[k]);
+          std::complex<double> &val = grid_vals[k + nz * (j + size_t(ny) * i)];
+          if (!uniform) {
+            if (frequency == 0)
+              val = geps.chi1p1(meep::E_stuff, r);
+            else {
+              std::complex<double> tensor[9];
+              get_chi1_tensor_disp(tensor, r, frequency, &geps);
+              val = (tensor[0] + tensor[4] + tensor[8]) / 3.0;
+            }
+            continue;
+          }
+          material_type material;
+          geps.get_material_pt(material, r);
+          size_t m = 0;
+          while (m < media.size() && media[m].first != material)
+            ++m;
+          if (m == media.size()) {
+            std::complex<double> eps;
+            if (frequency == 0) {
+              symm_matrix chi1p1, chi1p1_inv;
+              material_epsmu(meep::E_stuff, material, &chi1p1, &chi1p1_inv);
+              eps = (chi1p1.m00 + chi1p1.m11 + chi1p1.m22) / 3;
+            }
+            else {
+              std::complex<double> tensor[9];
+              chi1_tensor_disp(tensor, material, frequency);
+              eps = (tensor[0] + tensor[4] + tensor[8]) / 3.0;
+            }
+            media.push_back(std::make_pair(material, eps));
+          }
+          val = media[m].second;
         }
-      }
+  }
+
+  if (parallel) {
+    std::vector<std::complex<double> > slabs(grid_vals, grid_vals + ntot);
+    meep::sum_to_all(slabs.data(), grid_vals, ntot);
+  }
 }
 
 } // namespace meep_geom
@@ -70,6 +70,8 @@ struct fragment_stats {
   static material_type_list extra_materials;
   static bool split_chunks_evenly;
   static bool eps_averaging;
+  // if > 0, the bytes per chunk that split_by_cost tries not to exceed
+  static double memory_budget;
 
   static bool has_non_medium_material();
 
@@ -96,6 +98,7 @@ struct fragment_stats {
 
   void compute();
   double cost() const;
+  double memory() const; // estimated bytes of structure and fields in box
   void print_stats() const;
 
 private:
@@ -276,7 +279,8 @@ void get_epsilon_grid(geometric_object_list gobj_list, material_type_list mlist,
                       material_type _default_material, bool _ensure_periodicity,
                       meep::grid_volume gv, vector3 cell_size, vector3 cell_center, int nx,
                       const double *x, int ny, const double *y, int nz, const double *z,
-                      std::complex<double> *grid_vals, double frequency = 0);
+                      std::complex<double> *grid_vals, double frequency = 0,
+                      bool parallel = false);
 void init_libctl(material_type default_mat, bool ensure_per, meep::grid_volume *gv,
                  vector3 cell_size, vector3 cell_center, geometric_object_list *geom_list);
 
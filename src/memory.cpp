@@ -0,0 +1,220 @@
+/* Copyright (C) 2005-2024 Massachusetts Institute of Technology
+%
+%  This program is free software; you can redistribute it and/or modify
+%  it under the terms of the GNU General Public License as published by
+%  the Free Software Foundation; either version 2, or (at your option)
+%  any later version.
+%
+%  This program is distributed in the hope that it will be useful,
+%  but WITHOUT ANY WARRANTY; without even the implied warranty of
+%  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+%  GNU General Public License for more details.
+%
+%  You should have received a copy of the GNU General Public License
+%  along with this program; if not, write to the Free Software Foundation,
+%  Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* Accounting of the memory held by the structure and fields arrays.
+
+   All of the routines returning a std::vector<size_t> give a
+   num_chunks x NUM_MEMORY_KINDS array (row-major), with the bytes that
+   each chunk uses in each category, summed over all processes. */
+
+#include <string.h>
+
+#include "meep.hpp"
+#include "meep_internals.hpp"
+
+using namespace std;
+
+namespace meep {
+
+const char *memory_kind_name(memory_kind k) {
+  switch (k) {
+    case Fields_memory: return "fields";
+    case PML_memory: return "PML auxiliary fields";
+    case Backup_memory: return "field backups";
+    case Dispersion_memory: return "polarizations";
+    case DFT_memory: return "DFT";
+    case Connection_memory: return "chunk connections";
+    case Arena_memory: return "free field arrays";
+    case Structure_memory: return "structure";
+  }
+  return "unknown memory";
+}
+
+void structure_chunk::memory_usage(size_t bytes[NUM_MEMORY_KINDS]) const {
+  const size_t nb = gv.ntot() * sizeof(realnum);
+  FOR_COMPONENTS(c) {
+    if (chi3[c]) bytes[Structure_memory] += nb;
+    if (chi2[c]) bytes[Structure_memory] += nb;
+    FOR_DIRECTIONS(d) {
+      if (chi1inv[c][d]) bytes[Structure_memory] += nb;
+      if (conductivity[c][d]) bytes[Structure_memory] += nb;
+      if (condinv[c][d]) bytes[Structure_memory] += nb;
+    }
+  }
+  for (int d = 0; d < 6; ++d) {
+    if (sig[d]) bytes[Structure_memory] += 3 * sigsize[d] * sizeof(realnum); // sig, kap, siginv
+    if (stretch[d]) bytes[Structure_memory] += sigsize[d] * sizeof(realnum);
+  }
+  FOR_FIELD_TYPES(ft) {
+    for (const susceptibility *sus = chiP[ft]; sus; sus = sus->next)
+      FOR_COMPONENTS(c) FOR_DIRECTIONS(d) {
+        if (sus->sigma[c][d]) bytes[Structure_memory] += nb;
+      }
+  }
+}
+
+/* The bytes that fields_chunk will use once it is timestepping, estimated
+   from the structure alone (a "dry run" of the lazy allocations in
+   alloc_f, step_db and update_eh).  This is an upper bound in that it
+   assumes that every field component of this dimensionality gets
+   excited; DFT arrays, backups and chunk connections are not included. */
+void structure_chunk::estimate_fields_memory(bool is_real, size_t bytes[NUM_MEMORY_KINDS]) const {
+  const size_t nb = gv.ntot() * sizeof(realnum) * (is_real ? 1 : 2);
+  bool pml = false;
+  for (int d = 0; d < 6; ++d)
+    pml = pml || sigsize[d] > 1;
+
+  FOR_FIELD_TYPES(ft) {
+    if (ft != E_stuff && ft != H_stuff) continue;
+    FOR_FT_COMPONENTS(ft, ec) {
+      if (!gv.has_field(ec)) continue;
+      const component dc = field_type_component(ft == E_stuff ? D_stuff : B_stuff, ec);
+      const direction d_ec = component_direction(ec);
+      bool dispersive = false;
+      for (const susceptibility *sus = chiP[ft]; sus; sus = sus->next)
+        FOR_DIRECTIONS(d) {
+          if (sus->sigma[ec][d]) dispersive = true;
+        }
+
+      bytes[Fields_memory] += nb; // D or B
+      // E is always separate from D, but H == B unless mu != 1, PML, or dispersion
+      if (ft == E_stuff || chi1inv[ec][d_ec] || pml || dispersive) bytes[Fields_memory] += nb;
+      if (pml) bytes[PML_memory] += 2 * nb; // f_u for D/B and f_w for E/H
+      FOR_DIRECTIONS(d) {
+        if (conductivity[dc][d]) {
+          bytes[PML_memory] += nb; // f_cond
+          break;
+        }
+      }
+      if (dispersive) {
+        bytes[Dispersion_memory] += nb; // f_minus_p
+        for (const susceptibility *sus = chiP[ft]; sus; sus = sus->next)
+          FOR_DIRECTIONS(d) {
+            if (sus->sigma[ec][d]) {
+              bytes[Dispersion_memory] += 2 * nb; // P and P_prev
+              break;
+            }
+          }
+      }
+    }
+  }
+}
+
+void fields_chunk::memory_usage(size_t bytes[NUM_MEMORY_KINDS]) const {
+  const size_t nb = gv.ntot() * sizeof(realnum);
+  DOCMP2 FOR_COMPONENTS(c) {
+    // for mu=1 non-PML regions, H==B shares the same array
+    if (f[c][cmp] && !(is_magnetic(c) &&
+                       f[c][cmp] == f[direction_component(Bx, component_direction(c))][cmp]))
+      bytes[Fields_memory] += nb;
+    if (f_u[c][cmp]) bytes[PML_memory] += nb;
+    if (f_w[c][cmp]) bytes[PML_memory] += nb;
+    if (f_cond[c][cmp]) bytes[PML_memory] += nb;
+    if (f_bfast[c][cmp]) bytes[PML_memory] += nb;
+    if (f_backup[c][cmp]) bytes[Backup_memory] += nb;
+    if (f_u_backup[c][cmp]) bytes[Backup_memory] += nb;
+    if (f_w_backup[c][cmp]) bytes[Backup_memory] += nb;
+    if (f_cond_backup[c][cmp]) bytes[Backup_memory] += nb;
+    if (f_bfast_backup[c][cmp]) bytes[Backup_memory] += nb;
+    if (f_prev[c][cmp]) bytes[Backup_memory] += nb;
+    if (f_w_prev[c][cmp]) bytes[Dispersion_memory] += nb;
+    if (f_minus_p[c][cmp]) bytes[Dispersion_memory] += nb;
+  }
+  if (f_rderiv_int) bytes[PML_memory] += nb;
+  // the rest of the arena's resident slabs, so that the totals match what the process holds
+  bytes[Arena_memory] += arena.bytes_resident() - arena.blocks_in_use() * nb;
+
+  FOR_FIELD_TYPES(ft) {
+    for (polarization_state *p = pol[ft]; p; p = p->next)
+      if (p->data) bytes[Dispersion_memory] += p->s->internal_data_size(p->data);
+  }
+
+  for (dft_chunk *cur = dft_chunks; cur; cur = cur->next_in_chunk) {
+    const size_t nb_dft = cur->N * cur->omega.size() * sizeof(complex<realnum>);
+    bytes[DFT_memory] += cur->dft_comp ? 2 * nb_dft : nb_dft; // dft and its compensation
+  }
+
+  FOR_FIELD_TYPES(ft) { bytes[Connection_memory] += zeroes[ft].size() * sizeof(metal_box); }
+  for (const auto &conn : connections_in)
+    bytes[Connection_memory] += conn.second.size() * sizeof(realnum *);
+  for (const auto &conn : connections_out)
+    bytes[Connection_memory] += conn.second.size() * sizeof(realnum *);
+  for (const auto &phases : connection_phases)
+    bytes[Connection_memory] += phases.second.size() * sizeof(complex<realnum>);
+}
+
+std::vector<size_t> structure::memory_usage() {
+  std::vector<size_t> bytes(num_chunks * NUM_MEMORY_KINDS, 0), out(bytes.size());
+  for (int i = 0; i < num_chunks; ++i)
+    if (chunks[i]->is_mine()) chunks[i]->memory_usage(&bytes[i * NUM_MEMORY_KINDS]);
+  sum_to_all(bytes.data(), out.data(), int(bytes.size()));
+  return out;
+}
+
+std::vector<size_t> structure::estimated_memory_usage(bool is_real) {
+  std::vector<size_t> bytes(num_chunks * NUM_MEMORY_KINDS, 0), out(bytes.size());
+  for (int i = 0; i < num_chunks; ++i)
+    if (chunks[i]->is_mine()) {
+      chunks[i]->memory_usage(&bytes[i * NUM_MEMORY_KINDS]);
+      chunks[i]->estimate_fields_memory(is_real, &bytes[i * NUM_MEMORY_KINDS]);
+    }
+  sum_to_all(bytes.data(), out.data(), int(bytes.size()));
+  return out;
+}
+
+std::vector<size_t> fields::memory_usage() {
+  std::vector<size_t> bytes(num_chunks * NUM_MEMORY_KINDS, 0), out(bytes.size());
+  for (int i = 0; i < num_chunks; ++i)
+    if (chunks[i]->is_mine()) {
+      chunks[i]->s->memory_usage(&bytes[i * NUM_MEMORY_KINDS]);
+      chunks[i]->memory_usage(&bytes[i * NUM_MEMORY_KINDS]);
+    }
+  // communication buffers from chunk j to chunk i exist on both of their processes
+  for (const std::pair<const comms_key, size_t> &key_and_comm_size : comm_sizes) {
+    const int j = key_and_comm_size.first.pair.first, i = key_and_comm_size.first.pair.second;
+    if (chunks[i]->is_mine() || chunks[j]->is_mine())
+      bytes[i * NUM_MEMORY_KINDS + Connection_memory] += key_and_comm_size.second * sizeof(realnum);
+  }
+  sum_to_all(bytes.data(), out.data(), int(bytes.size()));
+  return out;
+}
+
+void print_memory_usage(const std::vector<size_t> &bytes, const char *title) {
+  const size_t nchunks = bytes.size() / NUM_MEMORY_KINDS;
+  size_t total[NUM_MEMORY_KINDS] = {0}, all = 0, chunk_max = 0;
+  for (size_t i = 0; i < nchunks; ++i) {
+    size_t chunk_total = 0;
+    for (int k = 0; k < NUM_MEMORY_KINDS; ++k) {
+      total[k] += bytes[i * NUM_MEMORY_KINDS + k];
+      chunk_total += bytes[i * NUM_MEMORY_KINDS + k];
+    }
+    all += chunk_total;
+    chunk_max = std::max(chunk_max, chunk_total);
+  }
+  master_printf("\n%s:\n", title);
+  for (int k = 0; k < NUM_MEMORY_KINDS; ++k)
+    if (total[k])
+      master_printf("    %21s: %g MB\n", memory_kind_name(memory_kind(k)), total[k] * 1e-6);
+  master_printf("    %21s: %g MB in %zu chunks (largest chunk %g MB)\n\n", "total", all * 1e-6,
+                nchunks, chunk_max * 1e-6);
+}
+
+void fields::print_memory_usage() {
+  meep::print_memory_usage(memory_usage(), "Field memory usage");
+}
+
+} // namespace meep
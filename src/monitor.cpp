@@ -157,8 +157,10 @@ complex<double> fields::get_field(component c, const ivec &origloc, bool paralle
 }
 
 complex<double> fields_chunk::get_field(component c, const ivec &iloc) const {
-  if (is_mine())
-    return f[c][0] ? (f[c][1] ? getcm(f[c], gv.index(c, iloc)) : f[c][0][gv.index(c, iloc)]) : 0.0;
+  if (is_mine() && f[c][0]) {
+    complex<double> val = f[c][1] ? getcm(f[c], gv.index(c, iloc)) : f[c][0][gv.index(c, iloc)];
+    return val / s->field_stretch(c, iloc); // physical field on a graded grid
+  }
   else
     return 0.0;
 }
@@ -403,6 +405,100 @@ monitor_point *fields::get_new_point(const vec &loc, monitor_point *the_list) co
   return p;
 }
 
+probe_set::probe_set(const fields &f, const std::vector<vec> &pts,
+                     const std::vector<component> &cs_, size_t capacity_)
+    : npts(pts.size()), cs(cs_), capacity(capacity_), head(0), count(0) {
+  if (capacity == 0) meep::abort("probe_set: capacity must be positive\n");
+  for (component c : cs)
+    if (c < 0 || c >= NUM_FIELD_COMPONENTS)
+      meep::abort("probe_set: unsupported component %d\n", int(c));
+  const size_t nseries = npts * cs.size();
+  samples.resize(nseries * capacity);
+  times.resize(capacity);
+  local.resize(nseries);
+  global.resize(nseries);
+
+  /* same point location as get_field(component, vec), but we record the
+     owning chunk, index and phase instead of reading the field value */
+  for (size_t ipt = 0; ipt < npts; ++ipt)
+    for (size_t ic = 0; ic < cs.size(); ++ic) {
+      component c = cs[ic];
+      if (!f.gv.has_field(c)) continue;
+      const vec &loc = pts[ipt];
+      ivec ilocs[8];
+      double w[8];
+      f.gv.interpolate(c, loc, ilocs, w);
+      complex<double> kzphase = 1.0;
+      if (f.gv.dim == D2 && loc.in_direction(Z) != 0) // special_kz handling
+        kzphase = std::polar(1.0, 2 * pi * f.beta * loc.in_direction(Z));
+      for (int argh = 0; argh < 8 && w[argh]; argh++) {
+        ivec iloc = ilocs[argh];
+        complex<double> kphase = 1.0;
+        f.locate_point_in_user_volume(&iloc, &kphase);
+        bool found = false;
+        for (int sn = 0; sn < f.S.multiplicity() && !found; sn++) {
+          const ivec here = f.S.transform(iloc, sn);
+          for (int i = 0; i < f.num_chunks && !found; i++)
+            if (f.chunks[i]->gv.owns(here)) {
+              found = true;
+              if (!f.chunks[i]->is_mine()) break;
+              stencil_point sp;
+              sp.chunk_idx = i;
+              sp.c = f.S.transform(c, sn);
+              sp.idx = f.chunks[i]->gv.index(sp.c, here);
+              sp.w = w[argh] * f.S.phase_shift(c, sn) * kphase * kzphase;
+              sp.series = ipt * cs.size() + ic;
+              stencil.push_back(sp);
+            }
+        }
+      }
+    }
+}
+
+void probe_set::update(const fields &f) {
+  std::fill(local.begin(), local.end(), 0.0);
+  for (const stencil_point &sp : stencil) {
+    const realnum *const *fc = f.chunks[sp.chunk_idx]->f[sp.c];
+    if (fc[0]) local[sp.series] += sp.w * (fc[1] ? getcm(fc, sp.idx) : fc[0][sp.idx]);
+  }
+  sum_to_all(local.data(), global.data(), int(local.size()));
+
+  for (size_t s = 0; s < global.size(); ++s)
+    samples[s * capacity + head] = global[s];
+  times[head] = f.time();
+  head = (head + 1) % capacity;
+  if (count < capacity) ++count;
+}
+
+void probe_set::get_series(size_t ipt, int ic, complex<double> *out) const {
+  const complex<double> *ring = samples.data() + series_offset(ipt, ic);
+  for (size_t n = 0; n < count; ++n)
+    out[n] = ring[ring_index(n)];
+}
+
+std::vector<complex<double> > probe_set::get_series(size_t ipt, int ic) const {
+  std::vector<complex<double> > out(count);
+  get_series(ipt, ic, out.data());
+  return out;
+}
+
+double probe_set::sample_dt() const {
+  return count > 1 ? (time(count - 1) - time(0)) / (count - 1) : 0.0;
+}
+
+std::vector<harminv_result> probe_set::harminv(double fmin, double fmax, int maxbands) const {
+  const size_t nseries = npts * cs.size();
+  if (ring_index(0) == 0) // series are already contiguous, in time order
+    return do_harminv_batch(samples.data(), nseries, int(count), capacity, sample_dt(), fmin,
+                            fmax, maxbands);
+  std::vector<complex<double> > data(nseries * count);
+  for (size_t ipt = 0; ipt < npts; ++ipt)
+    for (size_t ic = 0; ic < cs.size(); ++ic)
+      get_series(ipt, ic, data.data() + (ipt * cs.size() + ic) * count);
+  return do_harminv_batch(data.data(), nseries, int(count), count, sample_dt(), fmin, fmax,
+                          maxbands);
+}
+
 complex<double> monitor_point::get_component(component w) { return f[w]; }
 
 double monitor_point::poynting_in_direction(direction d) {
@@ -19,6 +19,7 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <vector>
 #include "meep.hpp"
 #include "meep_internals.hpp"
 #include "config.h"
@@ -120,10 +121,10 @@ typedef struct {
   size_t sz_data;
   size_t ntot;
   realnum *GammaInv;                    // inv(1 + Gamma * dt / 2)
+  realnum *Gamma1;                      // 1 - Gamma * dt / 2
   realnumP *P[NUM_FIELD_COMPONENTS][2]; // P[c][cmp][transition][i]
   realnumP *P_prev[NUM_FIELD_COMPONENTS][2];
-  realnum *N;    // ntot x L array of centered grid populations N[i*L + level]
-  realnum *Ntmp; // temporary length L array of levels, used in updating
+  realnum *N; // L x ntot array of centered grid populations N[level*ntot + i]
   realnum data[1];
 } multilevel_data;
 
@@ -133,7 +134,7 @@ void *multilevel_susceptibility::new_internal_data(realnum *W[NUM_FIELD_COMPONEN
   FOR_COMPONENTS(c) DOCMP2 {
     if (needs_P(c, cmp, W)) num += 2 * gv.ntot();
   }
-  size_t sz = sizeof(multilevel_data) + sizeof(realnum) * (L * L + L + gv.ntot() * L + num * T - 1);
+  size_t sz = sizeof(multilevel_data) + sizeof(realnum) * (2 * L * L + gv.ntot() * L + num * T - 1);
   multilevel_data *d = (multilevel_data *)malloc(sz);
   if (d == NULL) meep::abort("%s:%i:out of memory(%lu)", __FILE__, __LINE__, sz);
   memset(d, 0, sz);
@@ -149,8 +150,8 @@ void multilevel_susceptibility::init_internal_data(realnum *W[NUM_FIELD_COMPONEN
   d->sz_data = sz_data;
   size_t ntot = d->ntot = gv.ntot();
 
-  /* d->data points to a big block of data that holds GammaInv, P,
-     P_prev, Ntmp, and N.  We also initialize a bunch of convenience
+  /* d->data points to a big block of data that holds GammaInv, Gamma1,
+     P, P_prev, and N.  We also initialize a bunch of convenience
      pointer in d to point to the corresponding data in d->data, so
      that we don't have to remember in other functions how d->data is
      laid out. */
@@ -161,8 +162,13 @@ void multilevel_susceptibility::init_internal_data(realnum *W[NUM_FIELD_COMPONEN
       d->GammaInv[i * L + j] = (i == j) + Gamma[i * L + j] * dt / 2;
   if (!invert(d->GammaInv, L))
     meep::abort("multilevel_susceptibility: I + Gamma*dt/2 matrix singular");
+  d->Gamma1 = d->data + L * L;
+  const realnum dt2 = 0.5 * dt;
+  for (int i = 0; i < L; ++i)
+    for (int j = 0; j < L; ++j)
+      d->Gamma1[i * L + j] = (i == j) - Gamma[i * L + j] * dt2;
 
-  realnum *P = d->data + L * L;
+  realnum *P = d->data + 2 * L * L;
   realnum *P_prev = P + ntot;
   FOR_COMPONENTS(c) DOCMP2 {
     if (needs_P(c, cmp, W)) {
@@ -177,13 +183,12 @@ void multilevel_susceptibility::init_internal_data(realnum *W[NUM_FIELD_COMPONEN
     }
   }
 
-  d->Ntmp = P;
-  d->N = P + L; // the last L*ntot block of the data
+  d->N = P; // the last L*ntot block of the data
 
   // initial populations
-  for (size_t i = 0; i < ntot; ++i)
-    for (int l = 0; l < L; ++l)
-      d->N[i * L + l] = N0[l];
+  for (int l = 0; l < L; ++l)
+    for (size_t i = 0; i < ntot; ++i)
+      d->N[l * ntot + i] = N0[l];
 }
 
 void multilevel_susceptibility::delete_internal_data(void *data) const {
@@ -197,6 +202,16 @@ void multilevel_susceptibility::delete_internal_data(void *data) const {
   }
 }
 
+size_t multilevel_susceptibility::internal_data_size(const void *data) const {
+  if (!data) return 0;
+  const multilevel_data *d = (const multilevel_data *)data;
+  size_t sz = d->sz_data;
+  FOR_COMPONENTS(c) DOCMP2 {
+    if (d->P[c][cmp]) sz += 2 * T * sizeof(realnumP); // P and P_prev pointer arrays
+  }
+  return sz;
+}
+
 void *multilevel_susceptibility::copy_internal_data(void *data) const {
   multilevel_data *d = (multilevel_data *)data;
   if (!d) return 0;
@@ -204,7 +219,8 @@ void *multilevel_susceptibility::copy_internal_data(void *data) const {
   memcpy(dnew, d, d->sz_data);
   size_t ntot = d->ntot;
   dnew->GammaInv = dnew->data;
-  realnum *P = dnew->data + L * L;
+  dnew->Gamma1 = dnew->data + L * L;
+  realnum *P = dnew->data + 2 * L * L;
   realnum *P_prev = P + ntot;
   FOR_COMPONENTS(c) DOCMP2 {
     if (d->P[c][cmp]) {
@@ -218,8 +234,7 @@ void *multilevel_susceptibility::copy_internal_data(void *data) const {
       }
     }
   }
-  dnew->Ntmp = P;
-  dnew->N = P + L;
+  dnew->N = P;
   return (void *)dnew;
 }
 
@@ -237,41 +252,35 @@ realnum *multilevel_susceptibility::cinternal_notowned_ptr(int inotowned, compon
   return d->P[c][cmp][inotowned] + n;
 }
 
-void multilevel_susceptibility::update_P(realnum *W[NUM_FIELD_COMPONENTS][2],
-                                         realnum *W_prev[NUM_FIELD_COMPONENTS][2], realnum dt,
-                                         const grid_volume &gv, void *P_internal_data) const {
-  multilevel_data *d = (multilevel_data *)P_internal_data;
-  realnum dt2 = 0.5 * dt;
-
-  // field directions and offsets for E * dP dot product.
-  component cdot[3] = {Dielectric, Dielectric, Dielectric};
-  ptrdiff_t o1[3], o2[3];
-  int idot = 0;
-  FOR_COMPONENTS(c) {
-    if (d->P[c][0]) {
-      if (idot == 3) meep::abort("bug in meep: too many polarization components");
-      gv.yee2cent_offsets(c, o1[idot], o2[idot]);
-      cdot[idot++] = c;
-    }
-  }
-
-  // update N from W and P
-  realnum *GammaInv = d->GammaInv;
-  realnum *Ntmp = d->Ntmp;
-  LOOP_OVER_VOL_OWNED(gv, Centered, i) {
-    realnum *N = d->N + i * L; // N at current point, to update
-
+// maximum number of levels for which update_N keeps its temporaries on the stack
+static const int max_stack_levels = 16;
+
+/* Update the populations N from W and P.  LL > 0 is a compile-time
+   number of levels (= L), so that the small dense L x L products can be
+   unrolled; LL == 0 is for any L.  Each voxel only needs an L-element
+   temporary, so this is parallelized over voxels. */
+template <int LL>
+static void update_N(int L_, int T, const realnum *alpha, const realnum *gamma, realnum dt,
+                     realnum *W[NUM_FIELD_COMPONENTS][2], realnum *W_prev[NUM_FIELD_COMPONENTS][2],
+                     const grid_volume &gv, multilevel_data *d, const component cdot[3],
+                     const ptrdiff_t o1[3], const ptrdiff_t o2[3]) {
+  const int L = LL > 0 ? LL : L_;
+  const size_t ntot = d->ntot;
+  realnum *N = d->N;
+  const realnum *GammaInv = d->GammaInv, *Gamma1 = d->Gamma1;
+
+  auto update_point = [&](ptrdiff_t i, realnum *Ntmp) {
     // Ntmp = (I - Gamma * dt/2) * N
     for (int l1 = 0; l1 < L; ++l1) {
       Ntmp[l1] = 0;
       for (int l2 = 0; l2 < L; ++l2) {
-        Ntmp[l1] += ((l1 == l2) - Gamma[l1 * L + l2] * dt2) * N[l2];
+        Ntmp[l1] += Gamma1[l1 * L + l2] * N[l2 * ntot + i];
       }
     }
 
     // compute E*8 at point i
     realnum E8[3][2] = {{0.0, 0.0}, {0.0, 0.0}, {0.0, 0.0}};
-    for (idot = 0; idot < 3 && cdot[idot] != Dielectric; ++idot) {
+    for (int idot = 0; idot < 3 && cdot[idot] != Dielectric; ++idot) {
       realnum *w = W[cdot[idot]][0], *wp = W_prev[cdot[idot]][0];
       E8[idot][0] = w[i] + w[i + o1[idot]] + w[i + o2[idot]] + w[i + o1[idot] + o2[idot]] + wp[i] +
                     wp[i + o1[idot]] + wp[i + o2[idot]] + wp[i + o1[idot] + o2[idot]];
@@ -291,7 +300,7 @@ void multilevel_susceptibility::update_P(realnum *W[NUM_FIELD_COMPONENTS][2],
       realnum EdP32 = 0;
       realnum EPave64 = 0;
       realnum gperpdt = gamma[t] * pi * dt;
-      for (idot = 0; idot < 3 && cdot[idot] != Dielectric; ++idot) {
+      for (int idot = 0; idot < 3 && cdot[idot] != Dielectric; ++idot) {
         realnum *p = d->P[cdot[idot]][0][t], *pp = d->P_prev[cdot[idot]][0][t];
         realnum dP = p[i] + p[i + o1[idot]] + p[i + o2[idot]] + p[i + o1[idot] + o2[idot]] -
                      (pp[i] + pp[i + o1[idot]] + pp[i + o2[idot]] + pp[i + o1[idot] + o2[idot]]);
@@ -318,10 +327,49 @@ void multilevel_susceptibility::update_P(realnum *W[NUM_FIELD_COMPONENTS][2],
 
     // N = GammaInv * Ntmp
     for (int l1 = 0; l1 < L; ++l1) {
-      N[l1] = 0;
+      realnum Nl1 = 0;
       for (int l2 = 0; l2 < L; ++l2)
-        N[l1] += GammaInv[l1 * L + l2] * Ntmp[l2];
+        Nl1 += GammaInv[l1 * L + l2] * Ntmp[l2];
+      N[l1 * ntot + i] = Nl1;
     }
+  };
+
+  if (L <= max_stack_levels) {
+    PLOOP_OVER_VOL_OWNED(gv, Centered, i) {
+      realnum Ntmp[LL > 0 ? LL : max_stack_levels];
+      update_point(i, Ntmp);
+    }
+  }
+  else { // rare: too many levels for the stack, so do it serially
+    std::vector<realnum> Ntmp(L);
+    LOOP_OVER_VOL_OWNED(gv, Centered, i) { update_point(i, Ntmp.data()); }
+  }
+}
+
+void multilevel_susceptibility::update_P(realnum *W[NUM_FIELD_COMPONENTS][2],
+                                         realnum *W_prev[NUM_FIELD_COMPONENTS][2], realnum dt,
+                                         const grid_volume &gv, void *P_internal_data) const {
+  multilevel_data *d = (multilevel_data *)P_internal_data;
+  realnum dt2 = 0.5 * dt;
+
+  // field directions and offsets for E * dP dot product.
+  component cdot[3] = {Dielectric, Dielectric, Dielectric};
+  ptrdiff_t o1[3], o2[3];
+  int idot = 0;
+  FOR_COMPONENTS(c) {
+    if (d->P[c][0]) {
+      if (idot == 3) meep::abort("bug in meep: too many polarization components");
+      gv.yee2cent_offsets(c, o1[idot], o2[idot]);
+      cdot[idot++] = c;
+    }
+  }
+
+  // update N from W and P, specialized for the most common numbers of levels
+  switch (L) {
+    case 2: update_N<2>(L, T, alpha, gamma, dt, W, W_prev, gv, d, cdot, o1, o2); break;
+    case 3: update_N<3>(L, T, alpha, gamma, dt, W, W_prev, gv, d, cdot, o1, o2); break;
+    case 4: update_N<4>(L, T, alpha, gamma, dt, W, W_prev, gv, d, cdot, o1, o2); break;
+    default: update_N<0>(L, T, alpha, gamma, dt, W, W_prev, gv, d, cdot, o1, o2);
   }
 
   // each P is updated as a damped harmonic oscillator
@@ -349,9 +397,8 @@ void multilevel_susceptibility::update_P(realnum *W[NUM_FIELD_COMPONENTS][2],
 
           ptrdiff_t o1, o2;
           gv.cent2yee_offsets(c, o1, o2);
-          o1 *= L;
-          o2 *= L;
-          const realnum *N = d->N;
+          // populations of the upper and lower levels, contiguous in i
+          const realnum *Np = d->N + lp * d->ntot, *Nm = d->N + lm * d->ntot;
 
           // directions/strides for offdiagonal terms, similar to update_eh
           const direction d = component_direction(c);
@@ -366,12 +413,11 @@ void multilevel_susceptibility::update_P(realnum *W[NUM_FIELD_COMPONENTS][2],
 
           if (s1 || s2) { meep::abort("nondiagonal saturable gain is not yet supported"); }
           else { // isotropic
-            LOOP_OVER_VOL_OWNED(gv, c, i) {
+            PLOOP_OVER_VOL_OWNED(gv, c, i) {
               realnum pcur = p[i];
-              const realnum *Ni = N + i * L;
               // dNi is population inversion for this transition
-              realnum dNi = 0.25 * (Ni[lp] + Ni[lp + o1] + Ni[lp + o2] + Ni[lp + o1 + o2] - Ni[lm] -
-                                    Ni[lm + o1] - Ni[lm + o2] - Ni[lm + o1 + o2]);
+              realnum dNi = 0.25 * (Np[i] + Np[i + o1] + Np[i + o2] + Np[i + o1 + o2] - Nm[i] -
+                                    Nm[i + o1] - Nm[i + o2] - Nm[i + o1 + o2]);
               p[i] = gamma1inv * (pcur * (2 - omega0dtsqrCorrected) - gamma1 * pp[i] -
                                   dtsqr * (st * s[i] * w[i]) * dNi);
               pp[i] = pcur;
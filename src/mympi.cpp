@@ -388,6 +388,14 @@ double max_to_all(double in) {
   return out;
 }
 
+void max_to_all(const double *in, double *out, int size) {
+#ifdef HAVE_MPI
+  MPI_Allreduce((void *)in, out, size, MPI_DOUBLE, MPI_MAX, mycomm);
+#else
+  memcpy(out, in, sizeof(double) * size);
+#endif
+}
+
 int max_to_all(int in) {
   int out = in;
 #ifdef HAVE_MPI
@@ -670,6 +670,7 @@ std::vector<struct sourcedata> dft_near2far::near_sourcedata(const vec &x_0, dou
       vec xs(x0);
       double w;
       w = IVEC_LOOP_WEIGHT(f->s0, f->s1, f->e0, f->e1, f->dV0 + f->dV1 * loop_i2);
+      w *= f->fc->s->stretch_weight(ix0, f->empty_dim);
 
       temp_struct.idx_arr.push_back(idx);
       for (size_t i = 0; i < Nfreq; ++i) {
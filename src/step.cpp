@@ -40,6 +40,8 @@ void fields::step() {
     restore_magnetic_fields();
   }
 
+  save_prev_magnetic_fields();
+
   am_now_working_on(Stepping);
 
   if (!t) {
@@ -49,7 +51,7 @@ void fields::step() {
   if (verbosity > 0 && wall_time() > last_step_output_wall_time + MEEP_MIN_OUTPUT_TIME) {
     master_printf("on time step %d (time=%g), %g s/step\n", t, time(),
                   (wall_time() - last_step_output_wall_time) / (t - last_step_output_t));
-    if (save_synchronized_magnetic_fields)
+    if (save_synchronized_magnetic_fields && !synchronized_from_prev)
       master_printf("  (doing expensive timestepping of synched fields)\n");
     last_step_output_wall_time = wall_time();
     last_step_output_t = t;
@@ -81,6 +83,10 @@ void fields::step() {
     step_boundaries(WH_stuff);
   }
   update_pols(H_stuff);
+  // newly allocated polarizations re-connect the chunks, which can leave E/H values that
+  // the new connections only send in the W exchange: send W again with those connections
+  if (changed_materials) sync_chunk_connections();
+  if (!chunk_connections_valid) step_boundaries(WH_stuff);
   {
     auto step_timer = with_timing_scope(BoundarySteppingPH);
     step_boundaries(PH_stuff);
@@ -112,6 +118,8 @@ void fields::step() {
     step_boundaries(WE_stuff);
   }
   update_pols(E_stuff);
+  if (changed_materials) sync_chunk_connections();
+  if (!chunk_connections_valid) step_boundaries(WE_stuff);
   {
     auto step_timer = with_timing_scope(BoundarySteppingPE);
     step_boundaries(PE_stuff);
@@ -154,10 +162,10 @@ void fields::phase_material() {
     if (changed_mpi) {
       calc_sources(time() + 0.5 * dt); // for integrated H sources
       update_eh(H_stuff);              // ensure H = 1/mu * B
-      step_boundaries(H_stuff);
+      step_eh_boundaries(H_stuff);
       calc_sources(time() + dt); // for integrated E sources
       update_eh(E_stuff);        // ensure E = 1/eps * D
-      step_boundaries(E_stuff);
+      step_eh_boundaries(E_stuff);
     }
   }
 }
@@ -173,7 +181,7 @@ void fields::process_incoming_chunk_data(field_type ft, const chunk_pair &comm_p
   am_now_working_on(Boundaries);
   int this_chunk_idx = comm_pair.second;
   const int pair_idx = chunk_pair_to_index(comm_pair);
-  const realnum *pair_comm_block = static_cast<realnum *>(comm_blocks[ft][pair_idx]);
+  const realnum *pair_comm_block = comm_blocks[ft].at(pair_idx).data();
 
   {
     const comms_key key = {ft, CONNECT_PHASE, comm_pair};
@@ -236,7 +244,8 @@ void fields::step_boundaries(field_type ft) {
       comms_manager::receive_callback cb = [this, ft, comm_pair]() {
         process_incoming_chunk_data(ft, comm_pair);
       };
-      manager->receive_real_async(comm_blocks[ft][op.pair_idx], static_cast<int>(op.transfer_size),
+      manager->receive_real_async(comm_blocks[ft].at(op.pair_idx).data(),
+                                  static_cast<int>(op.transfer_size),
                                   op.other_proc_id, op.tag, cb);
     }
 
@@ -250,9 +259,9 @@ void fields::step_boundaries(field_type ft) {
 
     for (const comms_operation &op : sequence.send_ops) {
       const std::pair<int, int> comm_pair{op.my_chunk_idx, op.other_chunk_idx};
-      const int pair_idx = op.pair_idx;
 
-      realnum *outgoing_comm_block = comm_blocks[ft][pair_idx];
+      realnum *const comm_block = comm_blocks[ft].at(op.pair_idx).data();
+      realnum *outgoing_comm_block = comm_block;
       for (connect_phase ip : all_connect_phases) {
         const comms_key key = {ft, ip, comm_pair};
         const size_t pair_comm_size = get_comm_size(key);
@@ -266,7 +275,7 @@ void fields::step_boundaries(field_type ft) {
         }
       }
       if (chunks[op.other_chunk_idx]->is_mine()) { continue; }
-      manager->send_real_async(comm_blocks[ft][pair_idx], static_cast<int>(op.transfer_size),
+      manager->send_real_async(comm_block, static_cast<int>(op.transfer_size),
                                op.other_proc_id, op.tag);
     }
 
@@ -286,6 +295,15 @@ void fields::step_boundaries(field_type ft) {
   finished_working();
 }
 
+/* step() always exchanges WE/WH before E/H, but elsewhere the E/H values
+   that connect_the_chunks only sends in the W exchange must be sent too */
+void fields::step_eh_boundaries(field_type ft) {
+  connect_chunks();
+  const field_type wft = ft == E_stuff ? WE_stuff : WH_stuff;
+  if (shared_with_W[wft]) step_boundaries(wft);
+  step_boundaries(ft);
+}
+
 void fields::step_source(field_type ft, bool including_integrated) {
   if (ft != D_stuff && ft != B_stuff) meep::abort("only step_source(D/B) is okay");
   for (int i = 0; i < num_chunks; i++)
@@ -65,17 +65,15 @@ bool fields_chunk::step_db(field_type ft) {
         bool use_bfast = bfast_scaled_k[0] || bfast_scaled_k[1] || bfast_scaled_k[2];
 
         if (dsig != NO_DIRECTION && s->conductivity[cc][d_c] && !f_cond[cc][cmp]) {
-          f_cond[cc][cmp] = new realnum[gv.ntot()];
-          memset(f_cond[cc][cmp], 0, sizeof(realnum) * gv.ntot());
+          f_cond[cc][cmp] = arena.alloc(); // zero-initialized
         }
         if (dsigu != NO_DIRECTION && !f_u[cc][cmp]) {
-          f_u[cc][cmp] = new realnum[gv.ntot()];
+          f_u[cc][cmp] = arena.alloc();
           memcpy(f_u[cc][cmp], the_f, gv.ntot() * sizeof(realnum));
           allocated_u = true;
         }
         if (use_bfast && !f_bfast[cc][cmp]) {
-          f_bfast[cc][cmp] = new realnum[gv.ntot()];
-          memset(f_bfast[cc][cmp], 0, sizeof(realnum) * gv.ntot());
+          f_bfast[cc][cmp] = arena.alloc(); // zero-initialized
         }
 
         if (ft == D_stuff) { // strides are opposite sign for H curl
@@ -101,7 +99,7 @@ bool fields_chunk::step_db(field_type ft) {
                  and get the correct derivative.  (More precisely,
                  the derivative and integral are replaced by differences
                  and sums, but you get the idea). */
-              if (!f_rderiv_int) f_rderiv_int = new realnum[gv.ntot()];
+              if (!f_rderiv_int) f_rderiv_int = arena.alloc();
               realnum ir0 = gv.origin_r() * gv.a + 0.5 * gv.iyee_shift(c_p).in_direction(R);
               for (int iz = 0; iz <= gv.nz(); ++iz)
                 f_rderiv_int[iz] = 0;
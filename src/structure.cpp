@@ -64,16 +64,26 @@ structure::structure(const grid_volume &thegv, double eps(const vec &), const bo
 }
 
 static std::unique_ptr<binary_partition> split_by_cost(int n, grid_volume gvol, bool fragment_cost,
-                                                       int &proc_id) {
-  if (n == 1)
+                                                       int &proc_id,
+                                                       const split_cost_grid *costs = NULL) {
+  if (n == 1) {
+    const double budget = meep_geom::fragment_stats::memory_budget;
+    if (fragment_cost && budget > 0) {
+      const double mem = costs ? costs->cost(gvol, true) : gvol.get_memory_cost();
+      if (mem > budget)
+        master_printf_stderr("Warning: chunk estimated to need %g MB, more than the memory budget "
+                             "of %g MB; consider using more chunks.\n",
+                             mem * 1e-6, budget * 1e-6);
+    }
     return std::unique_ptr<binary_partition>(new binary_partition(proc_id++ % count_processors()));
+  }
 
   int best_split_point;
   direction best_split_direction;
   double best_split_position;
   double left_effort_fraction;
   gvol.find_best_split(n, fragment_cost, best_split_point, best_split_direction,
-                       left_effort_fraction);
+                       left_effort_fraction, costs);
 
   const int num_left = static_cast<int>(left_effort_fraction * n + 0.5);
   if (num_left == 0 || num_left == n) {
@@ -89,8 +99,8 @@ static std::unique_ptr<binary_partition> split_by_cost(int n, grid_volume gvol,
   grid_volume right_gvol = gvol.split_at_fraction(true, best_split_point, best_split_direction);
   return std::unique_ptr<binary_partition>(new binary_partition(
       optimal_plane,
-      /*left=*/split_by_cost(num_left, left_gvol, fragment_cost, proc_id),
-      /*right=*/split_by_cost(n - num_left, right_gvol, fragment_cost, proc_id)));
+      /*left=*/split_by_cost(num_left, left_gvol, fragment_cost, proc_id, costs),
+      /*right=*/split_by_cost(n - num_left, right_gvol, fragment_cost, proc_id, costs)));
 }
 
 void structure::choose_chunkdivision(const grid_volume &thegv, int desired_num_chunks,
@@ -193,7 +203,12 @@ std::unique_ptr<binary_partition> choose_chunkdivision(grid_volume &gv, volume &
   else {
     if (verbosity > 0 && desired_num_chunks > 1)
       master_printf("Splitting into %d chunks by cost\n", desired_num_chunks);
-    return split_by_cost(desired_num_chunks, gv, true, proc_id);
+    /* The direct search computes O(log n) fragment_stats per direction for each of the
+       desired_num_chunks - 1 splits, so it is cheaper for a few chunks than the cost grid,
+       whose cells (enough that each chunk covers several hundred) are computed once. */
+    if (desired_num_chunks < 16) return split_by_cost(desired_num_chunks, gv, true, proc_id);
+    const split_cost_grid costs(gv, 512 * size_t(desired_num_chunks));
+    return split_by_cost(desired_num_chunks, gv, true, proc_id, &costs);
   }
 }
 
@@ -506,6 +521,21 @@ void structure::add_susceptibility(material_function &sigma, field_type ft,
   }
 }
 
+void structure::use_grid_stretch(direction d, grid_stretch_func stretch_func,
+                                 void *stretch_data) {
+  if (!has_direction(gv.dim, d)) meep::abort("grid stretch along a direction not in the cell");
+  changing_chunks();
+  for (int i = 0; i < num_chunks; i++)
+    chunks[i]->use_grid_stretch(d, stretch_func, stretch_data);
+}
+
+bool structure::has_grid_stretch(direction d) const {
+  int i;
+  for (i = 0; i < num_chunks && !(chunks[i]->is_mine() && chunks[i]->stretch[d]); i++)
+    ;
+  return or_to_all(i < num_chunks);
+}
+
 void structure::use_pml(direction d, boundary_side b, double dx) {
   if (dx <= 0.0) return;
   grid_volume pml_volume = gv;
@@ -555,6 +585,13 @@ bool structure_chunk::has_nonlinearities() const {
   return nonlinear;
 }
 
+bool structure_chunk::has_grid_stretch() const {
+  if (!is_mine()) return false;
+  for (int d = 0; d < 6; ++d)
+    if (stretch[d]) return true;
+  return false;
+}
+
 void structure::mix_with(const structure *oth, double f) {
   if (num_chunks != oth->num_chunks)
     meep::abort("You can't phase materials with different chunk topologies...\n");
@@ -577,6 +614,7 @@ structure_chunk::~structure_chunk() {
     delete[] sig[d];
     delete[] kap[d];
     delete[] siginv[d];
+    delete[] stretch[d];
   }
   FOR_FIELD_TYPES(ft) { delete chiP[ft]; }
 }
@@ -686,6 +724,66 @@ void structure_chunk::use_pml(direction d, double dx, double bloc, double Rasymp
         siginv[d][idx] = 1 / (kap[d][idx] + sig[d][idx]);
       }
     }
+    if (stretch[d]) // compose the PML with the graded grid: s -> stretch * s
+      for (int idx = 0; idx < sigsize[d]; ++idx) {
+        sig[d][idx] *= stretch[d][idx];
+        kap[d][idx] *= stretch[d][idx];
+        siginv[d][idx] = 1 / (kap[d][idx] + sig[d][idx]);
+      }
+  }
+  condinv_stale = true;
+}
+
+/* A real coordinate stretch by stretch(x) >= 1 is a PML with sigma = 0 and
+   kappa = stretch(x), so we multiply it into the sig/kap arrays (allocating
+   them as use_pml does if there is no PML in this chunk).  Any previous
+   stretch along d is divided out first. */
+void structure_chunk::use_grid_stretch(direction d, grid_stretch_func stretch_func,
+                                       void *stretch_data) {
+  if (!is_mine()) return;
+  LOOP_OVER_FIELD_DIRECTIONS(gv.dim, dd) {
+    if (!sig[dd]) {
+      int spml = (dd == d) ? (2 * gv.num_direction(d) + 2) : 1;
+      sigsize[dd] = spml;
+      sig[dd] = new realnum[spml];
+      kap[dd] = new realnum[spml];
+      siginv[dd] = new realnum[spml];
+      for (int i = 0; i < spml; ++i) {
+        sig[dd][i] = 0.0;
+        kap[dd][i] = 1.0;
+        siginv[dd][i] = 1.0;
+      }
+    }
+  }
+  if (sigsize[d] == 1) { // PML arrays from another direction: widen to a profile along d
+    sigsize[d] = 2 * gv.num_direction(d) + 2;
+    const realnum sig0 = sig[d][0], kap0 = kap[d][0];
+    delete[] sig[d];
+    delete[] kap[d];
+    delete[] siginv[d];
+    sig[d] = new realnum[sigsize[d]];
+    kap[d] = new realnum[sigsize[d]];
+    siginv[d] = new realnum[sigsize[d]];
+    for (int i = 0; i < sigsize[d]; ++i) {
+      sig[d][i] = sig0;
+      kap[d][i] = kap0;
+      siginv[d][i] = 1 / (kap0 + sig0);
+    }
+  }
+  if (!stretch[d]) {
+    stretch[d] = new realnum[sigsize[d]];
+    for (int i = 0; i < sigsize[d]; ++i)
+      stretch[d][i] = 1.0;
+  }
+  for (int i = gv.little_corner().in_direction(d); i <= gv.big_corner().in_direction(d) + 1;
+       ++i) {
+    int idx = i - gv.little_corner().in_direction(d);
+    double st = stretch_func(i * 0.5 / a, stretch_data);
+    if (st < 1) meep::abort("grid stretch %g < 1 would violate the Courant condition", st);
+    sig[d][idx] *= st / stretch[d][idx];
+    kap[d][idx] *= st / stretch[d][idx];
+    siginv[d][idx] = 1 / (kap[d][idx] + sig[d][idx]);
+    stretch[d][idx] = st;
   }
   condinv_stale = true;
 }
@@ -745,6 +843,8 @@ structure_chunk::structure_chunk(const structure_chunk *o) : v(o->v) {
         chi2[c][i] = o->chi2[c][i];
     }
     else { chi2[c] = NULL; }
+    nonlinear_lo[c] = o->nonlinear_lo[c];
+    nonlinear_hi[c] = o->nonlinear_hi[c];
   }
   FOR_COMPONENTS(c) FOR_DIRECTIONS(d) { trivial_chi1inv[c][d] = true; }
   FOR_COMPONENTS(c) FOR_DIRECTIONS(d) {
@@ -773,22 +873,25 @@ structure_chunk::structure_chunk(const structure_chunk *o) : v(o->v) {
     kap[d] = NULL;
     siginv[d] = NULL;
     sigsize[d] = 0;
+    stretch[d] = NULL;
   }
-  for (int i = 0; i < 5; ++i)
-    sigsize[i] = 0;
-  // Copy over the PML conductivity arrays:
+  // Copy over the PML conductivity and grid-stretch arrays:
   if (is_mine()) FOR_DIRECTIONS(d) {
       if (o->sig[d]) {
-        sig[d] = new realnum[2 * gv.num_direction(d) + 1];
-        kap[d] = new realnum[2 * gv.num_direction(d) + 1];
-        siginv[d] = new realnum[2 * gv.num_direction(d) + 1];
         sigsize[d] = o->sigsize[d];
-        for (int i = 0; i < 2 * gv.num_direction(d) + 1; i++) {
+        sig[d] = new realnum[sigsize[d]];
+        kap[d] = new realnum[sigsize[d]];
+        siginv[d] = new realnum[sigsize[d]];
+        for (int i = 0; i < sigsize[d]; i++) {
           sig[d][i] = o->sig[d][i];
           kap[d][i] = o->kap[d][i];
           siginv[d][i] = o->siginv[d][i];
         }
       }
+      if (o->stretch[d]) {
+        stretch[d] = new realnum[o->sigsize[d]];
+        memcpy(stretch[d], o->stretch[d], o->sigsize[d] * sizeof(realnum));
+      }
     }
 }
 
@@ -825,6 +928,7 @@ void structure_chunk::set_chi3(component c, material_function &epsilon) {
       chi3[c] = NULL;
     }
   }
+  update_nonlinear_box(c);
 
   epsilon.unset_volume();
 }
@@ -861,10 +965,26 @@ void structure_chunk::set_chi2(component c, material_function &epsilon) {
       chi2[c] = NULL;
     }
   }
+  update_nonlinear_box(c);
 
   epsilon.unset_volume();
 }
 
+void structure_chunk::update_nonlinear_box(component c) {
+  ivec lo = gv.big_corner() + gv.iyee_shift(c), hi = gv.little_corner() + gv.iyee_shift(c);
+  if (chi2[c] || chi3[c]) LOOP_OVER_VOL(gv, c, i) {
+      if ((chi2[c] && chi2[c][i] != 0) || (chi3[c] && chi3[c][i] != 0)) {
+        IVEC_LOOP_ILOC(gv, here);
+        LOOP_OVER_DIRECTIONS(gv.dim, d) {
+          lo.set_direction(d, std::min(lo.in_direction(d), here.in_direction(d)));
+          hi.set_direction(d, std::max(hi.in_direction(d), here.in_direction(d)));
+        }
+      }
+    }
+  nonlinear_lo[c] = lo;
+  nonlinear_hi[c] = hi;
+}
+
 void structure_chunk::set_conductivity(component c, material_function &C) {
   if (!is_mine() || !gv.has_field(c)) return;
 
@@ -919,6 +1039,7 @@ structure_chunk::structure_chunk(const grid_volume &thegv, const volume &vol_lim
   // initialize materials arrays to NULL
   FOR_COMPONENTS(c) { chi3[c] = NULL; }
   FOR_COMPONENTS(c) { chi2[c] = NULL; }
+  FOR_COMPONENTS(c) { update_nonlinear_box(c); }
   FOR_COMPONENTS(c) FOR_DIRECTIONS(d) {
     trivial_chi1inv[c][d] = true;
     chi1inv[c][d] = NULL;
@@ -931,6 +1052,7 @@ structure_chunk::structure_chunk(const grid_volume &thegv, const volume &vol_lim
     kap[d] = NULL;
     siginv[d] = NULL;
     sigsize[d] = 0;
+    stretch[d] = NULL;
   }
 }
 
@@ -138,6 +138,10 @@ void lorentzian_susceptibility::init_internal_data(realnum *W[NUM_FIELD_COMPONEN
   }
 }
 
+size_t lorentzian_susceptibility::internal_data_size(const void *data) const {
+  return data ? ((const lorentzian_data *)data)->sz_data : 0;
+}
+
 void *lorentzian_susceptibility::copy_internal_data(void *data) const {
   lorentzian_data *d = (lorentzian_data *)data;
   if (!d) return 0;
@@ -413,6 +417,10 @@ void gyrotropic_susceptibility::init_internal_data(realnum *W[NUM_FIELD_COMPONEN
   }
 }
 
+size_t gyrotropic_susceptibility::internal_data_size(const void *data) const {
+  return data ? ((const gyrotropy_data *)data)->sz_data : 0;
+}
+
 void *gyrotropic_susceptibility::copy_internal_data(void *data) const {
   gyrotropy_data *d = (gyrotropy_data *)data;
   if (!d) return 0;
@@ -442,6 +450,106 @@ bool gyrotropic_susceptibility::needs_P(component c, int cmp,
 // Similar to the OFFDIAG macro, but without averaging sigma.
 #define OFFDIAGW(g, sx, s) (0.25 * (g[i] + g[i - sx] + g[i + s] + g[i + s - sx]))
 
+/* The gyrotropic update of the three polarization components p0, p1, p2
+   (SoA: one array per direction, contiguous in the voxel index) at each
+   voxel is independent of the other voxels, so it is parallelized and,
+   when the inner loop is stride-1, vectorized.  All coefficients are
+   hoisted into local variables, and HAVE_W1/HAVE_W2 (whether the
+   off-diagonal driving fields exist) are template parameters so that
+   the loop body has no branches. */
+template <class F> static void gyrotropic_loop(const grid_volume &gv, component c, F update) {
+  if (LOOPS_ARE_STRIDE1(gv)) {
+    PS1LOOP_OVER_VOL_OWNED(gv, c, i) { update(i); }
+  }
+  else {
+    PLOOP_OVER_VOL_OWNED(gv, c, i) { update(i); }
+  }
+}
+
+template <bool HAVE_W1, bool HAVE_W2>
+static void gyrotropic_lorentzian_update(const grid_volume &gv, component c, realnum diag,
+                                         realnum gamma1, realnum omega0dtsqr, const realnum g[3][3],
+                                         const realnum inv[3][3], const realnum *s,
+                                         const realnum *w0, const realnum *w1, const realnum *w2,
+                                         ptrdiff_t is, ptrdiff_t is1, ptrdiff_t is2, realnum *p0,
+                                         realnum *pp0, realnum *p1, realnum *pp1, realnum *p2,
+                                         realnum *pp2) {
+  // g[a][b] = pt * gyro_tensor[da][db] in the local (d0, d1, d2) frame
+  const realnum g01 = g[0][1], g02 = g[0][2], g10 = g[1][0], g12 = g[1][2], g20 = g[2][0],
+                g21 = g[2][1];
+  const realnum i00 = inv[0][0], i01 = inv[0][1], i02 = inv[0][2], i10 = inv[1][0],
+                i11 = inv[1][1], i12 = inv[1][2], i20 = inv[2][0], i21 = inv[2][1],
+                i22 = inv[2][2];
+  gyrotropic_loop(gv, c, [=](ptrdiff_t i) {
+    const realnum q0 = p0[i], q1 = p1[i], q2 = p2[i];
+    const realnum qp0 = pp0[i], qp1 = pp1[i], qp2 = pp2[i];
+    const realnum r0 =
+        diag * q0 - gamma1 * qp0 + omega0dtsqr * s[i] * w0[i] - g01 * qp1 - g02 * qp2;
+    const realnum r1 = diag * q1 - gamma1 * qp1 +
+                       (HAVE_W1 ? omega0dtsqr * s[i] * OFFDIAGW(w1, is1, is) : 0) - g10 * qp0 -
+                       g12 * qp2;
+    const realnum r2 = diag * q2 - gamma1 * qp2 +
+                       (HAVE_W2 ? omega0dtsqr * s[i] * OFFDIAGW(w2, is2, is) : 0) - g21 * qp1 -
+                       g20 * qp0;
+    pp0[i] = q0;
+    pp1[i] = q1;
+    pp2[i] = q2;
+    p0[i] = i00 * r0 + i01 * r1 + i02 * r2;
+    p1[i] = i10 * r0 + i11 * r1 + i12 * r2;
+    p2[i] = i20 * r0 + i21 * r1 + i22 * r2;
+  });
+}
+
+template <bool HAVE_W1, bool HAVE_W2>
+static void gyrotropic_saturated_update(const grid_volume &gv, component c, realnum omega2pidt,
+                                        realnum g2pidt, realnum dt2pi, realnum alpha,
+                                        const realnum g[3][3], const realnum inv[3][3],
+                                        const realnum *s, const realnum *w0, const realnum *w1,
+                                        const realnum *w2, ptrdiff_t is, ptrdiff_t is1,
+                                        ptrdiff_t is2, realnum *p0, realnum *pp0, realnum *p1,
+                                        realnum *pp1, realnum *p2, realnum *pp2) {
+  // g[a][b] = gyro_tensor[da][db] in the local (d0, d1, d2) frame
+  const realnum g01 = g[0][1], g02 = g[0][2], g10 = g[1][0], g12 = g[1][2], g20 = g[2][0],
+                g21 = g[2][1];
+  const realnum i00 = inv[0][0], i01 = inv[0][1], i02 = inv[0][2], i10 = inv[1][0],
+                i11 = inv[1][1], i12 = inv[1][2], i20 = inv[2][0], i21 = inv[2][1],
+                i22 = inv[2][2];
+  const realnum halfalpha = 0.5 * alpha;
+  gyrotropic_loop(gv, c, [=](ptrdiff_t i) {
+    const realnum x0 = p0[i], x1 = p1[i], x2 = p2[i];
+    const realnum xp0 = pp0[i], xp1 = pp1[i], xp2 = pp2[i];
+    const realnum q0 = -omega2pidt * x0 + halfalpha * xp0 + dt2pi * s[i] * w0[i];
+    const realnum q1 =
+        -omega2pidt * x1 + halfalpha * xp1 + dt2pi * s[i] * (HAVE_W1 ? OFFDIAGW(w1, is1, is) : 0);
+    const realnum q2 =
+        -omega2pidt * x2 + halfalpha * xp2 + dt2pi * s[i] * (HAVE_W2 ? OFFDIAGW(w2, is2, is) : 0);
+
+    const realnum r0 = 0.5 * xp0 - g2pidt * x0 + g01 * q1 + g02 * q2;
+    const realnum r1 = 0.5 * xp1 - g2pidt * x1 + g12 * q2 + g10 * q0;
+    const realnum r2 = 0.5 * xp2 - g2pidt * x2 + g20 * q0 + g21 * q1;
+
+    pp0[i] = x0;
+    pp1[i] = x1;
+    pp2[i] = x2;
+    p0[i] = i00 * r0 + i01 * r1 + i02 * r2;
+    p1[i] = i10 * r0 + i11 * r1 + i12 * r2;
+    p2[i] = i20 * r0 + i21 * r1 + i22 * r2;
+  });
+}
+
+// call f<HAVE_W1, HAVE_W2>(args...) for the given run-time w1, w2
+#define GYROTROPIC_DISPATCH(f, w1, w2, ...)                                                        \
+  do {                                                                                             \
+    if (w1 && w2)                                                                                  \
+      f<true, true>(__VA_ARGS__);                                                                  \
+    else if (w1)                                                                                   \
+      f<true, false>(__VA_ARGS__);                                                                 \
+    else if (w2)                                                                                   \
+      f<false, true>(__VA_ARGS__);                                                                 \
+    else                                                                                           \
+      f<false, false>(__VA_ARGS__);                                                                \
+  } while (0)
+
 void gyrotropic_susceptibility::update_P(realnum *W[NUM_FIELD_COMPONENTS][2],
                                          realnum *W_prev[NUM_FIELD_COMPONENTS][2], realnum dt,
                                          const grid_volume &gv, void *P_internal_data) const {
@@ -489,29 +597,21 @@ void gyrotropic_susceptibility::update_P(realnum *W[NUM_FIELD_COMPONENTS][2],
           const ptrdiff_t is = gv.stride(d0) * (is_magnetic(c) ? -1 : +1);
           const ptrdiff_t is1 = gv.stride(d1) * (is_magnetic(c) ? -1 : +1);
           const ptrdiff_t is2 = gv.stride(d2) * (is_magnetic(c) ? -1 : +1);
-          realnum r0, r1, r2;
 
           if (!pp1 || !pp2) meep::abort("gyrotropic media require 3D Cartesian fields\n");
           if (sigma[c][d1] || sigma[c][d2])
             meep::abort("gyrotropic media do not support anisotropic sigma\n");
 
-          LOOP_OVER_VOL_OWNED(gv, c, i) {
-            r0 = diag * p0[i] - gamma1 * pp0[i] + omega0dtsqr * s[i] * w0[i] -
-                 pt * gyro_tensor[d0][d1] * pp1[i] - pt * gyro_tensor[d0][d2] * pp2[i];
-            r1 = diag * p1[i] - gamma1 * pp1[i] +
-                 (w1 ? omega0dtsqr * s[i] * OFFDIAGW(w1, is1, is) : 0) -
-                 pt * gyro_tensor[d1][d0] * pp0[i] - pt * gyro_tensor[d1][d2] * pp2[i];
-            r2 = diag * p2[i] - gamma1 * pp2[i] +
-                 (w2 ? omega0dtsqr * s[i] * OFFDIAGW(w2, is2, is) : 0) -
-                 pt * gyro_tensor[d2][d1] * pp1[i] - pt * gyro_tensor[d2][d0] * pp0[i];
-
-            pp0[i] = p0[i];
-            pp1[i] = p1[i];
-            pp2[i] = p2[i];
-            p0[i] = inv[d0][d0] * r0 + inv[d0][d1] * r1 + inv[d0][d2] * r2;
-            p1[i] = inv[d1][d0] * r0 + inv[d1][d1] * r1 + inv[d1][d2] * r2;
-            p2[i] = inv[d2][d0] * r0 + inv[d2][d1] * r1 + inv[d2][d2] * r2;
-          }
+          const direction dd[3] = {d0, d1, d2};
+          realnum g[3][3], inv_local[3][3];
+          for (int a = 0; a < 3; ++a)
+            for (int b = 0; b < 3; ++b) {
+              g[a][b] = pt * gyro_tensor[dd[a]][dd[b]];
+              inv_local[a][b] = inv[dd[a]][dd[b]];
+            }
+          GYROTROPIC_DISPATCH(gyrotropic_lorentzian_update, w1, w2, gv, c, diag, gamma1,
+                              omega0dtsqr, g, inv_local, s, w0, w1, w2, is, is1, is2, p0, pp0, p1,
+                              pp1, p2, pp2);
         }
       }
     } break;
@@ -550,33 +650,21 @@ void gyrotropic_susceptibility::update_P(realnum *W[NUM_FIELD_COMPONENTS][2],
           const ptrdiff_t is = gv.stride(d0) * (is_magnetic(c) ? -1 : +1);
           const ptrdiff_t is1 = gv.stride(d1) * (is_magnetic(c) ? -1 : +1);
           const ptrdiff_t is2 = gv.stride(d2) * (is_magnetic(c) ? -1 : +1);
-          realnum r0, r1, r2, q0, q1, q2;
 
           if (!pp1 || !pp2) meep::abort("gyrotropic media require 3D Cartesian fields\n");
           if (sigma[c][d1] || sigma[c][d2])
             meep::abort("gyrotropic media do not support anisotropic sigma\n");
 
-          LOOP_OVER_VOL_OWNED(gv, c, i) {
-            q0 = -omega2pidt * p0[i] + 0.5 * alpha * pp0[i] + dt2pi * s[i] * w0[i];
-            q1 = -omega2pidt * p1[i] + 0.5 * alpha * pp1[i] +
-                 dt2pi * s[i] * (w1 ? OFFDIAGW(w1, is1, is) : 0);
-            q2 = -omega2pidt * p2[i] + 0.5 * alpha * pp2[i] +
-                 dt2pi * s[i] * (w2 ? OFFDIAGW(w2, is2, is) : 0);
-
-            r0 =
-                0.5 * pp0[i] - g2pidt * p0[i] + gyro_tensor[d0][d1] * q1 + gyro_tensor[d0][d2] * q2;
-            r1 =
-                0.5 * pp1[i] - g2pidt * p1[i] + gyro_tensor[d1][d2] * q2 + gyro_tensor[d1][d0] * q0;
-            r2 =
-                0.5 * pp2[i] - g2pidt * p2[i] + gyro_tensor[d2][d0] * q0 + gyro_tensor[d2][d1] * q1;
-
-            pp0[i] = p0[i];
-            pp1[i] = p1[i];
-            pp2[i] = p2[i];
-            p0[i] = inv[d0][d0] * r0 + inv[d0][d1] * r1 + inv[d0][d2] * r2;
-            p1[i] = inv[d1][d0] * r0 + inv[d1][d1] * r1 + inv[d1][d2] * r2;
-            p2[i] = inv[d2][d0] * r0 + inv[d2][d1] * r1 + inv[d2][d2] * r2;
-          }
+          const direction dd[3] = {d0, d1, d2};
+          realnum g[3][3], inv_local[3][3];
+          for (int a = 0; a < 3; ++a)
+            for (int b = 0; b < 3; ++b) {
+              g[a][b] = gyro_tensor[dd[a]][dd[b]];
+              inv_local[a][b] = inv[dd[a]][dd[b]];
+            }
+          GYROTROPIC_DISPATCH(gyrotropic_saturated_update, w1, w2, gv, c, omega2pidt, g2pidt,
+                              dt2pi, alpha, g, inv_local, s, w0, w1, w2, is, is1, is2, p0, pp0,
+                              p1, pp1, p2, pp2);
         }
       }
     } break;
@@ -25,12 +25,54 @@ using namespace std;
 
 namespace meep {
 
+/* Split the box [is, ie] of Yee-grid points into its intersection with
+   the box [*ns, *ne], which is returned in [*ns, *ne] (return value
+   false if empty), and the rest, which is returned as *nout <= 6
+   disjoint boxes in [out_s, out_e]. */
+static bool split_box(ndim dim, const ivec &is, const ivec &ie, ivec *ns, ivec *ne, ivec out_s[6],
+                      ivec out_e[6], int *nout) {
+  *nout = 0;
+  LOOP_OVER_DIRECTIONS(dim, d) {
+    if (ns->in_direction(d) > ie.in_direction(d) || ne->in_direction(d) < is.in_direction(d) ||
+        ns->in_direction(d) > ne->in_direction(d)) {
+      out_s[0] = is;
+      out_e[0] = ie;
+      *nout = 1;
+      return false;
+    }
+  }
+  ivec cs = is, ce = ie; // remaining box, shrunk to the intersection one direction at a time
+  LOOP_OVER_DIRECTIONS(dim, d) {
+    if (ns->in_direction(d) > cs.in_direction(d)) {
+      out_s[*nout] = cs;
+      out_e[*nout] = ce;
+      out_e[*nout].set_direction(d, ns->in_direction(d) - 2);
+      ++*nout;
+      cs.set_direction(d, ns->in_direction(d));
+    }
+    if (ne->in_direction(d) < ce.in_direction(d)) {
+      out_s[*nout] = cs;
+      out_e[*nout] = ce;
+      out_s[*nout].set_direction(d, ne->in_direction(d) + 2);
+      ++*nout;
+      ce.set_direction(d, ne->in_direction(d));
+    }
+  }
+  *ns = cs;
+  *ne = ce;
+  return true;
+}
+
 void fields::update_eh(field_type ft, bool skip_w_components) {
   if (ft != E_stuff && ft != H_stuff) meep::abort("update_eh only works with E/H");
 
   // split the chunks' volume into subdomains for tiled execution of update_eh loop
   for (int i = 0; i < num_chunks; i++)
     if (chunks[i]->is_mine() && changed_materials) {
+      // E (or H) is identically zero in a perfect-metal chunk, which
+      // fields_chunk::update_eh then zeroes instead of updating
+      chunks[i]->all_metal[ft] = chunks[i]->is_all_metal(ft);
+
       bool is_aniso = false;
       FOR_FT_COMPONENTS(ft, cc) {
         const direction d_c = component_direction(cc);
@@ -87,10 +129,10 @@ bool fields_chunk::update_eh(field_type ft, bool skip_w_components) {
           need_fmp = need_fmp || p->s->needs_P(ec, cmp, f);
       }
       if (need_fmp) {
-        if (!f_minus_p[dc][cmp]) f_minus_p[dc][cmp] = new realnum[gv.ntot()];
+        if (!f_minus_p[dc][cmp]) f_minus_p[dc][cmp] = arena.alloc();
       }
       else if (f_minus_p[dc][cmp]) { // remove unneeded f_minus_p
-        delete[] f_minus_p[dc][cmp];
+        arena.release(f_minus_p[dc][cmp]);
         f_minus_p[dc][cmp] = 0;
       }
     }
@@ -165,14 +207,14 @@ bool fields_chunk::update_eh(field_type ft, bool skip_w_components) {
         // lazily allocate any E/H fields that are needed (H==B initially)
         if (i == 0 && f[ec][cmp] == f[dc][cmp] &&
             (s->chi1inv[ec][d_ec] || have_f_minus_p || dsigw != NO_DIRECTION)) {
-          f[ec][cmp] = new realnum[gv.ntot()];
-          memcpy(f[ec][cmp], f[dc][cmp], gv.ntot() * sizeof(realnum));
+          f[ec][cmp] = arena.alloc();
+          if (!all_metal[ft]) memcpy(f[ec][cmp], f[dc][cmp], gv.ntot() * sizeof(realnum));
           allocated_eh = true;
         }
 
         // lazily allocate W auxiliary field
         if (i == 0 && !f_w[ec][cmp] && dsigw != NO_DIRECTION) {
-          f_w[ec][cmp] = new realnum[gv.ntot()];
+          f_w[ec][cmp] = arena.alloc();
           memcpy(f_w[ec][cmp], f[ec][cmp], gv.ntot() * sizeof(realnum));
           if (needs_W_notowned(ec)) allocated_eh = true; // communication needed
         }
@@ -182,17 +224,44 @@ bool fields_chunk::update_eh(field_type ft, bool skip_w_components) {
 
         // save W field from this timestep in f_w_prev if needed by pols
         if (i == 0 && needs_W_prev(ec)) {
-          if (!f_w_prev[ec][cmp]) f_w_prev[ec][cmp] = new realnum[gv.ntot()];
+          if (!f_w_prev[ec][cmp]) f_w_prev[ec][cmp] = arena.alloc();
           memcpy(f_w_prev[ec][cmp], f_w[ec][cmp] ? f_w[ec][cmp] : f[ec][cmp],
                  sizeof(realnum) * gv.ntot());
         }
 
-        if (f[ec][cmp] != f[dc][cmp]) {
-          STEP_UPDATE_EDHB(f[ec][cmp], ec, gv, gvs_eh[ft][i].little_owned_corner0(ec),
-                           gvs_eh[ft][i].big_corner(), dmp[dc][cmp], dmp[dc_1][cmp], dmp[dc_2][cmp],
-                           s->chi1inv[ec][d_ec], dmp[dc_1][cmp] ? s->chi1inv[ec][d_1] : NULL,
-                           dmp[dc_2][cmp] ? s->chi1inv[ec][d_2] : NULL, s_ec, s_1, s_2, s->chi2[ec],
-                           s->chi3[ec], f_w[ec][cmp], dsigw, s->sig[dsigw], s->kap[dsigw]);
+        if (f[ec][cmp] != f[dc][cmp] && all_metal[ft]) {
+          /* E = chi1inv * (D - P) = 0, so zero E (and W) rather than updating it.  This is
+             done every step, since initialize_field, load_chunk etc. may have set it. */
+          if (i == 0) {
+            memset(f[ec][cmp], 0, gv.ntot() * sizeof(realnum));
+            if (f_w[ec][cmp]) memset(f_w[ec][cmp], 0, gv.ntot() * sizeof(realnum));
+          }
+        }
+        else if (f[ec][cmp] != f[dc][cmp]) {
+          const ivec is = gvs_eh[ft][i].little_owned_corner0(ec), ie = gvs_eh[ft][i].big_corner();
+          const realnum *chi1inv_1 = dmp[dc_1][cmp] ? s->chi1inv[ec][d_1] : NULL;
+          const realnum *chi1inv_2 = dmp[dc_2][cmp] ? s->chi1inv[ec][d_2] : NULL;
+
+          /* The nonlinear update (which is equivalent to the linear one where
+             chi2 == chi3 == 0) is only needed in the bounding box of the
+             nonlinear voxels; use the cheaper linear update elsewhere. */
+          ivec ns = is, ne = ie, out_s[6], out_e[6];
+          int nout = 0;
+          bool nonlinear = s->chi3[ec] != NULL;
+          if (nonlinear) {
+            ns = s->nonlinear_lo[ec];
+            ne = s->nonlinear_hi[ec];
+            nonlinear = split_box(gv.dim, is, ie, &ns, &ne, out_s, out_e, &nout);
+          }
+          for (int k = 0; k < nout; ++k)
+            STEP_UPDATE_EDHB(f[ec][cmp], ec, gv, out_s[k], out_e[k], dmp[dc][cmp], dmp[dc_1][cmp],
+                             dmp[dc_2][cmp], s->chi1inv[ec][d_ec], chi1inv_1, chi1inv_2, s_ec, s_1,
+                             s_2, NULL, NULL, f_w[ec][cmp], dsigw, s->sig[dsigw], s->kap[dsigw]);
+          if (nonlinear || !s->chi3[ec])
+            STEP_UPDATE_EDHB(f[ec][cmp], ec, gv, ns, ne, dmp[dc][cmp], dmp[dc_1][cmp],
+                             dmp[dc_2][cmp], s->chi1inv[ec][d_ec], chi1inv_1, chi1inv_2, s_ec, s_1,
+                             s_2, s->chi2[ec], s->chi3[ec], f_w[ec][cmp], dsigw, s->sig[dsigw],
+                             s->kap[dsigw]);
 
           if (gv.dim == Dcyl) {
             ivec is = gvs_eh[ft][i].little_owned_corner(ec);
@@ -15,6 +15,7 @@
 %  Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
 */
 
+#include <algorithm>
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
@@ -940,28 +941,144 @@ grid_volume volcyl(double rsize, double zsize, double a) {
     return grid_volume(Dcyl, a, (int)(rsize * a + 0.5), 0, (int)(zsize * a + 0.5));
 }
 
-double grid_volume::get_cost() const {
-  geom_box box = meep_geom::gv2box(surroundings());
+/* fragment_stats rounds pixel counts up, so a rounding error in the box corners could count an
+   extra row of pixels, or a row of a PML etc. that only touches the box.  Shrinking the box by
+   a tiny fraction of a pixel makes the counts exact for pixel-aligned boxes. */
+static meep_geom::fragment_stats fragment_stats_in(const grid_volume &gv) {
+  geom_box box = meep_geom::gv2box(gv.surroundings());
+  const double eps = 1e-6 * gv.inva;
+  double *lo[3] = {&box.low.x, &box.low.y, &box.low.z};
+  double *hi[3] = {&box.high.x, &box.high.y, &box.high.z};
+  for (int i = 0; i < 3; ++i)
+    if (*hi[i] > *lo[i]) {
+      *lo[i] += eps;
+      *hi[i] -= eps;
+    }
   meep_geom::fragment_stats fstats(box);
   fstats.compute();
-  return fstats.cost();
+  return fstats;
+}
+
+double grid_volume::get_cost() const { return fragment_stats_in(*this).cost(); }
+
+// estimated bytes of structure and fields, used with fragment_stats::memory_budget
+double grid_volume::get_memory_cost() const { return fragment_stats_in(*this).memory(); }
+
+split_cost_grid::split_cost_grid(const grid_volume &gv, size_t max_cells) : io(gv.little_corner()) {
+  size_t npixels = 1;
+  int ndims = 0;
+  for (int i = 0; i < 3; ++i)
+    n[i] = 1;
+  LOOP_OVER_DIRECTIONS(gv.dim, d) {
+    n[d % 3] = gv.num_direction(d);
+    npixels *= n[d % 3];
+    ++ndims;
+  }
+  // cubic cells, as small as max_cells allows
+  int s = npixels > max_cells ? int(ceil(pow(double(npixels) / max_cells, 1.0 / ndims))) : 1;
+  for (int i = 0; i < 3; ++i) {
+    step[i] = std::min(s, n[i]);
+    ncells[i] = (n[i] + step[i] - 1) / step[i];
+  }
+
+  // every process computes some of the cells, and the results are summed
+  const size_t num = size_t(ncells[0]) * ncells[1] * ncells[2];
+  std::vector<double> cells(2 * num, 0.0), all_cells(2 * num);
+  for (size_t c = my_rank(); c < num; c += count_processors()) {
+    const int ic[3] = {int(c / (size_t(ncells[1]) * ncells[2])), int(c / ncells[2] % ncells[1]),
+                       int(c % ncells[2])};
+    grid_volume cell = gv;
+    LOOP_OVER_DIRECTIONS(gv.dim, d) {
+      const int i = d % 3, start = ic[i] * step[i];
+      cell.set_num_direction(d, std::min(step[i], n[i] - start));
+      cell.shift_origin(d, start * 2);
+    }
+    const meep_geom::fragment_stats fstats = fragment_stats_in(cell);
+    cells[2 * c] = fstats.cost();
+    cells[2 * c + 1] = fstats.memory();
+  }
+  sum_to_all(cells.data(), all_cells.data(), 2 * num);
+
+  const size_t s1 = ncells[2] + 1, s0 = s1 * (ncells[1] + 1);
+  for (int m = 0; m < 2; ++m) {
+    std::vector<double> &p = prefix[m];
+    p.assign(s0 * (ncells[0] + 1), 0.0);
+    for (int i = 0; i < ncells[0]; ++i)
+      for (int j = 0; j < ncells[1]; ++j)
+        for (int k = 0; k < ncells[2]; ++k) {
+          const size_t c = (size_t(i) * ncells[1] + j) * ncells[2] + k;
+          const size_t q = (i + 1) * s0 + (j + 1) * s1 + (k + 1);
+          p[q] = all_cells[2 * c + m] + p[q - s0] + p[q - s1] + p[q - 1] - p[q - s0 - s1] -
+                 p[q - s0 - 1] - p[q - s1 - 1] + p[q - s0 - s1 - 1];
+        }
+  }
+}
+
+// cost of the pixels [0, pos) along each direction, interpolating linearly within cells
+double split_cost_grid::cumulative(int m, const double *pos) const {
+  int c[3];
+  double t[3];
+  for (int i = 0; i < 3; ++i) {
+    c[i] = std::min(int(pos[i]) / step[i], ncells[i] - 1);
+    const int start = c[i] * step[i];
+    t[i] = (pos[i] - start) / std::min(step[i], n[i] - start);
+  }
+  const size_t s1 = ncells[2] + 1, s0 = s1 * (ncells[1] + 1);
+  const std::vector<double> &p = prefix[m];
+  double sum = 0;
+  for (int corner = 0; corner < 8; ++corner) {
+    double w = 1;
+    size_t q = 0;
+    for (int i = 0; i < 3; ++i) {
+      const int up = (corner >> i) & 1;
+      w *= up ? t[i] : 1 - t[i];
+      q += (c[i] + up) * (i == 0 ? s0 : i == 1 ? s1 : 1);
+    }
+    if (w != 0) sum += w * p[q];
+  }
+  return sum;
+}
+
+double split_cost_grid::cost(const grid_volume &sub, bool memory) const {
+  double lo[3] = {0, 0, 0}, hi[3] = {double(n[0]), double(n[1]), double(n[2])};
+  LOOP_OVER_DIRECTIONS(sub.dim, d) {
+    lo[d % 3] = (sub.little_corner().in_direction(d) - io.in_direction(d)) / 2;
+    hi[d % 3] = lo[d % 3] + sub.num_direction(d);
+  }
+  double sum = 0;
+  for (int corner = 0; corner < 8; ++corner) {
+    double pos[3];
+    int sign = 1;
+    for (int i = 0; i < 3; ++i) {
+      const bool up = (corner >> i) & 1;
+      pos[i] = up ? hi[i] : lo[i];
+      if (!up) sign = -sign;
+    }
+    sum += sign * cumulative(memory, pos);
+  }
+  return sum;
 }
 
-// return complex(left cost, right cost).  Should really be a tuple, but we don't want to require
-// C++11? yet?
+// return complex(left cost, right cost), or the memory costs if memory is true.  Should really
+// be a tuple, but we don't want to require C++11? yet?
 std::complex<double> grid_volume::get_split_costs(direction d, int split_point,
-                                                  bool fragment_cost) const {
+                                                  bool fragment_cost, bool memory,
+                                                  const split_cost_grid *costs) const {
   double left_cost = 0, right_cost = 0;
   if (split_point > 0) {
     grid_volume v_left = *this;
     v_left.set_num_direction(d, split_point);
-    left_cost = fragment_cost ? v_left.get_cost() : v_left.nowned_min();
+    left_cost = !fragment_cost ? v_left.nowned_min()
+                : costs        ? costs->cost(v_left, memory)
+                               : (memory ? v_left.get_memory_cost() : v_left.get_cost());
   }
   if (split_point < num_direction(d)) {
     grid_volume v_right = *this;
     v_right.set_num_direction(d, num_direction(d) - split_point);
     v_right.shift_origin(d, split_point * 2);
-    right_cost = fragment_cost ? v_right.get_cost() : v_right.nowned_min();
+    right_cost = !fragment_cost ? v_right.nowned_min()
+                 : costs        ? costs->cost(v_right, memory)
+                                : (memory ? v_right.get_memory_cost() : v_right.get_cost());
   }
   return std::complex<double>(left_cost, right_cost);
 }
@@ -993,8 +1110,8 @@ void grid_volume::tile_split(int &best_split_point, direction &best_split_direct
 }
 
 void grid_volume::find_best_split(int desired_chunks, bool fragment_cost, int &best_split_point,
-                                  direction &best_split_direction,
-                                  double &left_effort_fraction) const {
+                                  direction &best_split_direction, double &left_effort_fraction,
+                                  const split_cost_grid *costs) const {
   if (size_t(desired_chunks) > nowned_min()) {
     meep::abort("Cannot split %zd grid points into %d parts\n", nowned_min(), desired_chunks);
   }
@@ -1013,36 +1130,62 @@ void grid_volume::find_best_split(int desired_chunks, bool fragment_cost, int &b
     }
   }
 
+  // with a memory budget, we also try the split that balances memory, and
+  // penalize splits leaving chunks that would exceed the budget
+  const double budget = fragment_cost ? meep_geom::fragment_stats::memory_budget : 0;
+  const int num_left = desired_chunks / 2, num_right = desired_chunks - num_left;
+
   double best_split_measure = 1e20;
   LOOP_OVER_DIRECTIONS(dim, d) {
-    int first = 0, last = num_direction(d);
-    while (first < last) { // bisection search for balanced splitting
-      int mid = (first + last) / 2;
-      double mid_diff = cost_diff(desired_chunks, get_split_costs(d, mid, fragment_cost));
-      if (mid_diff > 0) {
-        if (first == mid) break;
-        first = mid;
+    int candidates[2], num_candidates = 0;
+    for (int memory = 0; memory <= (budget > 0); ++memory) {
+      int first = 0, last = num_direction(d);
+      while (first < last) { // bisection search for balanced splitting
+        int mid = (first + last) / 2;
+        double mid_diff =
+            cost_diff(desired_chunks, get_split_costs(d, mid, fragment_cost, memory, costs));
+        if (mid_diff > 0) {
+          if (first == mid) break;
+          first = mid;
+        }
+        else if (mid_diff < 0)
+          last = mid;
+        else
+          break;
       }
-      else if (mid_diff < 0)
-        last = mid;
-      else
-        break;
+      int split_point = (first + last) / 2;
+      if (num_candidates == 0 || candidates[0] != split_point)
+        candidates[num_candidates++] = split_point;
     }
-    int split_point = (first + last) / 2;
-    std::complex<double> costs = get_split_costs(d, split_point, fragment_cost);
-    double left_cost = real(costs), right_cost = imag(costs);
-    double total_cost = left_cost + right_cost;
-    double split_measure = std::max(left_cost / (desired_chunks / 2),
-                                    right_cost / (desired_chunks - (desired_chunks / 2)));
-    // Give a 30% preference to the longest axis, as a heuristic to prefer lower communication costs
-    // when the split_measure is somewhat close.   TODO: use a data-driven communication cost
-    // function.
-    if (d == longest_axis) split_measure *= 0.7;
-    if (split_measure < best_split_measure) {
-      best_split_measure = split_measure;
-      best_split_point = split_point;
-      best_split_direction = d;
-      left_effort_fraction = left_cost / total_cost;
+
+    for (int i = 0; i < num_candidates; ++i) {
+      int split_point = candidates[i];
+      std::complex<double> split_costs =
+          get_split_costs(d, split_point, fragment_cost, false, costs);
+      double left_cost = real(split_costs), right_cost = imag(split_costs);
+      double total_cost = left_cost + right_cost;
+      double split_measure = std::max(left_cost / num_left, right_cost / num_right);
+      double effort_fraction = left_cost / total_cost;
+      if (budget > 0) {
+        // measure both relative to the ideal, and let whichever is worse decide
+        std::complex<double> mem = get_split_costs(d, split_point, fragment_cost, true, costs);
+        double mem_measure = std::max(real(mem) / num_left, imag(mem) / num_right) / budget;
+        double time_measure = split_measure * desired_chunks / total_cost;
+        if (mem_measure > time_measure) {
+          split_measure = mem_measure * total_cost / desired_chunks;
+          effort_fraction = real(mem) / (real(mem) + imag(mem));
+        }
+      }
+      // Give a 30% preference to the longest axis, as a heuristic to prefer lower communication
+      // costs when the split_measure is somewhat close.   TODO: use a data-driven communication
+      // cost function.
+      if (d == longest_axis) split_measure *= 0.7;
+      if (split_measure < best_split_measure) {
+        best_split_measure = split_measure;
+        best_split_point = split_point;
+        best_split_direction = d;
+        left_effort_fraction = effort_fraction;
+      }
     }
   }
 }
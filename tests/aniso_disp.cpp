@@ -44,6 +44,7 @@ w2 = fsolve(@(w)detMwk(w,k),w1-0.1);
 
 */
 
+#include <algorithm>
 #include <vector>
 #include <meep.hpp>
 using namespace meep;
@@ -93,6 +94,119 @@ public:
   }
 };
 
+/* step f and f1 until time T, checking that they have the same fields at a few points,
+   relative to the largest field seen so far, and the same field energy; "what" describes
+   the difference between f and f1 */
+bool same_fields(fields &f, fields &f1, double T, double tol, const char *what) {
+  const vec pts[3] = {vec(0.3, 0.35), vec(2.01, 1.0), vec(3.45, 1.62)};
+  const component cs[6] = {Ex, Ey, Ez, Hx, Hy, Hz};
+  double peak = 0;
+  while (f.time() < T) {
+    f.step();
+    f1.step();
+    for (const vec &p : pts)
+      for (component c : cs) {
+        complex<double> v = f.get_field(c, p), v1 = f1.get_field(c, p);
+        peak = std::max(peak, abs(v1));
+        if (abs(v - v1) > tol * peak) {
+          master_printf("%s at (%g, %g) is %g%+gi instead of %g%+gi %s, time %g\n",
+                        component_name(c), p.x(), p.y(), real(v), imag(v), real(v1), imag(v1),
+                        what, f.time());
+          return false;
+        }
+      }
+  }
+  const double e = f.field_energy(), e1 = f1.field_energy();
+  if (fabs(e - e1) > tol * fabs(e1)) {
+    master_printf("field energy is %g instead of %g %s\n", e, e1, what);
+    return false;
+  }
+  return true;
+}
+
+/* check that an anisotropic Lorentzian medium split into several chunks
+   (with PML chunks, which have separate W arrays, next to non-PML chunks,
+   which do not) gives the same fields as a single chunk.  The off-diagonal
+   averages of W at a chunk boundary inside the medium already differed from
+   one chunk by a few 1e-5 before E/H were sent in the W exchange, so that is
+   the tolerance rather than round-off. */
+bool check_aniso_chunks(int splitting) {
+  const double tol = 1e-4;
+  grid_volume gv = vol2d(4.0, 2.0, 10.0);
+  anisodisp_material anisodispmat;
+  structure s1(gv, anisodispmat, pml(0.5, X));
+  structure s(gv, anisodispmat, pml(0.5, X), identity(), splitting);
+  s1.add_susceptibility(anisodispmat, E_stuff, lorentzian_susceptibility(1.1, 1e-5));
+  s.add_susceptibility(anisodispmat, E_stuff, lorentzian_susceptibility(1.1, 1e-5));
+
+  fields f1(&s1), f(&s);
+  f1.add_point_source(Ez, 0.5, 1.0, 0.0, 4.0, vec(1.3, 0.7));
+  f.add_point_source(Ez, 0.5, 1.0, 0.0, 4.0, vec(1.3, 0.7));
+  f1.add_point_source(Hz, 0.4, 1.0, 0.0, 4.0, vec(2.6, 1.1));
+  f.add_point_source(Hz, 0.4, 1.0, 0.0, 4.0, vec(2.6, 1.1));
+
+  char what[64];
+  snprintf(what, sizeof(what), "with %d chunks", splitting);
+  return same_fields(f, f1, 15.0, tol, what);
+}
+
+double one(const vec &) { return 1.0; }
+double gyro_sigma(const vec &p) { return (p.x() > 1.1 && p.x() < 2.9) ? 0.8 : 0.0; }
+
+/* check that an unbiased gyrotropic Lorentzian or Drude medium gives the same
+   fields as the corresponding Lorentzian medium.  With only an Ez source
+   (TM), the off-diagonal driving fields of Pz do not exist, and with only an
+   Hz source (TE) the driving fields of Px and Py each lack one component, so
+   this runs the kernel variants for missing off-diagonal fields.  A bias
+   along z does not couple Pz to Px and Py, so the TM check also holds for
+   a z bias. */
+bool check_gyrotropic_isotropic(gyrotropy_model model, const vec &bias, component c) {
+  const double tol = sizeof(realnum) == sizeof(float) ? 1e-4 : 1e-8;
+  const bool drude = model == GYROTROPIC_DRUDE;
+  grid_volume gv = vol2d(4.0, 2.0, 10.0);
+  simple_material_function sigma(gyro_sigma);
+  structure s1(gv, one, pml(0.5, X), identity(), 3);
+  structure s(gv, one, pml(0.5, X), identity(), 3);
+  s1.add_susceptibility(sigma, E_stuff, lorentzian_susceptibility(0.9, 0.05, drude));
+  s.add_susceptibility(sigma, E_stuff, gyrotropic_susceptibility(bias, 0.9, 0.05, 0.0, model));
+
+  fields f1(&s1), f(&s);
+  f1.add_point_source(c, 0.6, 1.0, 0.0, 4.0, vec(1.7, 0.9));
+  f.add_point_source(c, 0.6, 1.0, 0.0, 4.0, vec(1.7, 0.9));
+
+  char what[128];
+  snprintf(what, sizeof(what), "for a %s gyrotropic medium with bias (%g, %g, %g) and a %s source",
+           drude ? "Drude" : "Lorentzian", bias.x(), bias.y(), bias.z(), component_name(c));
+  return same_fields(f, f1, 15.0, tol, what);
+}
+
+/* check that a biased gyrotropic medium, with all field components present,
+   gives the same fields in several chunks (some in PML) as in one chunk; as
+   for check_aniso_chunks, a chunk boundary inside the medium changes the
+   fields by more than round-off (here a few 1e-3) */
+bool check_gyrotropic_chunks(gyrotropy_model model, int splitting) {
+  const double tol = 1e-2;
+  const vec bias(0.6, -0.3, 0.9);
+  const double omega = model == GYROTROPIC_SATURATED ? 0.7 : 0.9;
+  const double alpha = model == GYROTROPIC_SATURATED ? 0.05 : 0.0;
+  grid_volume gv = vol2d(4.0, 2.0, 10.0);
+  simple_material_function sigma(gyro_sigma);
+  structure s1(gv, one, pml(0.5, X));
+  structure s(gv, one, pml(0.5, X), identity(), splitting);
+  s1.add_susceptibility(sigma, E_stuff, gyrotropic_susceptibility(bias, omega, 0.05, alpha, model));
+  s.add_susceptibility(sigma, E_stuff, gyrotropic_susceptibility(bias, omega, 0.05, alpha, model));
+
+  fields f1(&s1), f(&s);
+  f1.add_point_source(Ez, 0.6, 1.0, 0.0, 4.0, vec(1.7, 0.9));
+  f.add_point_source(Ez, 0.6, 1.0, 0.0, 4.0, vec(1.7, 0.9));
+  f1.add_point_source(Hz, 0.5, 1.0, 0.0, 4.0, vec(2.4, 1.3));
+  f.add_point_source(Hz, 0.5, 1.0, 0.0, 4.0, vec(2.4, 1.3));
+
+  char what[128];
+  snprintf(what, sizeof(what), "for gyrotropy model %d with %d chunks", int(model), splitting);
+  return same_fields(f, f1, 15.0, tol, what);
+}
+
 int main(int argc, char **argv) {
   initialize mpi(argc, argv);
   bool ok = true;
@@ -144,5 +258,19 @@ int main(int argc, char **argv) {
          fabs(freqs_im[i0] + 4.8297e-07) / 4.8297e-7 < tol;
   }
   end_divide_parallel();
+
+  for (int splitting = 2; splitting <= 6; splitting += 2)
+    if (!check_aniso_chunks(splitting)) ok = false;
+
+  const gyrotropy_model models[3] = {GYROTROPIC_LORENTZIAN, GYROTROPIC_DRUDE,
+                                     GYROTROPIC_SATURATED};
+  for (int m = 0; m < 2; ++m) {
+    if (!check_gyrotropic_isotropic(models[m], vec(0, 0, 0), Ez)) ok = false;
+    if (!check_gyrotropic_isotropic(models[m], vec(0, 0, 0), Hz)) ok = false;
+    if (!check_gyrotropic_isotropic(models[m], vec(0, 0, 1.3), Ez)) ok = false;
+  }
+  for (gyrotropy_model model : models)
+    for (int splitting = 2; splitting <= 4; splitting += 2)
+      if (!check_gyrotropic_chunks(model, splitting)) ok = false;
   return !and_to_all(ok);
 }
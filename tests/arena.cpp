@@ -0,0 +1,152 @@
+/* Copyright (C) 2005-2024 Massachusetts Institute of Technology
+%
+%  This program is free software; you can redistribute it and/or modify
+%  it under the terms of the GNU General Public License as published by
+%  the Free Software Foundation; either version 2, or (at your option)
+%  any later version.
+%
+%  This program is distributed in the hope that it will be useful,
+%  but WITHOUT ANY WARRANTY; without even the implied warranty of
+%  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+%  GNU General Public License for more details.
+%
+%  You should have received a copy of the GNU General Public License
+%  along with this program; if not, write to the Free Software Foundation,
+%  Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+
+#include <meep.hpp>
+using namespace meep;
+
+double one(const vec &) { return 1.0; }
+
+/* check that chunk_arena hands out distinct, aligned, zeroed arrays, reuses
+   released ones, and unmaps a slab once all of its arrays are released */
+int check_arena(size_t n) {
+  chunk_arena arena(n);
+  if (arena.num_slabs() != 0 || arena.bytes_reserved() != 0) return 0;
+
+  std::vector<realnum *> arrays;
+  for (int i = 0; i < 40; ++i) { // enough for several slabs
+    realnum *p = arena.alloc();
+    if ((uintptr_t)p % 64 != 0) {
+      master_printf("array %d is not cache-line aligned\n", i);
+      return 0;
+    }
+    for (size_t j = 0; j < n; ++j)
+      if (p[j] != 0) {
+        master_printf("array %d is not zeroed\n", i);
+        return 0;
+      }
+    for (size_t j = 0; j < n; ++j) // overlapping arrays would clobber each other
+      p[j] = i + 1;
+    arrays.push_back(p);
+  }
+  for (int i = 0; i < 40; ++i)
+    for (size_t j = 0; j < n; ++j)
+      if (arrays[i][j] != i + 1) {
+        master_printf("array %d overlaps another array\n", i);
+        return 0;
+      }
+  const size_t nslabs = arena.num_slabs();
+  const size_t reserved = arena.bytes_reserved();
+  if (nslabs < 3) {
+    master_printf("only %zu slabs for 40 arrays\n", nslabs);
+    return 0;
+  }
+
+  // a released array is reused, and zeroed again
+  realnum *last = arrays.back();
+  const size_t resident = arena.bytes_resident();
+  arena.release(last);
+  arena.release(NULL);
+  if (arena.blocks_in_use() != 39 || arena.bytes_resident() > resident) {
+    master_printf("%zu arrays (%zu bytes) still in use after releasing one\n",
+                  arena.blocks_in_use(), arena.bytes_resident());
+    return 0;
+  }
+  if (arena.num_slabs() != nslabs || arena.alloc() != last || last[n - 1] != 0 ||
+      arena.bytes_resident() != resident) {
+    master_printf("released array was not reused\n");
+    return 0;
+  }
+
+  // releasing everything but the first array returns all later slabs to the OS
+  for (size_t i = arrays.size(); i > 1; --i)
+    arena.release(arrays[i - 1]);
+  if (arena.num_slabs() != 1 || arena.bytes_reserved() >= reserved) {
+    master_printf("%zu slabs (%zu bytes) still reserved after releasing arrays\n",
+                  arena.num_slabs(), arena.bytes_reserved());
+    return 0;
+  }
+
+  // and the arena grows again as needed
+  arrays.resize(1);
+  for (int i = 1; i < 40; ++i)
+    arrays.push_back(arena.alloc());
+  std::sort(arrays.begin(), arrays.end());
+  if (std::unique(arrays.begin(), arrays.end()) != arrays.end()) {
+    master_printf("arena handed out the same array twice\n");
+    return 0;
+  }
+  for (realnum *p : arrays)
+    arena.release(p);
+  return arena.num_slabs() == 0 && arena.bytes_reserved() == 0 && arena.bytes_resident() == 0;
+}
+
+/* check that fields timestepping (whose arrays come from the arena) is
+   unaffected by dropping and re-allocating arrays, here the imaginary parts */
+int check_fields_realloc() {
+  grid_volume gv = vol2d(3.0, 2.0, 10.0);
+  structure s(gv, one, pml(0.5), meep::identity(), 4);
+  fields f1(&s), f2(&s);
+  f1.use_real_fields();
+  f1.add_point_source(Ez, 0.8, 0.6, 0.0, 4.0, vec(1.3, 0.9));
+  f2.add_point_source(Ez, 0.8, 0.6, 0.0, 4.0, vec(1.3, 0.9));
+  f2.use_real_fields();
+  while (f1.time() < 15.0) {
+    f1.step();
+    f2.step();
+  }
+  // the per-category memory of the field arrays adds up to what the arenas hold
+  std::vector<size_t> bytes = f1.memory_usage();
+  size_t counted = 0, resident = 0;
+  for (size_t i = 0; i < bytes.size(); i += NUM_MEMORY_KINDS)
+    counted += bytes[i + Fields_memory] + bytes[i + PML_memory] + bytes[i + Backup_memory] +
+               bytes[i + Dispersion_memory] + bytes[i + Arena_memory];
+  for (int i = 0; i < f1.num_chunks; ++i)
+    if (f1.chunks[i]->is_mine()) resident += f1.chunks[i]->arena.bytes_resident();
+  if (counted != sum_to_all(resident)) {
+    master_printf("memory_usage counts %zu bytes of field arrays, not %zu\n", counted,
+                  sum_to_all(resident));
+    return 0;
+  }
+
+  const vec pt(2.1, 1.2);
+  double e1 = real(f1.get_field(Ez, pt)), e2 = real(f2.get_field(Ez, pt));
+  if (e1 != e2 || e1 == 0) {
+    master_printf("Ez is %g instead of %g after re-allocating arrays\n", e2, e1);
+    return 0;
+  }
+  return 1;
+}
+
+int main(int argc, char **argv) {
+  initialize mpi(argc, argv);
+  verbosity = 0;
+  master_printf("Testing chunk_arena...\n");
+
+  if (!check_arena(1)) meep::abort("error in chunk_arena with 1-element arrays\n");
+  if (!check_arena(1000)) meep::abort("error in chunk_arena\n");
+  if (!check_arena(100000)) meep::abort("error in chunk_arena with multi-page arrays\n");
+  if (!check_fields_realloc()) meep::abort("error in fields after re-allocating arrays\n");
+
+  master_printf("Passed all chunk_arena tests!\n");
+  return 0;
+}
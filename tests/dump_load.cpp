@@ -197,6 +197,50 @@ int test_periodic(double eps(const vec &), int splitting, const char *tmpdir) {
   return 1;
 }
 
+int test_repartition(double eps(const vec &), int splitting, int new_splitting, bool use_pml,
+                     const char *tmpdir) {
+  double a = 10.0;
+  double ttot = 17.0;
+
+  grid_volume gv = vol3d(1.5, 0.5, 1.0, a);
+  // with PML along x, the old and new chunk boundaries fall on either side of the PML edges
+  const boundary_region br = use_pml ? pml(0.3, X) : no_pml();
+  structure s(gv, eps, br, identity(), splitting);
+
+  std::string filename_prefix = std::string(tmpdir) + "/test_repartition_" +
+                                std::to_string(splitting) + "_" + std::to_string(new_splitting) +
+                                (use_pml ? "_pml" : "");
+
+  master_printf("Repartition test from %d to %d chunks%s...\n", splitting, new_splitting,
+                use_pml ? " with PML" : "");
+  fields f(&s);
+  f.use_bloch(vec(0.1, 0.7, 0.3));
+  f.add_point_source(Ez, 0.7, 2.5, 0.0, 4.0, vec(0.3, 0.25, 0.5), 1.0);
+
+  while (f.time() < ttot)
+    f.step();
+
+  std::string fields_filename = fields_dump(&f, filename_prefix, "original");
+
+  structure s_load(gv, eps, br, identity(), new_splitting);
+  fields f_load(&s_load);
+  f_load.use_bloch(vec(0.1, 0.7, 0.3));
+  f_load.add_point_source(Ez, 0.7, 2.5, 0.0, 4.0, vec(0.3, 0.25, 0.5), 1.0);
+  fields_load(&f_load, fields_filename);
+
+  for (int i = 0; i < 2; i++) { // compare after loading and after stepping on
+    if (!compare_point(f, f_load, vec(0.5, 0.01, 0.5))) return 0;
+    if (!compare_point(f, f_load, vec(0.46, 0.33, 0.2))) return 0;
+    if (!compare_point(f, f_load, vec(1.0, 0.25, 0.301))) return 0;
+    if (!compare(f.field_energy(), f_load.field_energy(), "   total energy")) return 0;
+    while (f.time() < ttot + 5) {
+      f.step();
+      f_load.step();
+    }
+  }
+  return 1;
+}
+
 int main(int argc, char **argv) {
   initialize mpi(argc, argv);
   verbosity = 0;
@@ -210,6 +254,13 @@ int main(int argc, char **argv) {
   for (int s = 2; s < 8; s++)
     if (!test_metal(one, s, temp_dir.get())) abort("error in test_metal vacuum\n");
 
+  for (int use_pml = 0; use_pml < 2; use_pml++) {
+    if (!test_repartition(targets, 2, 5, use_pml, temp_dir.get()))
+      abort("error in test_repartition 2 -> 5\n");
+    if (!test_repartition(targets, 6, 3, use_pml, temp_dir.get()))
+      abort("error in test_repartition 6 -> 3\n");
+  }
+
   delete_directory(temp_dir.get());
   return 0;
 }
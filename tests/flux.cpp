@@ -19,6 +19,7 @@
 #include <stdlib.h>
 
 #include <meep.hpp>
+#include "meep_internals.hpp"
 using namespace meep;
 
 double one(const vec &) { return 1.0; }
@@ -225,6 +226,85 @@ int flux_2d(const double xmax, const double ymax, double eps(const vec &)) {
   return 1;
 }
 
+/* run fields with and without an add_sync_volume box side by side, checking
+   that synchronizing from the previous-step copy of H kept in the box gives
+   nearly the same fluxes and energies as the half-step synchronization, that
+   outside the box the fields are synchronized exactly, and that the
+   timestepping is not perturbed; returns in *discrepancy the largest
+   difference of the flux and energy relative to their largest values */
+int flux_2d_sync_run(const double xmax, const double ymax, double eps(const vec &), double a,
+                     double *discrepancy) {
+  master_printf("\nFlux_2d_sync(%g,%g) test at resolution %g...\n", xmax, ymax, a);
+
+  grid_volume gv = voltwo(xmax, ymax, a);
+  // enough chunks that some, e.g. those containing outside, do not overlap the box
+  structure s(gv, eps, pml(0.5), identity(), 16);
+
+  fields f(&s), fs(&s);
+  vec lb(vec(xmax / 3, ymax / 3)), rb(vec(2 * xmax / 3, ymax / 3));
+  vec lt(vec(xmax / 3, 2 * ymax / 3)), rt(vec(2 * xmax / 3, 2 * ymax / 3));
+  volume box(lb, rt), left(lb, lt), right(rb, rt), bottom(lb, rb), top(lt, rt);
+  volume outside(vec(xmax / 6, ymax / 6), vec(xmax / 6, 5 * ymax / 6));
+  fs.add_sync_volume(box);
+
+  fields *ff[2] = {&f, &fs};
+  for (int i = 0; i < 2; ++i) {
+    ff[i]->use_real_fields();
+    ff[i]->add_point_source(Ez, 0.25, 3.5, 0., 8., vec(xmax / 6 + 0.1, ymax / 6 + 0.3), 1.);
+    ff[i]->add_point_source(Hz, 0.25, 3.5, 0., 8., vec(xmax / 6 + 0.2, ymax / 6 + 0.1), 1.);
+  }
+
+  f.step();
+  fs.step();
+  // synchronizing may allocate H, so do it in both runs to keep them identical
+  f.field_energy_in_box(box);
+  double init_energy = fs.field_energy_in_box(box);
+  long double flux[2] = {0, 0};
+  double maxdiff[2] = {0, 0}, maxval[2] = {0, 0}; // flux through left, energy in box
+  while (f.time() < 130) {
+    f.step();
+    fs.step();
+    for (int i = 0; i < 2; ++i)
+      flux[i] += f.dt * (ff[i]->flux_in_box(X, left) - ff[i]->flux_in_box(X, right) +
+                         ff[i]->flux_in_box(Y, bottom) - ff[i]->flux_in_box(Y, top));
+    const double fl = f.flux_in_box(X, left);
+    maxdiff[0] = max(maxdiff[0], fabs(fs.flux_in_box(X, left) - fl));
+    maxval[0] = max(maxval[0], fabs(fl));
+    if (f.t % 10 == 0) {
+      const double en = f.field_energy_in_box(box);
+      maxdiff[1] = max(maxdiff[1], fabs(fs.field_energy_in_box(box) - en));
+      maxval[1] = max(maxval[1], en);
+      if (fs.flux_in_box(X, outside) != f.flux_in_box(X, outside)) {
+        master_printf("Flux outside the sync volume differs\n");
+        return 0;
+      }
+    }
+  }
+  *discrepancy = max(maxdiff[0] / maxval[0], maxdiff[1] / maxval[1]);
+  double del_energy = fs.field_energy_in_box(box) - init_energy;
+  master_printf("  delta E: %g\n  net flux: %g vs. %g\n  discrepancy: %g\n", del_energy,
+                double(flux[1]), double(flux[0]), *discrepancy);
+  if (!compare(del_energy, flux[1], 0.09, 0, "Flux")) return 0;
+
+  // the synchronized fields must have been restored exactly before each step
+  const vec p(xmax / 2 + 0.1, ymax / 2 - 0.2);
+  if (f.get_field(Hz, p) != fs.get_field(Hz, p) || f.get_field(Ez, p) != fs.get_field(Ez, p)) {
+    master_printf("Fields differ after synchronized stepping\n");
+    return 0;
+  }
+  return 1;
+}
+
+/* the extrapolation from the previous step and the half-step average are
+   both second order in dt, so they must agree to O(dt^2) */
+int flux_2d_sync(const double xmax, const double ymax, double eps(const vec &)) {
+  double d8, d16;
+  if (!flux_2d_sync_run(xmax, ymax, eps, 8.0, &d8)) return 0;
+  if (!flux_2d_sync_run(xmax, ymax, eps, 16.0, &d16)) return 0;
+  master_printf("  discrepancy ratio: %g\n", d8 / d16);
+  return d8 < 6e-3 && d8 / d16 > 3.5;
+}
+
 int flux_cyl(const double rmax, const double zmax, double eps(const vec &), int m) {
   const double a = 8.0;
 
@@ -293,6 +373,154 @@ int flux_cyl(const double rmax, const double zmax, double eps(const vec &), int
   return 1;
 }
 
+/* DFT flux spectra accumulated with compensated summation should agree with
+   the plain sums, to roughly single precision in --enable-single builds.  The
+   compensated summation itself is checked in single precision whatever the
+   build: a DFT of the field at the flux plane accumulated in float must get
+   much closer to a long double reference with kahan_add than without. */
+int flux_1d_compensated(const double zmax, double eps(const vec &)) {
+  const double a = 10.0;
+  const int nfreq = 10;
+  const double fmin = 0.15, fmax = 0.35;
+
+  grid_volume gv = volone(zmax, a);
+  structure s(gv, eps, pml(zmax / 6));
+
+  fields f(&s);
+  f.add_point_source(Ex, 0.25, 3.5, 0.0, 8.0, vec(zmax / 6 + 0.3), 1.0);
+  const vec pt(zmax * 2.0 / 3.0);
+  volume where(pt, pt);
+  dft_flux plain = f.add_dft_flux_plane(where, fmin, fmax, nfreq);
+  f.use_compensated_dft();
+  dft_flux comp = f.add_dft_flux_plane(where, fmin, fmax, nfreq);
+
+  std::vector<std::complex<long double> > ref(nfreq);
+  std::vector<std::complex<float> > sum(nfreq), ksum(nfreq), kcomp(nfreq);
+  const double scale = f.dt / sqrt(2 * pi);
+  while (f.time() < f.last_source_time() + 100) {
+    f.step();
+    const double e = real(f.get_field(Ex, pt));
+    for (int i = 0; i < nfreq; ++i) {
+      const double omega = 2 * pi * (fmin + i * (fmax - fmin) / (nfreq - 1));
+      const std::complex<double> x = std::polar(scale * e, omega * f.time());
+      ref[i] += std::complex<long double>(x);
+      sum[i] += std::complex<float>(x);
+      kahan_add(ksum[i], kcomp[i], std::complex<float>(x));
+    }
+  }
+
+  double err = 0, kerr = 0, norm = 0;
+  for (int i = 0; i < nfreq; ++i) {
+    const std::complex<double> r(ref[i]);
+    err = std::max(err, abs(std::complex<double>(sum[i]) - r));
+    kerr = std::max(kerr, abs(std::complex<double>(ksum[i]) - r));
+    norm = std::max(norm, abs(r));
+  }
+  master_printf("Float DFT relative errors: %g plain, %g compensated\n", err / norm, kerr / norm);
+  if (!(norm > 0) || kerr > 0.1 * err) return 0;
+
+  double *fl1 = plain.flux();
+  double *fl2 = comp.flux();
+  const double tol = sizeof(realnum) == sizeof(float) ? 1e-3 : 1e-10;
+  int ok = 1;
+  for (int i = 0; i < nfreq; ++i)
+    ok = ok && compare(fl1[i], fl2[i], tol, 0, "Compensated flux spectrum");
+  delete[] fl2;
+  delete[] fl1;
+  return ok;
+}
+
+/* reference LDOS accumulation that walks the chunk sources on every step,
+   as dft_ldos::update did before the source points were cached */
+struct ldos_reference {
+  std::vector<double> freq;
+  std::vector<std::complex<double> > F, J;
+  double Jsum;
+  ldos_reference(const std::vector<double> &freq_)
+      : freq(freq_), F(freq_.size(), 0.0), J(freq_.size(), 0.0), Jsum(1.0) {}
+
+  void update(fields &f) {
+    std::complex<double> EJ = 0.0, HJ = 0.0;
+    Jsum = 0.0;
+    for (int ic = 0; ic < f.num_chunks; ic++)
+      if (f.chunks[ic]->is_mine())
+        for (int magnetic = 0; magnetic < 2; ++magnetic)
+          for (const src_vol &sv : f.chunks[ic]->get_sources(magnetic ? B_stuff : D_stuff)) {
+            component c = direction_component(magnetic ? Hx : Ex, component_direction(sv.c));
+            realnum *fr = f.chunks[ic]->f[c][0];
+            realnum *fi = f.chunks[ic]->f[c][1];
+            if (!fr) continue;
+            for (size_t j = 0; j < sv.num_points(); j++) {
+              const ptrdiff_t idx = sv.index_at(j);
+              const std::complex<double> &A = sv.amplitude_at(j);
+              (magnetic ? HJ : EJ) += std::complex<double>(fr[idx], fi ? fi[idx] : 0) * conj(A);
+              Jsum += abs(A);
+            }
+          }
+    Jsum *= sqrt(f.gv.dV(f.gv.icenter(), 1).computational_volume());
+    const double scale = f.dt / sqrt(2 * pi);
+    for (size_t i = 0; i < freq.size(); ++i) {
+      std::complex<double> Ephase = std::polar(1.0, 2 * pi * freq[i] * f.time()) * scale;
+      std::complex<double> Hphase =
+          std::polar(1.0, 2 * pi * freq[i] * (f.time() - f.dt / 2)) * scale;
+      F[i] += Ephase * EJ + Hphase * HJ;
+      if (f.sources)
+        J[i] += Ephase * (f.is_real ? real(f.sources->current()) : f.sources->current());
+    }
+  }
+
+  double ldos(size_t i) const {
+    double Jsum_all = sum_to_all(Jsum);
+    double scale = 4.0 / pi * -0.5 / (Jsum_all * Jsum_all);
+    return sum_to_all(scale * real(F[i] * conj(J[i])) / norm(J[i]));
+  }
+};
+
+/* check that dft_ldos, which caches the source points between steps, gives
+   the same LDOS as walking the sources on every step, including after a
+   source is added part-way through the run */
+int ldos_2d(const double xmax, const double ymax, double eps(const vec &), bool real_fields) {
+  const double a = 8.0;
+
+  master_printf("\nLDOS_2d(%g,%g) test with %s fields...\n", xmax, ymax,
+                real_fields ? "real" : "complex");
+
+  grid_volume gv = voltwo(xmax, ymax, a);
+  structure s(gv, eps, pml(0.5), meep::identity(), 3);
+
+  fields f(&s);
+  if (real_fields) f.use_real_fields();
+  gaussian_src_time src(0.25, 0.1);
+  f.add_point_source(Ez, src, vec(xmax / 2 + 0.1, ymax / 2 + 0.3));
+  f.add_volume_source(Hz, src, volume(vec(xmax / 4, ymax / 4), vec(3 * xmax / 4, ymax / 4)),
+                      std::complex<double>(0.5, 0.25));
+
+  const std::vector<double> freq = {0.2, 0.23, 0.25, 0.27, 0.3};
+  dft_ldos ldos(freq);
+  ldos_reference ref(freq);
+
+  while (f.time() < 20) {
+    f.step();
+    ldos.update(f);
+    ref.update(f);
+  }
+  f.add_point_source(Ez, src, vec(xmax / 3, 2 * ymax / 3), 2.0);
+  while (f.time() < f.last_source_time() + 20) {
+    f.step();
+    ldos.update(f);
+    ref.update(f);
+  }
+
+  double *l = ldos.ldos();
+  int ok = 1;
+  for (size_t i = 0; i < freq.size(); ++i) {
+    master_printf("  ldos(%g) = %g vs. %g\n", freq[i], l[i], ref.ldos(i));
+    ok = ok && compare(l[i], ref.ldos(i), 1e-10, 0, "LDOS");
+  }
+  delete[] l;
+  return ok;
+}
+
 void attempt(const char *name, int allright) {
   if (allright)
     master_printf("Passed %s\n", name);
@@ -317,9 +545,13 @@ int main(int argc, char **argv) {
   attempt("Flux 1D 10", flux_1d(100.0, bump));
   width = 300.0;
   attempt("Flux 1D 300", flux_1d(100, bump));
+  attempt("Flux 1D compensated DFT", flux_1d_compensated(100, bump));
 
   width = 5.0;
   attempt("Flux 2D 5", flux_2d(10.0, 10.0, bump2));
+  attempt("LDOS 2D real fields", ldos_2d(10.0, 10.0, bump2, true));
+  attempt("LDOS 2D complex fields", ldos_2d(10.0, 10.0, bump2, false));
+  attempt("Flux 2D 5 synchronized from previous step", flux_2d_sync(10.0, 10.0, bump2));
 
   width = 5.0;
   attempt("Flux cylindrical 5", flux_cyl(20.0, 10.0, bump2, 1));
@@ -22,8 +22,10 @@
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <algorithm>
 
 #include <meep.hpp>
+#include "meepgeom.hpp"
 using namespace meep;
 using std::complex;
 
@@ -242,6 +244,212 @@ void check_splitsym(const grid_volume &gv, int splitting, const symmetry &S, con
   }
 }
 
+static void compare_plan(double plan, double ref, const char *what) {
+  if (fabs(plan - ref) > 1e-10 * fabs(ref) + 1e-15)
+    meep::abort("FAILED: reduction_plan %s = %0.16g instead of %0.16g\n", what, plan, ref);
+}
+
+// check the fused reduction_plan against the corresponding one-at-a-time integrals
+void check_reduction_plan(const grid_volume &gv, int splitting, const symmetry &S,
+                          const char *Sname) {
+  const int num_random_trials = 10;
+  structure s(gv, one, no_pml(), S, splitting);
+  fields f(&s);
+  f.use_bloch(zero_vec(gv.dim));
+  f.add_point_source(Ez, 0.8, 1.0, 0.0, 4.0, gv.center());
+  f.add_point_source(Hz, 0.7, 1.0, 0.0, 4.0, gv.center());
+  while (f.time() < 3.0)
+    f.step();
+
+  master_printf("Checking reduction_plan for splitting=%d, symmetry=%s...\n", splitting, Sname);
+  double max_energy = 0;
+  for (int i = 0; i < num_random_trials; ++i) {
+    volume v(random_gv(gv.dim));
+
+    // the terms on different Yee grids reproduce the single-quantity functions
+    reduction_plan plan(f, v);
+    int ienergy = plan.add_field_energy();
+    int iflux = plan.add_flux(X);
+    int ieenergy = plan.add_electric_energy();
+    int imax = plan.add_max_abs(Hz);
+    int iEz = plan.add_field_energy(Ez);
+    int imaxEz = plan.add_max_abs(Ez);
+    for (int repeat = 0; repeat < 2; ++repeat) { // second pass uses the cached decomposition
+      std::vector<double> res = plan.evaluate();
+      max_energy = std::max(max_energy, res[ienergy]);
+      compare_plan(res[ienergy], f.field_energy_in_box(v), "energy");
+      compare_plan(res[ieenergy], f.electric_energy_in_box(v), "electric energy");
+      compare_plan(res[iEz], f.field_energy_in_box(Ez, v), "Ez energy");
+      compare_plan(res[imaxEz], f.max_abs(Ez, v), "max |Ez|");
+      compare_plan(res[iflux], f.flux_in_box(X, v), "flux");
+      f.synchronize_magnetic_fields();
+      compare_plan(res[imax], f.max_abs(Hz, v), "max |Hz|");
+      f.restore_magnetic_fields();
+
+      // the partial sums are added up in a fixed order
+      std::vector<double> res2 = plan.evaluate();
+      for (size_t it = 0; it < res.size(); ++it)
+        if (res2[it] != res[it])
+          meep::abort("FAILED: reduction_plan term %zd = %0.17g then %0.17g\n", it, res[it],
+                      res2[it]);
+      f.step();
+    }
+  }
+  if (max_energy <= 0) meep::abort("FAILED: reduction_plan test has no fields\n");
+  master_printf("...PASSED.\n");
+}
+
+static double half_stretch(double x, void *data) {
+  (void)data;
+  return x > 0.5 * sz[0] ? 2.0 : 1.0;
+}
+
+static complex<double> unit_integrand(const complex<realnum> *fields, const vec &loc,
+                                      void *data_) {
+  (void)fields;
+  (void)loc;
+  (void)data_;
+  return 1.0;
+}
+
+// check that fields::integrate weights pixels by their physical size on a graded grid
+void check_grid_stretch(const grid_volume &gv, int splitting) {
+  master_printf("Checking graded-grid integration weights for splitting=%d...\n", splitting);
+  structure s(gv, one, no_pml(), identity(), splitting);
+  std::vector<size_t> bytes0 = s.memory_usage();
+  s.use_grid_stretch(X, half_stretch);
+  if (!s.has_grid_stretch(X) || s.has_grid_stretch(Y))
+    meep::abort("FAILED: has_grid_stretch is wrong\n");
+  std::vector<size_t> bytes = s.memory_usage();
+  size_t total0 = 0, total = 0;
+  for (size_t i = 0; i < bytes.size(); ++i) {
+    total0 += bytes0[i];
+    total += bytes[i];
+  }
+  // sig, kap, siginv and stretch along X, i.e. four arrays of about 2 * nx entries
+  if (total - total0 < 7 * gv.num_direction(X) * sizeof(realnum))
+    meep::abort("FAILED: memory_usage does not count the grid stretch\n");
+  fields f(&s);
+  if (!f.has_grid_stretch()) meep::abort("FAILED: fields::has_grid_stretch is wrong\n");
+  f.add_point_source(Ez, 0.8, 1.0, 0.0, 4.0, gv.center());
+  while (f.time() < 5.0)
+    f.step();
+
+  // an interior volume, since the Centered grid of fields::integrate misses the cell edges;
+  // its upper half along X has twice the physical width
+  const volume inner(vec(0.25 * sz[0], 0.25 * sz[1]), vec(0.75 * sz[0], 0.75 * sz[1]));
+  const double area = real(f.integrate(0, NULL, unit_integrand, NULL, inner));
+  const double area0 = 0.75 * sz[0] * 0.5 * sz[1];
+  if (fabs(area - area0) > 1e-10 * area0)
+    meep::abort("FAILED: stretched area = %0.16g instead of %0.16g\n", area, area0);
+  const double energy = f.field_energy();
+  if (!(energy > 0) || isinf(energy))
+    meep::abort("FAILED: bad field energy %g on a graded grid\n", energy);
+
+  // the fused reduction_plan splits the same weights and the stretch of Hx into its row and
+  // innermost-line factors, on the Yee grid of each component
+  const component cs[2] = {Ez, Hx};
+  reduction_plan plan(f, inner);
+  const int ic[2] = {plan.add_field_energy(cs[0]), plan.add_field_energy(cs[1])};
+  const int itot = plan.add_field_energy();
+  const std::vector<double> res = plan.evaluate(false);
+  for (int i = 0; i < 2; ++i) {
+    const double e = f.field_energy_in_box(cs[i], inner);
+    if (fabs(res[ic[i]] - e) > 1e-12 * e)
+      meep::abort("FAILED: reduction_plan %s energy %0.16g instead of %0.16g on a graded grid\n",
+                  component_name(cs[i]), res[ic[i]], e);
+  }
+  const double etot = f.electric_energy_in_box(inner) + f.magnetic_energy_in_box(inner);
+  if (fabs(res[itot] - etot) > 1e-12 * etot)
+    meep::abort("FAILED: reduction_plan energy %0.16g instead of %0.16g on a graded grid\n",
+                res[itot], etot);
+  master_printf("...PASSED.\n");
+}
+
+const double stretch_sx = 12.0, stretch_sy = 2.0;
+
+static double ramp_stretch(double x, void *data) { // 1 for x < 5, 2 for x > 7
+  (void)data;
+  return 1.0 + std::min(1.0, std::max(0.0, 0.5 * (x - 5.0)));
+}
+
+static double upper_stretch(double y, void *data) {
+  (void)data;
+  return y > 0.5 * stretch_sy ? 2.0 : 1.0;
+}
+
+/* A plane wave along X, periodic and uniform along Y, crossing a graded region along X.  The
+   DFT flux through planes before and after the graded region must agree, a grid stretch along
+   Y must scale the flux and the energy by the physical height of the cell (Hy is stored as the
+   stretch times the physical field there), and the group delay between the planes must be the
+   physical distance between them. */
+void check_grid_stretch_flux(double a) {
+  master_printf("Checking DFT flux and transit time across a graded grid...\n");
+  const grid_volume gv = vol2d(stretch_sx, stretch_sy, a);
+  const double x1 = 3.5, x2 = 9.0, fcen = 0.3, df = 0.02;
+  const double L = (5.0 - x1) + 1.5 * 2.0 + 2.0 * (x2 - 7.0); // physical distance from x1 to x2
+
+  double flux1[2][3], flux2[2][3], energy[2] = {0, 0};
+  complex<double> E1[3], E2[3];
+  for (int stretched = 0; stretched < 2; ++stretched) {
+    structure s(gv, one, pml(1.0, X));
+    if (stretched) {
+      s.use_grid_stretch(X, ramp_stretch);
+      s.use_grid_stretch(Y, upper_stretch);
+    }
+    fields f(&s);
+    f.use_bloch(Y, 0.0);
+    gaussian_src_time src(fcen, 0.2);
+    f.add_volume_source(Ez, src, volume(vec(2.0, 0.0), vec(2.0, stretch_sy)));
+    const volume plane1(vec(x1, 0.0), vec(x1, stretch_sy));
+    const volume plane2(vec(x2, 0.0), vec(x2, stretch_sy));
+    dft_flux fl1 = f.add_dft_flux_plane(plane1, fcen - df, fcen + df, 3);
+    dft_flux fl2 = f.add_dft_flux_plane(plane2, fcen - df, fcen + df, 3);
+    component c = Ez;
+    dft_fields p1 = f.add_dft_fields(&c, 1, volume(vec(x1, 0.5)), fcen - df, fcen + df, 3);
+    dft_fields p2 = f.add_dft_fields(&c, 1, volume(vec(x2, 0.5)), fcen - df, fcen + df, 3);
+    const volume box(vec(x1 - 0.5, 0.0), vec(x1 + 0.5, stretch_sy)); // not stretched along X
+    while (f.time() < src.last_time() + 2 * stretch_sx) {
+      f.step();
+      if (f.t % 10 == 0) energy[stretched] += f.field_energy_in_box(box);
+    }
+
+    double *fl1_vals = fl1.flux(), *fl2_vals = fl2.flux();
+    for (int i = 0; i < 3; ++i) {
+      flux1[stretched][i] = fl1_vals[i];
+      flux2[stretched][i] = fl2_vals[i];
+      if (stretched) {
+        int rank;
+        size_t dims[3];
+        complex<realnum> *e1 = f.get_dft_array(p1, Ez, i, &rank, dims);
+        complex<realnum> *e2 = f.get_dft_array(p2, Ez, i, &rank, dims);
+        E1[i] = complex<double>(e1[0]);
+        E2[i] = complex<double>(e2[0]);
+        delete[] e1;
+        delete[] e2;
+      }
+    }
+    delete[] fl1_vals;
+    delete[] fl2_vals;
+  }
+
+  for (int i = 0; i < 3; ++i) {
+    if (fabs(flux2[1][i] - flux1[1][i]) > 0.01 * fabs(flux1[1][i]))
+      meep::abort("FAILED: flux %g before and %g after the graded region\n", flux1[1][i],
+                  flux2[1][i]);
+    // the planes are 1.5 times as high physically as in grid coordinates
+    if (fabs(flux1[1][i] - 1.5 * flux1[0][i]) > 0.01 * fabs(flux1[1][i]))
+      meep::abort("FAILED: stretched flux %g instead of 1.5 * %g\n", flux1[1][i], flux1[0][i]);
+  }
+  if (fabs(energy[1] - 1.5 * energy[0]) > 0.01 * energy[1])
+    meep::abort("FAILED: stretched energy %g instead of 1.5 * %g\n", energy[1], energy[0]);
+  const double dphase = arg((E2[2] / E1[2]) / (E2[0] / E1[0]));
+  const double delay = fabs(dphase) / (2 * pi * 2 * df);
+  if (fabs(delay - L) > 0.02 * L)
+    meep::abort("FAILED: group delay %g across the graded region instead of %g\n", delay, L);
+  master_printf("...PASSED (delay %g for distance %g).\n", delay, L);
+}
+
 // check LOOP_OVER_VOL and LOOP_OVER_VOL_OWNED macros
 void check_loop_vol(const grid_volume &gv, component c) {
   size_t count = 0, count_owned = 0;
@@ -316,6 +524,83 @@ void check_loop_vol(const grid_volume &gv, component c) {
   master_printf("...PASSED.\n");
 }
 
+// the sub-grid_volume of gv with n[i] pixels along the i-th direction starting at pixel i0[i]
+static grid_volume sub_grid_volume(const grid_volume &gv, const int i0[3], const int n[3]) {
+  grid_volume sub = gv;
+  LOOP_OVER_DIRECTIONS(gv.dim, d) {
+    sub.set_num_direction(d, n[d % 3]);
+    sub.shift_origin(d, 2 * i0[d % 3]);
+  }
+  return sub;
+}
+
+// max over the two sides of a split of (direct cost / number of chunks), relative to the average
+static double split_imbalance(const grid_volume &gv, int n, int split_point, direction d) {
+  if (d == NO_DIRECTION) return HUGE_VAL;
+  const complex<double> c = gv.get_split_costs(d, split_point, true);
+  const int nl = n / 2, nr = n - nl;
+  return std::max(real(c) / nl, imag(c) / nr) * n / (real(c) + imag(c));
+}
+
+/* check that the costs interpolated from split_cost_grid match the direct fragment_stats
+   costs exactly with one pixel per cell, and that with coarse cells they give nearly as
+   balanced splits as the direct costs */
+void check_split_cost_grid(const grid_volume &gv) {
+  master_printf("Checking split_cost_grid against direct fragment_stats costs...\n");
+  // a PML along low x, with a PML corner at low y, makes the cost nonuniform
+  geometric_object_list geom;
+  geom.num_items = 0;
+  geom.items = NULL;
+  std::vector<volume> pml1d(1, volume(vec(0, 0), vec(0.6, sz[1])));
+  std::vector<volume> pml2d(1, volume(vec(0, 0), vec(0.6, 0.6)));
+  vector3 cell_size = {sz[0], sz[1], 0}, cell_center = {0.5 * sz[0], 0.5 * sz[1], 0};
+  grid_volume gvc = gv;
+  meep_geom::compute_fragment_stats(geom, &gvc, cell_size, cell_center, meep_geom::vacuum,
+                                    std::vector<meep_geom::dft_data>(), pml1d, pml2d,
+                                    std::vector<volume>(), std::vector<volume>(),
+                                    meep_geom::material_type_list(), DEFAULT_SUBPIXEL_TOL,
+                                    DEFAULT_SUBPIXEL_MAXEVAL, false, false);
+
+  const split_cost_grid fine(gv, gv.ntot()), coarse(gv, 64);
+  int ntot[3] = {1, 1, 1};
+  LOOP_OVER_DIRECTIONS(gv.dim, d) { ntot[d % 3] = gv.num_direction(d); }
+  for (int trial = 0; trial < 20; ++trial) {
+    int i0[3] = {0, 0, 0}, n[3] = {1, 1, 1};
+    LOOP_OVER_DIRECTIONS(gv.dim, d) {
+      const int i = d % 3;
+      n[i] = 1 + rand() % ntot[i];
+      i0[i] = rand() % (ntot[i] - n[i] + 1);
+    }
+    const grid_volume sub = sub_grid_volume(gv, i0, n);
+    for (int memory = 0; memory < 2; ++memory) {
+      const double direct = memory ? sub.get_memory_cost() : sub.get_cost();
+      const double grid = fine.cost(sub, memory);
+      if (fabs(grid - direct) > 1e-9 * fabs(direct))
+        meep::abort("FAILED: %s %g from split_cost_grid instead of %g for %d x %d pixels at "
+                    "(%d, %d)\n",
+                    memory ? "memory" : "cost", grid, direct, n[0], n[1], i0[0], i0[1]);
+    }
+  }
+
+  for (int n = 2; n <= 5; ++n) {
+    int p, pc;
+    direction d, dc;
+    double frac, fracc;
+    gv.find_best_split(n, true, p, d, frac);
+    gv.find_best_split(n, true, pc, dc, fracc, &coarse);
+    const double imbalance = split_imbalance(gv, n, p, d);
+    const double imbalance_coarse = split_imbalance(gv, n, pc, dc);
+    if (imbalance_coarse > 1.1 * imbalance)
+      meep::abort("FAILED: split into %d has imbalance %g with the cost grid, %g without\n", n,
+                  imbalance_coarse, imbalance);
+  }
+
+  meep_geom::fragment_stats::resolution = 0; // back to splitting by pixels
+  meep_geom::fragment_stats::pml_1d_vols.clear();
+  meep_geom::fragment_stats::pml_2d_vols.clear();
+  master_printf("...PASSED.\n");
+}
+
 int main(int argc, char **argv) {
   const double a = 10.0;
   initialize mpi(argc, argv);
@@ -331,6 +616,16 @@ int main(int argc, char **argv) {
 
   check_splitsym(v3d, 0, identity(), "identity");
   check_splitsym(v3d, 0, mirror(X, v3d), "mirrorx");
+
+  check_reduction_plan(v2d, 0, identity(), "identity");
+  check_reduction_plan(v2d, 3, mirror(Y, v2d), "mirrory");
+  check_reduction_plan(v3d, 2, mirror(X, v3d), "mirrorx");
+
+  check_grid_stretch(v2d, 0);
+  check_grid_stretch(v2d, 3);
+  check_grid_stretch_flux(20.0);
+
+  check_split_cost_grid(v2d);
   return 0;
 
   for (int splitting = 0; splitting < 5; ++splitting) {
@@ -17,6 +17,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <vector>
 
 #include <meep.hpp>
 using namespace meep;
@@ -146,6 +147,56 @@ double polariton_energy(const grid_volume &gv, double eps(const vec &)) {
   return f.field_energy();
 }
 
+#ifdef HAVE_LAPACK
+/* fields in a pumped two-level atom, padded with nextra levels that are
+   not coupled to anything: with extra levels the populations take the
+   generic update (and beyond 16 levels the serial one) instead of the one
+   unrolled for 2 levels, which must not change the fields */
+complex<double> multilevel_hz(const grid_volume &gv, int nextra, int splitting) {
+  const double ttot = 10.0;
+  const int L = 2 + nextra, T = 1;
+  std::vector<realnum> Gamma(L * L, 0.0), N0(L, 0.0), alpha(L * T, 0.0);
+  const realnum pump = 0.05, decay = 0.02; // level 0 -> 1 pumping, 1 -> 0 decay
+  Gamma[0 * L + 0] += pump;
+  Gamma[1 * L + 0] -= pump;
+  Gamma[1 * L + 1] += decay;
+  Gamma[0 * L + 1] -= decay;
+  N0[0] = 5.0;
+  realnum omega = 0.8, gamma = 0.1, sigmat[5] = {0, 0, 0, 0, 0};
+  sigmat[X] = sigmat[Y] = sigmat[Z] = 2.0;
+  alpha[0 * T] = -1.0 / (2 * pi * omega);
+  alpha[1 * T] = +1.0 / (2 * pi * omega);
+
+  structure s(gv, one, no_pml(), identity(), splitting);
+  s.add_susceptibility(one, E_stuff,
+                       multilevel_susceptibility(L, T, Gamma.data(), N0.data(), alpha.data(),
+                                                 &omega, &gamma, sigmat));
+  fields f(&s);
+  f.add_point_source(Hz, 0.8, 1.0, 0.0, 4.0, gv.center() + vec(0.13, 0.07));
+  while (f.round_time() < ttot)
+    f.step();
+  return f.get_field(Hz, gv.center() + vec(0.31, -0.22));
+}
+
+/* the multilevel update at chunk boundaries depends on the chunk layout,
+   already without extra levels, so the padded atoms are compared against
+   the 2-level atom in the same chunks */
+void compare_multilevel(const grid_volume &gv) {
+  const double tol = sizeof(realnum) == sizeof(float) ? 1e-5 : 1e-10;
+  const int nextras[3] = {1, 3, 15};
+  for (int splitting = 1; splitting <= 3; ++splitting) {
+    const complex<double> ref = multilevel_hz(gv, 0, splitting);
+    for (int i = 0; i < 3; ++i) {
+      complex<double> hz = multilevel_hz(gv, nextras[i], splitting);
+      if (abs(hz - ref) > tol * abs(ref) || ref == 0.0)
+        meep::abort("Failed %d-level atom in %d chunks (%g%+gi instead of %g%+gi)\n",
+                    2 + nextras[i], splitting, real(hz), imag(hz), real(ref), imag(ref));
+    }
+  }
+  master_printf("Passed multilevel atom level equivalence\n");
+}
+#endif
+
 int main(int argc, char **argv) {
   initialize mpi(argc, argv);
   verbosity = 0;
@@ -167,6 +218,9 @@ int main(int argc, char **argv) {
           "1x1x1 X periodic Y PML 3D");
   compare(-103.844, periodic_ez(vol3d(1.0, 1.0, 1.0, a), rods), "1x1x1 fully periodic 3D rods");
   compare(-99.1618, periodic_ez(vol3d(1.0, 1.0, 1.0, a), one), "1x1x1 fully periodic 3D");
+#ifdef HAVE_LAPACK
+  compare_multilevel(voltwo(2.0, 2.0, a));
+#endif
 
   return 0;
 }
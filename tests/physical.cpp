@@ -24,7 +24,7 @@ using std::complex;
 
 double one(const vec &) { return 1.0; }
 
-int radiating_2D(const double xmax) {
+int radiating_2D(const double xmax, int precond_steps = 0) {
   const double a = 10.0;
   const double ymax = 3.0;
 
@@ -42,7 +42,8 @@ int radiating_2D(const double xmax) {
 
   // let the source reach steady state
 #if 1
-  f.solve_cw(sizeof(realnum) == sizeof(float) ? 1e-5 : 1e-6);
+  f.solve_cw(sizeof(realnum) == sizeof(float) ? 1e-5 : 1e-6, 10000, 2, NULL, 1e-8, 20,
+             precond_steps);
 #else
   while (f.time() < 400)
     f.step();
@@ -97,6 +98,46 @@ int radiating_3D(const double xmax) {
   return 1;
 }
 
+struct sweep_data {
+  vec p;
+  std::vector<complex<double> > amps;
+};
+
+static void record_amplitude(fields &f, size_t ifreq, void *data_) {
+  sweep_data *data = (sweep_data *)data_;
+  data->amps[ifreq] = f.get_field(Ez, data->p);
+}
+
+/* the fields from solve_cw_sweep, whose initial guesses are recycled from
+   the previous frequencies, should agree with independent solve_cw calls */
+int cw_sweep_2D(const double xmax) {
+  const double a = 10.0;
+  const double ymax = 3.0;
+
+  grid_volume gv = voltwo(xmax, ymax, a);
+  structure s(gv, one, pml(ymax / 3));
+
+  fields f(&s);
+  continuous_src_time src(0.3);
+  f.add_point_source(Ez, src, vec(xmax / 2 - 2.0, ymax / 2));
+
+  std::vector<complex<double> > freqs = {0.29, 0.295, 0.3, 0.305, 0.31};
+  sweep_data data;
+  data.p = vec(xmax / 2 + 1.3, ymax / 2 + 0.2);
+  data.amps.resize(freqs.size());
+  const double tol = sizeof(realnum) == sizeof(float) ? 1e-5 : 1e-8;
+  if (f.solve_cw_sweep(tol, 10000, freqs, record_amplitude, &data)) return 0;
+
+  for (size_t i = 0; i < freqs.size(); ++i) {
+    f.solve_cw(tol, 10000, freqs[i]);
+    complex<double> amp = f.get_field(Ez, data.p);
+    master_printf("frequency %g: sweep %g%+gi vs. solve_cw %g%+gi\n", real(freqs[i]),
+                  real(data.amps[i]), imag(data.amps[i]), real(amp), imag(amp));
+    if (abs(data.amps[i] - amp) > 1e3 * tol * abs(amp)) return 0;
+  }
+  return 1;
+}
+
 void attempt(const char *name, int allright) {
   if (allright)
     master_printf("Passed %s\n", name);
@@ -110,6 +151,8 @@ int main(int argc, char **argv) {
   master_printf("Trying out some physical tests...\n");
 
   attempt("radiating source should decay spatially as 1/sqrt(r) in 2D.", radiating_2D(8.0));
+  attempt("same with a time-stepping preconditioned CW solve.", radiating_2D(8.0, 4));
   attempt("radiating source should decay spatially as 1/r in 3D.", radiating_3D(7.0));
+  attempt("solve_cw_sweep should match independent solve_cw calls.", cw_sweep_2D(8.0));
   return 0;
 }
@@ -0,0 +1,155 @@
+/* Copyright (C) 2005-2024 Massachusetts Institute of Technology
+%
+%  This program is free software; you can redistribute it and/or modify
+%  it under the terms of the GNU General Public License as published by
+%  the Free Software Foundation; either version 2, or (at your option)
+%  any later version.
+%
+%  This program is distributed in the hope that it will be useful,
+%  but WITHOUT ANY WARRANTY; without even the implied warranty of
+%  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+%  GNU General Public License for more details.
+%
+%  You should have received a copy of the GNU General Public License
+%  along with this program; if not, write to the Free Software Foundation,
+%  Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <meep.hpp>
+#include "config.h"
+using namespace meep;
+using std::complex;
+
+#if MEEP_SINGLE
+static double eps_compare = 1e-5;
+#else
+static double eps_compare = 1e-12;
+#endif
+
+double rods(const vec &p) {
+  vec q = p - vec(1.5, 1.0);
+  return fabs(q.x()) < 0.3 || fabs(q.y()) < 0.2 ? 6.0 : 1.0;
+}
+
+/* check that probe_set samples agree with fields::get_field at every
+   step, for points that are off-grid, in periodic images, and related
+   to the stored points by the symmetry */
+int check_probes(const symmetry &S, int nchunks, size_t capacity) {
+  const grid_volume gv = vol2d(3.0, 2.0, 10.0);
+  structure s(gv, rods, no_pml(), S, nchunks);
+  fields f(&s);
+  f.use_bloch(X, 0.3);
+  f.add_point_source(Ez, 0.8, 1.0, 0.0, 4.0, vec(1.5, 1.0));
+  f.add_point_source(Hz, 0.7, 1.0, 0.0, 4.0, vec(1.5, 1.0));
+
+  std::vector<vec> pts = {vec(0.73, 0.41), vec(2.27, 0.41), vec(1.5, 1.0), vec(3.41, 1.93),
+                          vec(-0.12, 0.05)};
+  std::vector<component> cs = {Ez, Hx, Hy, Hz, Ex};
+  probe_set probes(f, pts, cs, capacity);
+
+  std::vector<std::vector<complex<double> > > expected(pts.size() * cs.size());
+  std::vector<double> times;
+  while (f.time() < 6.0) {
+    f.step();
+    probes.update(f);
+    times.push_back(f.time());
+    for (size_t ipt = 0; ipt < pts.size(); ++ipt)
+      for (size_t ic = 0; ic < cs.size(); ++ic)
+        expected[ipt * cs.size() + ic].push_back(f.get_field(cs[ic], pts[ipt]));
+  }
+
+  const size_t nkept = std::min(capacity, times.size());
+  if (probes.num_samples() != nkept) {
+    master_printf("expected %zu samples, got %zu\n", nkept, probes.num_samples());
+    return 0;
+  }
+  const size_t first = times.size() - nkept;
+  for (size_t ipt = 0; ipt < pts.size(); ++ipt)
+    for (size_t ic = 0; ic < cs.size(); ++ic) {
+      std::vector<complex<double> > series = probes.get_series(ipt, ic);
+      const std::vector<complex<double> > &ex = expected[ipt * cs.size() + ic];
+      for (size_t n = 0; n < nkept; ++n) {
+        if (probes.time(n) != times[first + n]) {
+          master_printf("sample %zu has time %g instead of %g\n", n, probes.time(n),
+                        times[first + n]);
+          return 0;
+        }
+        if (abs(series[n] - ex[first + n]) > eps_compare * (1 + abs(ex[first + n]))) {
+          master_printf("probe %zu %s at t=%g: %g%+gi != %g%+gi\n", ipt, component_name(cs[ic]),
+                        times[first + n], real(series[n]), imag(series[n]),
+                        real(ex[first + n]), imag(ex[first + n]));
+          return 0;
+        }
+      }
+    }
+  return 1;
+}
+
+#ifdef HAVE_HARMINV
+/* check that the batched harmonic inversion of all probe series gives the
+   same modes as running do_harminv on each series separately */
+int check_probe_harminv(size_t capacity) {
+  const grid_volume gv = vol2d(3.0, 2.0, 10.0);
+  structure s(gv, rods, no_pml(), identity(), 3);
+  fields f(&s);
+  f.add_point_source(Ez, 0.8, 1.0, 0.0, 4.0, vec(1.5, 1.0));
+  f.add_point_source(Hz, 0.7, 1.0, 0.0, 4.0, vec(1.5, 1.0));
+
+  std::vector<vec> pts = {vec(0.73, 0.41), vec(2.27, 1.41), vec(1.5, 1.0)};
+  std::vector<component> cs = {Ez, Hz};
+  probe_set probes(f, pts, cs, capacity);
+  while (f.time() < 40.0) {
+    f.step();
+    probes.update(f);
+  }
+
+  const int maxbands = 5;
+  std::vector<harminv_result> modes = probes.harminv(0.5, 1.0, maxbands);
+  if (modes.size() != pts.size() * cs.size()) return 0;
+  for (size_t ipt = 0; ipt < pts.size(); ++ipt)
+    for (size_t ic = 0; ic < cs.size(); ++ic) {
+      std::vector<complex<double> > series = probes.get_series(ipt, ic);
+      complex<double> amps[maxbands];
+      double freq_re[maxbands], freq_im[maxbands];
+      int num = do_harminv(series.data(), int(series.size()), probes.sample_dt(), 0.5, 1.0,
+                           maxbands, amps, freq_re, freq_im);
+      const harminv_result &r = modes[ipt * cs.size() + ic];
+      if (r.num_modes() != size_t(num)) {
+        master_printf("probe %zu %s: %zu modes instead of %d\n", ipt, component_name(cs[ic]),
+                      r.num_modes(), num);
+        return 0;
+      }
+      for (int i = 0; i < num; ++i)
+        if (r.freq_re[i] != freq_re[i] || r.freq_im[i] != freq_im[i] || r.amps[i] != amps[i]) {
+          master_printf("probe %zu %s: mode %d is %g%+gi instead of %g%+gi\n", ipt,
+                        component_name(cs[ic]), i, r.freq_re[i], r.freq_im[i], freq_re[i],
+                        freq_im[i]);
+          return 0;
+        }
+    }
+  return 1;
+}
+#endif
+
+int main(int argc, char **argv) {
+  initialize mpi(argc, argv);
+  verbosity = 0;
+  master_printf("Testing probe_set against get_field...\n");
+
+  const grid_volume gv = vol2d(3.0, 2.0, 10.0);
+  if (!check_probes(identity(), 1, 10000)) meep::abort("error in probe_set, 1 chunk\n");
+  if (!check_probes(identity(), 5, 10000)) meep::abort("error in probe_set, 5 chunks\n");
+  if (!check_probes(identity(), 3, 17)) meep::abort("error in probe_set ring buffer\n");
+  if (!check_probes(mirror(Y, gv), 2, 10000)) meep::abort("error in probe_set with mirror(Y)\n");
+
+#ifdef HAVE_HARMINV
+  if (!check_probe_harminv(100000)) meep::abort("error in probe_set::harminv\n");
+  if (!check_probe_harminv(500)) meep::abort("error in probe_set::harminv ring buffer\n");
+#endif
+
+  master_printf("Passed all probe_set tests!\n");
+  return 0;
+}
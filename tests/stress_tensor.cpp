@@ -16,9 +16,53 @@ double two_waveguides(const vec &p) {
     return 1.0;
 }
 
+/* check that casimir_stress_dct_integrals, which evaluates many terms in a
+   single pass over the surface, matches evaluating each term on its own */
+int check_casimir_terms(bool is_bloch) {
+  grid_volume gv = vol2d(4.0, 3.0, 10.0);
+  gv.center_origin();
+  structure s(gv, two_waveguides, no_pml(), mirror(Y, gv), 3);
+  fields f(&s);
+  f.add_point_source(Ez, 0.3, 0.1, 0.0, 4.0, vec(0.5 * (d + sw), 0.1));
+  f.add_point_source(Hz, 0.3, 0.1, 0.0, 4.0, vec(-0.5 * (d + sw), 0.2));
+  while (f.time() < 10.0)
+    f.step();
+
+  const direction dirs[2] = {X, Y};
+  std::vector<casimir_stress_term> terms;
+  for (int m = 0; m < 3; ++m)
+    for (direction dforce : dirs)
+      for (direction dsource : dirs) {
+        casimir_stress_term t = {dforce, dsource, double(m), double(2 - m), 0.0};
+        terms.push_back(t);
+      }
+
+  volume where(vec(0.3, -1.2), vec(0.3, 1.0));
+  for (int ft = E_stuff; ft <= H_stuff; ++ft) {
+    std::vector<std::complex<double> > batch =
+        f.casimir_stress_dct_integrals(terms, field_type(ft), where, is_bloch);
+    if (batch.size() != terms.size()) return 0;
+    for (size_t i = 0; i < terms.size(); ++i) {
+      const casimir_stress_term &t = terms[i];
+      std::complex<double> one = f.casimir_stress_dct_integral(
+          t.dforce, t.dsource, t.mx, t.my, t.mz, field_type(ft), where, is_bloch);
+      if (abs(batch[i] - one) > 1e-12 * abs(one)) {
+        master_printf("casimir term %zu (%s): %g%+gi instead of %g%+gi\n", i,
+                      ft == E_stuff ? "E" : "H", real(batch[i]), imag(batch[i]), real(one),
+                      imag(one));
+        return 0;
+      }
+    }
+  }
+  return 1;
+}
+
 int main(int argc, char **argv) {
   initialize mpi(argc, argv);
   verbosity = 0;
+  if (!check_casimir_terms(false)) meep::abort("error in casimir_stress_dct_integrals\n");
+  if (!check_casimir_terms(true)) meep::abort("error in Bloch casimir_stress_dct_integrals\n");
+
   grid_volume gv = vol3d(sx + 2 * dpml, sy + 2 * dpml, 0, res);
   gv.center_origin();
   const symmetry S = mirror(X, gv) - mirror(Y, gv);
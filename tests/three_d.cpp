@@ -18,6 +18,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <signal.h>
+#include <algorithm>
 
 #include <meep.hpp>
 using namespace meep;
@@ -223,6 +224,55 @@ int test_pml_splitting(double eps(const vec &), int splitting) {
   return 1;
 }
 
+static volume kerr_box(vec(0, 0, 0), vec(0, 0, 0));
+static double kerr_background = 0.0;
+double kerr_chi3(const vec &p) { return kerr_box.contains(p) ? 0.4 : kerr_background; }
+
+/* check that a Kerr medium filling only the box [lo, hi] (x relative to the
+   boundary between two chunks) gives the same fields as the nonlinear update
+   over the whole chunk, which we force with a negligible chi3 everywhere else */
+int test_kerr_box(double xlo, double xhi) {
+  double a = 10.0;
+  double ttot = 10.0;
+
+  grid_volume gv = vol3d(2.0, 0.6, 0.7, a);
+  structure s(gv, one, no_pml(), identity(), 2);
+  structure s1(gv, one, no_pml(), identity(), 2);
+  structure s0(gv, one, no_pml(), identity(), 2);
+  double xb = gv.surroundings().get_max_corner().x(); // x of the chunk boundary
+  for (int i = 0; i < s.num_chunks; ++i)
+    xb = std::min(xb, s.chunks[i]->gv.surroundings().get_max_corner().x());
+
+  kerr_box = volume(vec(xb + xlo, 0.15, 0.2), vec(xb + xhi, 0.45, 0.5));
+  kerr_background = 0.0;
+  s.set_chi3(kerr_chi3);
+  kerr_background = 1e-30;
+  s1.set_chi3(kerr_chi3);
+
+  master_printf("Kerr test with x in [%g, %g] around the chunk boundary...\n", xlo, xhi);
+  fields f(&s), f1(&s1), f0(&s0);
+  const vec src(xb + 0.5 * (xlo + xhi), 0.31, 0.33);
+  f.add_point_source(Ey, 0.8, 0.6, 0.0, 4.0, src, 5.0);
+  f1.add_point_source(Ey, 0.8, 0.6, 0.0, 4.0, src, 5.0);
+  f0.add_point_source(Ey, 0.8, 0.6, 0.0, 4.0, src, 5.0);
+  while (f.time() < ttot) {
+    f.step();
+    f1.step();
+    f0.step();
+    if (!compare_point(f, f1, vec(xb - 0.05, 0.3, 0.35))) return 0;
+    if (!compare_point(f, f1, vec(xb + 0.05, 0.2, 0.45))) return 0;
+    if (!compare_point(f, f1, src)) return 0;
+    if (!compare_point(f, f1, vec(0.3, 0.5, 0.1))) return 0;
+  }
+  if (!compare(f.field_energy(), f1.field_energy(), "   total energy")) return 0;
+  // the Kerr medium must actually change the fields, or this test is vacuous
+  if (fabs(f.field_energy() - f0.field_energy()) < 10 * tol * f0.field_energy()) {
+    master_printf("Kerr medium does not change the field energy %g\n", f0.field_energy());
+    return 0;
+  }
+  return 1;
+}
+
 int main(int argc, char **argv) {
   initialize mpi(argc, argv);
   verbosity = 0;
@@ -236,8 +286,20 @@ int main(int argc, char **argv) {
   for (int s = 2; s < 8; s++)
     if (!test_metal(one, s)) meep::abort("error in test_metal vacuum\n");
 
+  // enough chunks that the chunk owner lookup in connect_the_chunks uses
+  // several bins per direction, and most chunk pairs do not communicate
+  for (int s = 24; s <= 48; s += 24) {
+    if (!test_periodic(targets, s)) meep::abort("error in test_periodic targets, many chunks\n");
+    if (!test_metal(one, s)) meep::abort("error in test_metal vacuum, many chunks\n");
+  }
+
   for (int s = 2; s < 4; s++)
     if (!test_pml_splitting(one, s)) meep::abort("error in test_pml_splitting vacuum\n");
 
+  // Kerr boxes inside one chunk touching the boundary, and straddling it
+  if (!test_kerr_box(0.0, 0.4)) meep::abort("error in test_kerr_box touching boundary\n");
+  if (!test_kerr_box(-0.4, 0.0)) meep::abort("error in test_kerr_box touching boundary\n");
+  if (!test_kerr_box(-0.25, 0.35)) meep::abort("error in test_kerr_box straddling boundary\n");
+
   return 0;
 }
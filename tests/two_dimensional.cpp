@@ -107,6 +107,64 @@ int test_metal(double eps(const vec &), int splitting) {
   return 1;
 }
 
+double half_pec(const vec &pt) { return pt.x() > 1.4 ? infinity : 2.0; }
+/* vanishes near the walls, whose unowned points are not updated (and so would
+   keep initialized values in a single chunk but not in an all-metal chunk) */
+complex<double> bump(const vec &pt) {
+  const double r2 = (pt.x() - 1.5) * (pt.x() - 1.5) + (pt.y() - 1.0) * (pt.y() - 1.0);
+  return r2 < 0.36 ? exp(-4 * r2) : 0.0;
+}
+
+/* check that a chunk filled with perfect metal (chi1inv == 0), whose E update
+   is replaced by zeroing E, gives the same fields as a single chunk, also
+   after E is set directly by initialize_field */
+int test_pec_chunk(int splitting) {
+  double a = 10.0;
+  double ttot = 12.0;
+
+  grid_volume gv = voltwo(3.0, 2.0, a);
+  structure s1(gv, half_pec);
+  structure s(gv, half_pec, no_pml(), identity(), splitting);
+
+  master_printf("Perfect-metal chunk test using %d chunks...\n", splitting);
+  fields f(&s);
+  f.add_point_source(Hz, 0.7, 2.5, 0.0, 4.0, vec(0.3, 0.5), 1.0);
+  f.add_point_source(Ez, 0.8, 0.6, 0.0, 4.0, vec(1.099, 0.401), 1.0);
+  fields f1(&s1);
+  f1.add_point_source(Hz, 0.7, 2.5, 0.0, 4.0, vec(0.3, 0.5), 1.0);
+  f1.add_point_source(Ez, 0.8, 0.6, 0.0, 4.0, vec(1.099, 0.401), 1.0);
+  bool initialized = false;
+  while (f.time() < ttot) {
+    f.step();
+    f1.step();
+    if (!compare_point(f, f1, vec(0.5, 0.01))) return 0;
+    if (!compare_point(f, f1, vec(1.35, 0.73))) return 0;
+    if (!compare_point(f, f1, vec(1.45, 1.1))) return 0;
+    if (!compare_point(f, f1, vec(2.7, 1.3))) return 0;
+    if (initialized && (abs(f.get_field(Ez, vec(2.7, 1.3))) != 0 ||
+                        abs(f.get_field(Ex, vec(2.5, 0.9))) != 0)) {
+      master_printf("E is nonzero inside the metal at time %g\n", f.time());
+      return 0;
+    }
+    if (!initialized && f.time() >= 3.0) {
+      bool any_metal = false;
+      for (int i = 0; i < f.num_chunks; ++i)
+        if (f.chunks[i]->is_mine() && f.chunks[i]->all_metal[E_stuff]) any_metal = true;
+      if (!or_to_all(any_metal)) {
+        master_printf("no chunk lies entirely in the metal\n");
+        return 0;
+      }
+      f.initialize_field(Ez, bump);
+      f1.initialize_field(Ez, bump);
+      f.initialize_field(Ex, bump);
+      f1.initialize_field(Ex, bump);
+      initialized = true;
+    }
+  }
+  if (!compare(f.field_energy(), f1.field_energy(), "   total energy")) return 0;
+  return 1;
+}
+
 int test_periodic(double eps(const vec &), int splitting) {
   double a = 10.0;
   double ttot = 17.0;
@@ -336,6 +394,9 @@ int main(int argc, char **argv) {
     if (!test_metal(targets, s)) meep::abort("error in test_metal targets\n");
   // if (!test_metal(targets, 60)) meep::abort("error in test_metal targets\n");
 
+  for (int s = 3; s < 5; s++)
+    if (!test_pec_chunk(s)) meep::abort("error in test_pec_chunk\n");
+
   for (int s = 2; s < 5; s++)
     if (!test_periodic(targets, s)) meep::abort("error in test_periodic targets\n");
   // if (!test_periodic(one, 200))